@@ -0,0 +1,179 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// lookups per second of the workers while the command socket is flooded with posts, and the share of the time the
+// workers are locked out, the workers take the rules lock shared for each Interest as interestNameFilter does and the
+// command thread takes it exclusively either for the whole post (validation, changes and a warning datagram per
+// refused rule) as commandPost used to or only for the changes
+// usage: command_lock_bench [seconds per run] [max threads]
+
+#include <boost/asio.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+static const size_t RULES = 100000;
+static const size_t RULES_PER_POST = 200;
+
+// the lists of NdnFirewall, a set of name prefixes and the hashes looked up by the workers
+struct Rules {
+    boost::shared_mutex mutex;
+    std::set<std::string> names;
+    std::unordered_set<size_t> hashes;
+};
+
+static std::string makeName(size_t index) {
+    return "/bench/" + std::to_string(index % 1000) + "/" + std::to_string(index);
+}
+
+// the checks of commandPost before anything is changed
+static bool validate(const std::vector<std::string> &names) {
+    for (const auto &name : names) {
+        if (name.empty() || name[0] != '/' || name.find("//") != std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void apply(Rules &rules, const std::vector<std::string> &names, std::vector<std::string> &warnings) {
+    for (const auto &name : names) {
+        if (rules.names.insert(name).second) {
+            rules.hashes.insert(std::hash<std::string>()(name));
+        } else {
+            warnings.push_back(R"({"status":"warning", "reason":"')" + name + R"(' has been already appended in whitelist"})");
+        }
+    }
+}
+
+struct Result {
+    double lookups;
+    double locked;
+};
+
+static Result run(size_t threads, bool narrow, double seconds) {
+    Rules rules;
+    for (size_t i = 0; i < RULES; ++i) {
+        rules.names.insert(makeName(i));
+        rules.hashes.insert(std::hash<std::string>()(makeName(i)));
+    }
+
+    boost::asio::io_service ios;
+    boost::asio::ip::udp::socket receiver(ios, boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    boost::asio::ip::udp::socket sender(ios, boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    receiver.non_blocking(true);
+    auto remote = receiver.local_endpoint();
+
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> lookups(0);
+    std::chrono::steady_clock::duration locked(0);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&rules, &running, &lookups, t]() {
+            std::mt19937 random(t);
+            uint64_t count = 0;
+            while (running) {
+                size_t hash = std::hash<std::string>()(makeName(random() % (2 * RULES)));
+                boost::shared_lock<boost::shared_mutex> lock(rules.mutex);
+                count += rules.hashes.count(hash);
+                ++count;
+            }
+            lookups += count;
+        });
+    }
+
+    // half of the rules of each post are already there and answered with a warning
+    std::thread command([&]() {
+        std::vector<uint8_t> drain(1 << 16);
+        size_t next = RULES;
+        while (running) {
+            std::vector<std::string> names;
+            for (size_t i = 0; i < RULES_PER_POST; ++i) {
+                names.push_back(makeName(i % 2 == 0 ? next++ : next % RULES));
+            }
+            std::vector<std::string> warnings;
+            if (narrow) {
+                if (!validate(names)) {
+                    continue;
+                }
+                {
+                    boost::unique_lock<boost::shared_mutex> lock(rules.mutex);
+                    auto begin = std::chrono::steady_clock::now();
+                    apply(rules, names, warnings);
+                    locked += std::chrono::steady_clock::now() - begin;
+                }
+                for (const auto &warning : warnings) {
+                    sender.send_to(boost::asio::buffer(warning), remote);
+                }
+            } else {
+                boost::unique_lock<boost::shared_mutex> lock(rules.mutex);
+                auto begin = std::chrono::steady_clock::now();
+                if (!validate(names)) {
+                    continue;
+                }
+                apply(rules, names, warnings);
+                for (const auto &warning : warnings) {
+                    sender.send_to(boost::asio::buffer(warning), remote);
+                }
+                locked += std::chrono::steady_clock::now() - begin;
+            }
+            boost::system::error_code err;
+            while (receiver.receive(boost::asio::buffer(drain), 0, err) > 0) {
+            }
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running = false;
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    command.join();
+    return {lookups / seconds, 100 * std::chrono::duration<double>(locked).count() / seconds};
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 2;
+    size_t max_threads = argc > 2 ? (size_t)std::atol(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    if (seconds <= 0 || max_threads == 0) {
+        std::cerr << "usage: " << argv[0] << " [seconds per run] [max threads]" << std::endl;
+        return 1;
+    }
+
+    std::cout << RULES << " rules, posts of " << RULES_PER_POST << " rules back to back, " << seconds << "s per run, "
+              << std::thread::hardware_concurrency() << " cpus" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(30) << "whole post: lookups/s locked"
+              << std::setw(32) << "changes only: lookups/s locked" << std::endl;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        Result wide = run(threads, false, seconds);
+        Result narrow = run(threads, true, seconds);
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(0)
+                  << std::setw(22) << wide.lookups << std::setw(7) << wide.locked << "%"
+                  << std::setw(24) << narrow.lookups << std::setw(7) << narrow.locked << "%" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,215 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// latency of a light consumer while another consumer floods the egress face at twice its rate, with every Interest
+// sent straight to the egress face or through the DrrScheduler, the egress face writes at a fixed rate from a send
+// queue bounded like the one of the real faces and the latency is from enqueue() to the write
+// usage: drr_latency_bench [seconds] [egress packets/s]
+
+#include "../drr_scheduler.h"
+#include "../network/send_queue.h"
+
+#include <ndn-cxx/encoding/block.hpp>
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t PACKET_SIZE = 100;
+static const auto TICK = std::chrono::microseconds(100);
+static const auto LIGHT_INTERVAL = std::chrono::milliseconds(1);
+
+enum Consumer : uint8_t {
+    FLOOD,
+    LIGHT,
+};
+
+// an Interest TLV carrying the consumer and the time it was enqueued
+static ndn::Block makePacket(Consumer consumer) {
+    std::vector<uint8_t> wire(PACKET_SIZE, 0);
+    wire[0] = 0x05;
+    wire[1] = PACKET_SIZE - 2;
+    wire[2] = consumer;
+    Clock::rep now = Clock::now().time_since_epoch().count();
+    std::memcpy(&wire[3], &now, sizeof(now));
+    return ndn::Block(wire.data(), wire.size());
+}
+
+// ingress face of a consumer, only its endpoint is used by the scheduler
+class ConsumerFace : public Face {
+private:
+    std::string _endpoint;
+
+public:
+    ConsumerFace(boost::asio::io_service &ios, const std::string &endpoint) : Face(ios), _endpoint(endpoint) {
+
+    }
+
+    std::string getUnderlyingProtocol() const override {
+        return "bench";
+    }
+
+    std::string getUnderlyingEndpoint() const override {
+        return _endpoint;
+    }
+
+    void open(const InterestCallback &interest_callback, const DataCallback &data_callback, const ErrorCallback &error_callback) override {
+
+    }
+
+    void close() override {
+
+    }
+
+    void send(const std::string &message) override {
+
+    }
+
+    void send(const ndn::Block &wire) override {
+
+    }
+
+    void send(const ndn::Interest &interest) override {
+
+    }
+
+    void send(const ndn::Data &data) override {
+
+    }
+};
+
+// egress face writing rate packets per second from its send queue
+class LinkFace : public ConsumerFace {
+private:
+    SendQueue<Message> _queue;
+    double _rate;
+    double _credit = 0;
+    Clock::time_point _last;
+
+public:
+    std::vector<double> latencies[2];
+
+    LinkFace(boost::asio::io_service &ios, double rate)
+            : ConsumerFace(ios, "127.0.0.1:6363")
+            , _queue(_dropped_packets)
+            , _rate(rate)
+            , _last(Clock::now()) {
+
+    }
+
+    void send(const ndn::Block &wire) override {
+        _queue.push(Message(wire));
+    }
+
+    void write() {
+        auto now = Clock::now();
+        _credit = std::min(_credit + std::chrono::duration<double>(now - _last).count() * _rate, (double)(_rate / 100));
+        _last = now;
+        for (; _credit >= 1 && !_queue.empty(); _credit -= 1) {
+            const uint8_t *data = _queue.front().data();
+            Clock::rep sent;
+            std::memcpy(&sent, data + 3, sizeof(sent));
+            latencies[data[2]].push_back(std::chrono::duration<double, std::milli>(now - Clock::time_point(Clock::duration(sent))).count());
+            // the message and with it the credit of the scheduler are released as a real face does on write completion
+            _queue.pop();
+        }
+    }
+};
+
+static double percentile(std::vector<double> &values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+static void run(const std::string &name, bool scheduled, double seconds, double rate) {
+    boost::asio::io_service ios;
+    auto link = std::make_shared<LinkFace>(ios, rate);
+    auto flood = std::make_shared<ConsumerFace>(ios, "10.0.0.1:6363");
+    auto light = std::make_shared<ConsumerFace>(ios, "10.0.0.2:6363");
+    auto scheduler = std::make_shared<DrrScheduler>(ios, link, std::vector<DrrScheduler::Weight>(),
+                                                    std::make_shared<DrrScheduler::IngressLimit>());
+    auto send = [&](const std::shared_ptr<Face> &face, Consumer consumer) {
+        if (scheduled) {
+            scheduler->enqueue(face, makePacket(consumer));
+        } else {
+            link->send(makePacket(consumer));
+        }
+    };
+
+    auto begin = Clock::now();
+    auto end = begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    auto next_light = begin;
+    double flood_credit = 0;
+    size_t light_sent = 0;
+    size_t flood_sent = 0;
+    for (auto tick = begin; tick < end; tick += TICK) {
+        // run what the scheduler posted and the writes until the next tick
+        while (Clock::now() < tick) {
+            ios.poll();
+            link->write();
+        }
+        for (flood_credit += 2 * rate * std::chrono::duration<double>(TICK).count(); flood_credit >= 1; flood_credit -= 1) {
+            send(flood, FLOOD);
+            ++flood_sent;
+        }
+        if (tick >= next_light) {
+            send(light, LIGHT);
+            ++light_sent;
+            next_light += LIGHT_INTERVAL;
+        }
+    }
+
+    auto &light_latencies = link->latencies[LIGHT];
+    size_t light_written = light_latencies.size();
+    std::cout << std::setw(12) << name << std::fixed << std::setprecision(2)
+              << std::setw(10) << percentile(light_latencies, 0.5)
+              << std::setw(10) << percentile(light_latencies, 0.99)
+              << std::setw(10) << percentile(light_latencies, 1)
+              << std::setw(8) << light_written << "/" << light_sent
+              << std::setprecision(0) << std::setw(12) << link->latencies[FLOOD].size() / seconds
+              << std::setw(10) << flood_sent / seconds << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 5;
+    double rate = argc > 2 ? std::atof(argv[2]) : 50000;
+    if (seconds <= 0 || rate < 1000) {
+        std::cerr << "usage: " << argv[0] << " [seconds] [egress packets/s]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "egress of " << rate << " packets/s, flood of " << 2 * rate << " packets/s, one light Interest per ms, "
+              << seconds << "s per run" << std::endl;
+    std::cout << std::setw(12) << "" << std::setw(30) << "light latency (ms) p50/p99/max" << std::setw(16) << "written"
+              << std::setw(12) << "flood out/s" << std::setw(10) << "in/s" << std::endl;
+    run("direct", false, seconds, rate);
+    run("scheduled", true, seconds, rate);
+    return 0;
+}
@@ -0,0 +1,433 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// loopback throughput of the asio and io_uring backends of the faces, the sender and the receiver of each run share
+// one io_service run by a single thread like a worker of the IoServicePool, the system calls are issued the same way
+// as StreamFace and UdpMasterFace do
+// no packet is framed, decoded nor forwarded, the runs compare the cost of the system calls of both backends and say
+// little about the rate of the firewall; the UDP runs vary a lot between runs on a busy or single CPU machine
+// usage: face_io_bench [seconds] [message size]
+
+#include "../network/io_uring.h"
+#include "../network/udp_batch.h"
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// same cap as StreamFace::MAX_WRITE_BUFFERS
+static const size_t WRITE_BUFFERS = 64;
+static const size_t READ_SIZE = 1 << 16;
+
+class Bench {
+protected:
+    boost::asio::io_service &_ios;
+#ifdef HAVE_IO_URING
+    IoUring *_uring = nullptr;
+#endif
+    bool _running = true;
+    // operations submitted and not completed yet, the buffers they use must stay alive until it drops to 0
+    size_t _pending = 0;
+
+public:
+    uint64_t sent = 0;
+    uint64_t received = 0;
+
+    explicit Bench(boost::asio::io_service &ios)
+            : _ios(ios) {
+
+    }
+
+    virtual ~Bench() = default;
+
+    virtual void start() = 0;
+
+    // cancel the pending operations, the io_service has to run until isIdle()
+    virtual void stop() = 0;
+
+    bool isIdle() const {
+        return _pending == 0;
+    }
+};
+
+class TcpBench : public Bench {
+private:
+    boost::asio::ip::tcp::socket _sender;
+    boost::asio::ip::tcp::socket _receiver;
+    std::vector<uint8_t> _messages;
+    std::vector<boost::asio::const_buffer> _buffers;
+    std::vector<uint8_t> _read_buffer;
+#ifdef HAVE_IO_URING
+    std::vector<iovec> _iovecs;
+    size_t _first_iovec = 0;
+    uint64_t _read_operation = 0;
+    uint64_t _write_operation = 0;
+#endif
+
+public:
+    TcpBench(boost::asio::io_service &ios, size_t message_size, bool uring)
+            : Bench(ios)
+            , _sender(ios)
+            , _receiver(ios)
+            , _messages(WRITE_BUFFERS * message_size, 0x05)
+            , _read_buffer(READ_SIZE) {
+        boost::asio::ip::tcp::acceptor acceptor(_ios, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        _sender.connect(acceptor.local_endpoint());
+        acceptor.accept(_receiver);
+        _sender.set_option(boost::asio::ip::tcp::no_delay(true));
+
+        // a gathered write of small packets, each one in its own buffer
+        for (size_t i = 0; i < WRITE_BUFFERS; ++i) {
+            _buffers.emplace_back(_messages.data() + i * message_size, message_size);
+        }
+#ifdef HAVE_IO_URING
+        if (uring) {
+            _uring = IoUring::get(_ios);
+        }
+#endif
+    }
+
+    void start() override {
+        write();
+        read();
+    }
+
+    void stop() override {
+        _running = false;
+#ifdef HAVE_IO_URING
+        if (_uring) {
+            if (_read_operation) {
+                _uring->cancel(_read_operation);
+            }
+            if (_write_operation) {
+                _uring->cancel(_write_operation);
+            }
+            return;
+        }
+#endif
+        boost::system::error_code err;
+        _sender.close(err);
+        _receiver.close(err);
+    }
+
+private:
+    void write() {
+        ++_pending;
+#ifdef HAVE_IO_URING
+        if (_uring) {
+            _iovecs.clear();
+            for (const auto &buffer : _buffers) {
+                _iovecs.push_back({const_cast<void *>(boost::asio::buffer_cast<const void *>(buffer)),
+                                   boost::asio::buffer_size(buffer)});
+            }
+            _first_iovec = 0;
+            uringWrite();
+            return;
+        }
+#endif
+        boost::asio::async_write(_sender, _buffers, boost::bind(&TcpBench::writeHandler, this, _1, _2));
+    }
+
+    void writeHandler(const boost::system::error_code &err, size_t bytes_transferred) {
+        --_pending;
+        if (!err) {
+            sent += bytes_transferred;
+            if (_running) {
+                write();
+            }
+        }
+    }
+
+    void read() {
+        ++_pending;
+#ifdef HAVE_IO_URING
+        if (_uring) {
+            _read_operation = _uring->recv(_receiver.native_handle(), _read_buffer.data(), _read_buffer.size(),
+                                           [this](int result, uint32_t flags) {
+                _read_operation = 0;
+                readHandler(result > 0 ? boost::system::error_code() : boost::asio::error::eof,
+                            result > 0 ? (size_t)result : 0);
+            });
+            return;
+        }
+#endif
+        _receiver.async_read_some(boost::asio::buffer(_read_buffer), boost::bind(&TcpBench::readHandler, this, _1, _2));
+    }
+
+    void readHandler(const boost::system::error_code &err, size_t bytes_transferred) {
+        --_pending;
+        if (!err) {
+            received += bytes_transferred;
+            if (_running) {
+                read();
+            }
+        }
+    }
+
+#ifdef HAVE_IO_URING
+    void uringWrite() {
+        _write_operation = _uring->writev(_sender.native_handle(), _iovecs.data() + _first_iovec,
+                                          (unsigned)(_iovecs.size() - _first_iovec), [this](int result, uint32_t flags) {
+            _write_operation = 0;
+            uringWriteHandler(result);
+        });
+    }
+
+    void uringWriteHandler(int result) {
+        if (result < 0) {
+            writeHandler(boost::system::error_code(-result, boost::system::system_category()), 0);
+            return;
+        }
+        sent += result;
+
+        // resubmit what the socket did not take, as StreamFace does
+        size_t written = (size_t)result;
+        while (_first_iovec < _iovecs.size() && written >= _iovecs[_first_iovec].iov_len) {
+            written -= _iovecs[_first_iovec].iov_len;
+            ++_first_iovec;
+        }
+        if (_first_iovec < _iovecs.size() && _running) {
+            _iovecs[_first_iovec].iov_base = (uint8_t *)_iovecs[_first_iovec].iov_base + written;
+            _iovecs[_first_iovec].iov_len -= written;
+            uringWrite();
+            return;
+        }
+        writeHandler(boost::system::error_code(), 0);
+    }
+#endif
+};
+
+class UdpBench : public Bench {
+private:
+    boost::asio::ip::udp::socket _sender;
+    boost::asio::ip::udp::socket _receiver;
+    boost::asio::ip::udp::endpoint _endpoint;
+    Message _message;
+    UdpBatch _write_batch;
+    UdpBatch _read_batch;
+#ifdef HAVE_IO_URING
+    std::unique_ptr<IoUring::BufferRing> _buffer_ring;
+    msghdr _recv_header;
+    uint64_t _read_operation = 0;
+#endif
+
+public:
+    UdpBench(boost::asio::io_service &ios, size_t message_size, bool uring)
+            : Bench(ios)
+            , _sender(ios, boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+            , _receiver(ios, boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+            , _endpoint(_receiver.local_endpoint())
+            , _message(std::string(message_size, 0x05)) {
+        _receiver.set_option(boost::asio::socket_base::receive_buffer_size(1 << 22));
+#ifdef HAVE_IO_URING
+        if (uring) {
+            _uring = IoUring::get(_ios);
+        }
+        if (_uring) {
+            _buffer_ring.reset(new IoUring::BufferRing(*_uring, IoUring::DATAGRAM_BUFFER_COUNT, IoUring::DATAGRAM_BUFFER_SIZE));
+            std::memset(&_recv_header, 0, sizeof(_recv_header));
+            _recv_header.msg_namelen = sizeof(sockaddr_storage);
+        }
+#endif
+    }
+
+    ~UdpBench() override {
+#ifdef HAVE_IO_URING
+        // the buffer ring is unregistered from the ring, which must still exist
+        _buffer_ring.reset();
+#endif
+    }
+
+    void start() override {
+        write();
+        read();
+    }
+
+    void stop() override {
+        _running = false;
+#ifdef HAVE_IO_URING
+        if (_uring && _read_operation) {
+            _uring->cancel(_read_operation);
+            return;
+        }
+#endif
+        boost::system::error_code err;
+        _sender.close(err);
+        _receiver.close(err);
+    }
+
+private:
+    // one round is UdpBatch::BATCH_SIZE datagrams, the next round is sent once this one is done
+    void write() {
+        ++_pending;
+        // sent with sendmmsg by both backends, as UdpMasterFace does
+        for (size_t i = 0; i < UdpBatch::BATCH_SIZE; ++i) {
+            _write_batch.push(_message, _endpoint);
+        }
+        int result = _write_batch.send(_sender.native_handle());
+        if (result < 0) {
+            // the socket buffer is full, wait for it to be writable again
+            _sender.async_send(boost::asio::null_buffers(), boost::bind(&UdpBench::writeHandler, this, _1, _2));
+            return;
+        }
+        sent += result;
+        // let the receiver run between two rounds, as UdpMasterFace posts its writes
+        _ios.post(boost::bind(&UdpBench::writeHandler, this, boost::system::error_code(), 0));
+    }
+
+    void writeHandler(const boost::system::error_code &err, size_t bytes_transferred) {
+        --_pending;
+        if (!err && _running) {
+            write();
+        }
+    }
+
+    void read() {
+        ++_pending;
+#ifdef HAVE_IO_URING
+        if (_uring && _buffer_ring->isRegistered()) {
+            _read_operation = _uring->recvmsgMultishot(_receiver.native_handle(), &_recv_header, *_buffer_ring,
+                                                       [this](int result, uint32_t flags) {
+                uringReadHandler(result, flags);
+            });
+            return;
+        }
+#endif
+        _receiver.async_receive(boost::asio::null_buffers(), boost::bind(&UdpBench::readHandler, this, _1, _2));
+    }
+
+    void readHandler(const boost::system::error_code &err, size_t bytes_transferred) {
+        if (!err && _running) {
+            if (_read_batch.receive(_receiver.native_handle())) {
+                received += _read_batch.size();
+                if (_read_batch.size() == UdpBatch::BATCH_SIZE) {
+                    _ios.post(boost::bind(&UdpBench::readHandler, this, boost::system::error_code(), 0));
+                    return;
+                }
+            }
+            --_pending;
+            read();
+            return;
+        }
+        --_pending;
+    }
+
+#ifdef HAVE_IO_URING
+    void uringReadHandler(int result, uint32_t flags) {
+        if (flags & IORING_CQE_F_BUFFER) {
+            uint16_t buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+            boost::asio::ip::udp::endpoint endpoint;
+            const char *payload;
+            size_t size;
+            if (result > 0 && IoUring::getRecvmsgPayload(&_recv_header, _buffer_ring->getBuffer(buffer_id), (size_t)result,
+                                                         endpoint, payload, size)) {
+                ++received;
+            }
+            _buffer_ring->recycle(buffer_id);
+        }
+        if (!(flags & IORING_CQE_F_MORE)) {
+            // the multishot receive ended (out of buffers or canceled), arm a new one while running
+            _read_operation = 0;
+            --_pending;
+            if (_running && (result >= 0 || result == -ENOBUFS)) {
+                read();
+            }
+        }
+    }
+#endif
+};
+
+// run a bench for the given duration and print the packets sent and received per second
+static void run(const std::string &name, bool tcp, bool uring, double seconds, size_t message_size) {
+    boost::asio::io_service ios;
+#ifdef HAVE_IO_URING
+    if (uring && !IoUring::get(ios)) {
+        std::cout << std::setw(12) << name << "  unavailable (the kernel refused the ring)" << std::endl;
+        return;
+    }
+#else
+    if (uring) {
+        std::cout << std::setw(12) << name << "  unavailable (built without HAVE_IO_URING)" << std::endl;
+        return;
+    }
+#endif
+    std::unique_ptr<Bench> bench;
+    if (tcp) {
+        bench.reset(new TcpBench(ios, message_size, uring));
+    } else {
+        bench.reset(new UdpBench(ios, message_size, uring));
+    }
+
+    bool done = false;
+    boost::asio::deadline_timer timer(ios, boost::posix_time::milliseconds((long)(seconds * 1000)));
+    timer.async_wait([&done](const boost::system::error_code &err) {
+        done = true;
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    bench->start();
+    while (!done) {
+        ios.run_one();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    uint64_t sent = bench->sent;
+    uint64_t received = bench->received;
+
+    bench->stop();
+    while (!bench->isIdle()) {
+        ios.run_one();
+    }
+    bench.reset();
+
+    std::cout << std::setw(12) << name << std::fixed << std::setprecision(0);
+    if (tcp) {
+        // the counters are in bytes, shown as packets of message_size bytes
+        std::cout << std::setw(14) << sent / message_size / elapsed << std::setw(14) << received / message_size / elapsed
+                  << std::setprecision(1) << std::setw(10) << received / elapsed / (1 << 20) << " MiB/s" << std::endl;
+    } else {
+        std::cout << std::setw(14) << sent / elapsed << std::setw(14) << received / elapsed
+                  << std::setprecision(1) << std::setw(10) << received * message_size / elapsed / (1 << 20) << " MiB/s" << std::endl;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 5;
+    size_t message_size = argc > 2 ? (size_t)std::atol(argv[2]) : 100;
+    if (seconds <= 0 || message_size == 0 || message_size > ndn::MAX_NDN_PACKET_SIZE) {
+        std::cerr << "usage: " << argv[0] << " [seconds] [message size]" << std::endl;
+        return 1;
+    }
+
+#ifdef HAVE_IO_URING
+    IoUring::setEnabled(true);
+#endif
+    std::cout << message_size << " byte packets, " << seconds << "s per run" << std::endl;
+    std::cout << std::setw(12) << "" << std::setw(14) << "sent/s" << std::setw(14) << "received/s" << std::endl;
+    run("tcp asio", true, false, seconds, message_size);
+    run("tcp uring", true, true, seconds, message_size);
+    run("udp asio", false, false, seconds, message_size);
+    run("udp uring", false, true, seconds, message_size);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// time taken to load a rule snapshot at launch as NdnFirewall::loadRules does, the file is written first (not timed)
+// with all the rules in the blacklist, then mapped and checked, and given to a RuleList while its hashes are added to
+// a cuckoo filter or to the shared rule table, the copy of the names into a std::set done before is timed apart
+// usage: snapshot_load_bench [rules] [snapshot file]
+
+#include "../rule_list.h"
+#include "../rule_snapshot.h"
+#include "../shared_rule_table.h"
+#include "../cuckoofilter/src/cuckoofilter.h"
+
+#include <sys/mman.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// as in ndn-firewall.h
+static const size_t BITS_FOR_EACH_ITEM = 12;
+
+using Clock = std::chrono::steady_clock;
+
+static void report(const std::string &step, Clock::time_point begin, size_t rules) {
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::cout << std::setw(16) << step << std::fixed << std::setprecision(0) << std::setw(10) << elapsed * 1000
+              << " ms" << std::setprecision(1) << std::setw(10) << elapsed * 1e9 / rules << " ns/rule" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    size_t rules = argc > 1 ? (size_t)std::atol(argv[1]) : 10000000;
+    std::string path = argc > 2 ? std::string(argv[2]) : "snapshot_load_bench.snapshot";
+    if (rules == 0) {
+        std::cerr << "usage: " << argv[0] << " [rules] [snapshot file]" << std::endl;
+        return 1;
+    }
+
+    {
+        // /bench/<i>/<group>, the depth of the names of a usual blacklist
+        RuleList blacklist;
+        for (size_t i = 0; i < rules; ++i) {
+            blacklist.insert("/bench/" + std::to_string(100000000 + i) + "/" + std::to_string(i % 1000));
+        }
+        RuleSnapshot::write(path, true, RuleList(), {{0, 0}}, blacklist, {{0, 0}, {3, (uint16_t)rules}});
+    }
+    std::cout << rules << " rules" << std::endl;
+
+    auto begin = Clock::now();
+    auto snapshot = std::make_shared<const RuleSnapshot>(path);
+    report("map and check", begin, rules);
+
+    {
+        cuckoofilter::CuckooFilter<size_t, BITS_FOR_EACH_ITEM> filter(rules);
+        RuleList blacklist;
+        begin = Clock::now();
+        blacklist.assign(snapshot, RuleSnapshot::BLACKLIST, [&filter](const char *name, size_t length, size_t hash) {
+            return filter.Add(hash) == cuckoofilter::Ok;
+        });
+        report("cuckoo filter", begin, rules);
+    }
+
+    {
+        auto table = SharedRuleTable::create("/snapshot_load_bench", 1, rules);
+        RuleList blacklist;
+        begin = Clock::now();
+        table->beginUpdate();
+        blacklist.assign(snapshot, RuleSnapshot::BLACKLIST, [&table](const char *name, size_t length, size_t hash) {
+            return table->add(SharedRuleTable::BLACKLIST, hash);
+        });
+        table->endUpdate();
+        report("shared table", begin, rules);
+        // the segment is left for the other processes otherwise
+        shm_unlink("/snapshot_load_bench");
+    }
+
+    {
+        std::set<std::string> blacklist;
+        begin = Clock::now();
+        snapshot->forEach(RuleSnapshot::BLACKLIST, [&blacklist](const char *name, size_t length, size_t hash) {
+            blacklist.emplace_hint(blacklist.end(), name, length);
+        });
+        report("former std::set", begin, rules);
+    }
+
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// loopback throughput of a TCP face flooded with small packets, written one async_write per packet as TcpFace used to
+// or gathered into a single async_write as StreamFace does now, the queue of the face never runs dry
+// the packets are plain buffers and nothing else runs on the io_service, it measures the write pattern alone and is an
+// upper bound of what a loaded firewall gains from it
+// usage: tcp_write_bench [seconds] [message size]
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// same caps as StreamFace
+static const size_t MAX_WRITE_BYTES = 1 << 16;
+static const size_t MAX_WRITE_BUFFERS = 64;
+static const size_t READ_SIZE = 1 << 16;
+
+class WriteBench {
+private:
+    boost::asio::ip::tcp::socket _sender;
+    boost::asio::ip::tcp::socket _receiver;
+    boost::asio::strand _strand;
+    // every packet has its own buffer like the messages queued in a face
+    std::vector<std::shared_ptr<std::string>> _messages;
+    std::vector<boost::asio::const_buffer> _write_buffers;
+    size_t _next = 0;
+    std::vector<uint8_t> _read_buffer;
+    bool _gathered;
+    bool _running = true;
+    size_t _pending = 0;
+
+public:
+    uint64_t received = 0;
+
+    WriteBench(boost::asio::io_service &ios, size_t message_size, bool gathered)
+            : _sender(ios)
+            , _receiver(ios)
+            , _strand(ios)
+            , _read_buffer(READ_SIZE)
+            , _gathered(gathered) {
+        boost::asio::ip::tcp::acceptor acceptor(ios, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        _sender.connect(acceptor.local_endpoint());
+        acceptor.accept(_receiver);
+        _sender.set_option(boost::asio::ip::tcp::no_delay(true));
+
+        for (size_t i = 0; i < MAX_WRITE_BUFFERS; ++i) {
+            _messages.push_back(std::make_shared<std::string>(message_size, 0x05));
+        }
+    }
+
+    void start() {
+        write();
+        read();
+    }
+
+    // the io_service has to run until isIdle()
+    void stop() {
+        _running = false;
+        boost::system::error_code err;
+        _sender.close(err);
+        _receiver.close(err);
+    }
+
+    bool isIdle() const {
+        return _pending == 0;
+    }
+
+private:
+    const std::string& nextMessage() {
+        const std::string &message = *_messages[_next];
+        _next = (_next + 1) % _messages.size();
+        return message;
+    }
+
+    void write() {
+        ++_pending;
+        if (!_gathered) {
+            boost::asio::async_write(_sender, boost::asio::buffer(nextMessage()),
+                                     _strand.wrap(boost::bind(&WriteBench::writeHandler, this, _1, _2)));
+            return;
+        }
+
+        _write_buffers.clear();
+        size_t bytes = 0;
+        while (_write_buffers.size() < MAX_WRITE_BUFFERS) {
+            const std::string &message = nextMessage();
+            if (!_write_buffers.empty() && bytes + message.size() > MAX_WRITE_BYTES) {
+                break;
+            }
+            _write_buffers.push_back(boost::asio::buffer(message));
+            bytes += message.size();
+        }
+        boost::asio::async_write(_sender, _write_buffers, _strand.wrap(boost::bind(&WriteBench::writeHandler, this, _1, _2)));
+    }
+
+    void writeHandler(const boost::system::error_code &err, size_t bytes_transferred) {
+        --_pending;
+        if (!err && _running) {
+            write();
+        }
+    }
+
+    void read() {
+        ++_pending;
+        _receiver.async_read_some(boost::asio::buffer(_read_buffer), boost::bind(&WriteBench::readHandler, this, _1, _2));
+    }
+
+    void readHandler(const boost::system::error_code &err, size_t bytes_transferred) {
+        --_pending;
+        if (!err) {
+            received += bytes_transferred;
+            if (_running) {
+                read();
+            }
+        }
+    }
+};
+
+static void run(const std::string &name, bool gathered, double seconds, size_t message_size) {
+    boost::asio::io_service ios;
+    std::unique_ptr<WriteBench> bench(new WriteBench(ios, message_size, gathered));
+
+    bool done = false;
+    boost::asio::deadline_timer timer(ios, boost::posix_time::milliseconds((long)(seconds * 1000)));
+    timer.async_wait([&done](const boost::system::error_code &err) {
+        done = true;
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    bench->start();
+    while (!done) {
+        ios.run_one();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    uint64_t received = bench->received;
+
+    bench->stop();
+    while (!bench->isIdle()) {
+        ios.run_one();
+    }
+
+    std::cout << std::setw(12) << name << std::fixed << std::setprecision(0)
+              << std::setw(14) << received / message_size / elapsed
+              << std::setprecision(1) << std::setw(10) << received / elapsed / (1 << 20) << " MiB/s" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 5;
+    size_t message_size = argc > 2 ? (size_t)std::atol(argv[2]) : 100;
+    if (seconds <= 0 || message_size == 0 || message_size > MAX_WRITE_BYTES) {
+        std::cerr << "usage: " << argv[0] << " [seconds] [message size]" << std::endl;
+        return 1;
+    }
+
+    std::cout << message_size << " byte packets, " << seconds << "s per run" << std::endl;
+    std::cout << std::setw(12) << "" << std::setw(14) << "packets/s" << std::endl;
+    run("per packet", false, seconds, message_size);
+    run("gathered", true, seconds, message_size);
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// framing speed of TlvFramer against the std::string the TCP faces used to append to and erase from, both are fed the
+// same stream of small Interests mixed with larger Data, either coalesced (64 KiB reads) or fragmented (reads of a
+// random size that split the packets and their headers)
+// only the framing is timed, no socket nor decoding, and the cost of a Block depends on the ndn-cxx it is built with:
+// the two framers are to be compared with each other, not with the packet rate of a TcpFace
+// usage: tlv_framer_bench [rounds] [max fragment size]
+
+#include "../tlv/tlv.h"
+#include "../tlv/tlv_framer.h"
+
+#include <ndn-cxx/encoding/block.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static const size_t PACKETS = 100000;
+static const size_t READ_SIZE = 1 << 16;
+// one Data every DATA_INTERVAL packets, large enough to need a 3 bytes length
+static const size_t DATA_INTERVAL = 16;
+static const size_t DATA_CONTENT_SIZE = 1000;
+static const uint8_t CONTENT = 0x15;
+
+static void writeElement(std::vector<uint8_t> &buffer, uint64_t type, const std::vector<uint8_t> &value) {
+    tlv::writeVarNumber(buffer, type);
+    tlv::writeVarNumber(buffer, value.size());
+    buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+// /bench/<i>/<random components>
+static std::vector<uint8_t> makeName(size_t index, std::mt19937 &random) {
+    std::vector<uint8_t> name;
+    std::vector<std::string> components = {"bench", std::to_string(index)};
+    for (size_t i = random() % 4; i > 0; --i) {
+        components.emplace_back(1 + random() % 12, 'a' + random() % 26);
+    }
+    for (const auto &component : components) {
+        writeElement(name, tlv::GENERIC_NAME_COMPONENT, std::vector<uint8_t>(component.begin(), component.end()));
+    }
+    std::vector<uint8_t> element;
+    writeElement(element, tlv::NAME, name);
+    return element;
+}
+
+static std::vector<uint8_t> makeStream(std::mt19937 &random) {
+    std::vector<uint8_t> stream;
+    for (size_t i = 0; i < PACKETS; ++i) {
+        std::vector<uint8_t> value = makeName(i, random);
+        if (i % DATA_INTERVAL == DATA_INTERVAL - 1) {
+            writeElement(value, CONTENT, std::vector<uint8_t>(DATA_CONTENT_SIZE, 0x42));
+            writeElement(stream, tlv::DATA, value);
+        } else {
+            uint32_t nonce = random();
+            writeElement(value, tlv::NONCE, std::vector<uint8_t>((uint8_t *)&nonce, (uint8_t *)&nonce + sizeof(nonce)));
+            tlv::writeNonNegativeInteger(value, tlv::INTEREST_LIFETIME, 4000);
+            writeElement(stream, tlv::INTEREST, value);
+        }
+    }
+    return stream;
+}
+
+// the former framing of the TCP faces: append every read, copy each packet into its own block and erase it
+class StringFramer {
+private:
+    std::string _stream;
+
+public:
+    void append(const uint8_t *data, size_t size) {
+        _stream.append((const char *)data, size);
+    }
+
+    void extractBlocks(std::vector<ndn::Block> &blocks) {
+        static const char delimiters[] = {tlv::INTEREST, tlv::DATA, (char)tlv::LP_PACKET, 0};
+        while (!_stream.empty()) {
+            _stream.erase(0, _stream.find_first_of(delimiters));
+            if (_stream.empty()) {
+                break;
+            }
+            const uint8_t *begin = (const uint8_t *)_stream.data();
+            const uint8_t *pos = begin + 1;
+            uint64_t length;
+            if (!tlv::readVarNumber(pos, begin + _stream.size(), length)) {
+                break;
+            }
+            uint64_t size = (pos - begin) + length;
+            if (size > ndn::MAX_NDN_PACKET_SIZE) {
+                _stream.erase(0, 1);
+            } else if (size <= _stream.size()) {
+                blocks.emplace_back(begin, size);
+                _stream.erase(0, size);
+            } else {
+                break;
+            }
+        }
+    }
+};
+
+// size of each read, the same sequence is given to both framers
+static std::vector<size_t> makeReads(size_t stream_size, size_t max_fragment, std::mt19937 &random) {
+    std::vector<size_t> reads;
+    std::uniform_int_distribution<size_t> distribution(1, max_fragment);
+    for (size_t offset = 0; offset < stream_size;) {
+        size_t size = std::min(max_fragment == 0 ? READ_SIZE : distribution(random), stream_size - offset);
+        reads.push_back(size);
+        offset += size;
+    }
+    return reads;
+}
+
+static void report(const std::string &name, size_t packets, size_t bytes, double elapsed, size_t expected) {
+    std::cout << std::setw(24) << name << std::fixed << std::setprecision(0) << std::setw(14) << packets / elapsed
+              << std::setprecision(1) << std::setw(10) << bytes / elapsed / (1 << 20) << " MiB/s";
+    if (packets != expected) {
+        std::cout << "  (" << packets << " packets framed instead of " << expected << ")";
+    }
+    std::cout << std::endl;
+}
+
+static void runFramer(const std::string &name, const std::vector<uint8_t> &stream, const std::vector<size_t> &reads, size_t rounds) {
+    TlvFramer framer;
+    std::vector<ndn::Block> blocks;
+    size_t packets = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        size_t offset = 0;
+        for (size_t size : reads) {
+            // a read may return less than what is left in the chunk, the rest comes with the next read
+            while (size > 0) {
+                auto buffer = framer.prepare();
+                size_t length = std::min(size, boost::asio::buffer_size(buffer));
+                std::memcpy(boost::asio::buffer_cast<void *>(buffer), stream.data() + offset, length);
+                framer.commit(length);
+                framer.extractBlocks(blocks);
+                packets += blocks.size();
+                blocks.clear();
+                offset += length;
+                size -= length;
+            }
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    report(name, packets, stream.size() * rounds, elapsed, PACKETS * rounds);
+}
+
+static void runString(const std::string &name, const std::vector<uint8_t> &stream, const std::vector<size_t> &reads, size_t rounds) {
+    StringFramer framer;
+    std::vector<ndn::Block> blocks;
+    size_t packets = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        size_t offset = 0;
+        for (size_t size : reads) {
+            framer.append(stream.data() + offset, size);
+            framer.extractBlocks(blocks);
+            packets += blocks.size();
+            blocks.clear();
+            offset += size;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    report(name, packets, stream.size() * rounds, elapsed, PACKETS * rounds);
+}
+
+int main(int argc, char *argv[]) {
+    size_t rounds = argc > 1 ? (size_t)std::atol(argv[1]) : 20;
+    size_t max_fragment = argc > 2 ? (size_t)std::atol(argv[2]) : 200;
+    if (rounds == 0 || max_fragment == 0) {
+        std::cerr << "usage: " << argv[0] << " [rounds] [max fragment size]" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 random(42);
+    std::vector<uint8_t> stream = makeStream(random);
+    std::vector<size_t> coalesced = makeReads(stream.size(), 0, random);
+    std::vector<size_t> fragmented = makeReads(stream.size(), max_fragment, random);
+
+    std::cout << PACKETS << " packets (" << stream.size() << " bytes) x " << rounds << " rounds, fragments of 1 to "
+              << max_fragment << " bytes" << std::endl;
+    std::cout << std::setw(24) << "" << std::setw(14) << "packets/s" << std::endl;
+    runString("coalesced string", stream, coalesced, rounds);
+    runFramer("coalesced TlvFramer", stream, coalesced, rounds);
+    runString("fragmented string", stream, fragmented, rounds);
+    runFramer("fragmented TlvFramer", stream, fragmented, rounds);
+    return 0;
+}
@@ -0,0 +1,308 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "control_channel.h"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+#include "rapidjson/include/rapidjson/reader.h"
+#include "log/logger.h"
+
+namespace {
+    // {"type":[string, ...], ...}, the changes are only kept if the whole line is valid
+    struct RuleChangeHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, RuleChangeHandler> {
+        enum State {
+            START,
+            KEY,
+            ARRAY,
+            VALUES,
+            END
+        };
+
+        State state = START;
+        RuleChange::Type type = RuleChange::MODE;
+        std::vector<RuleChange> changes;
+        std::string reason;
+
+        bool StartObject() {
+            if (state != START) {
+                return fail("only arrays of strings are expected in the object");
+            }
+            state = KEY;
+            return true;
+        }
+
+        bool Key(const char *str, rapidjson::SizeType length, bool copy) {
+            if (!RuleChange::fromString(str, length, type)) {
+                return fail("'" + std::string(str, length) + "' is not a change of the rules");
+            }
+            state = ARRAY;
+            return true;
+        }
+
+        bool StartArray() {
+            if (state != ARRAY) {
+                return fail("the value of a change has to be an array of strings");
+            }
+            state = VALUES;
+            return true;
+        }
+
+        bool String(const char *str, rapidjson::SizeType length, bool copy) {
+            if (state != VALUES) {
+                return fail("the value of a change has to be an array of strings");
+            }
+            std::string value(str, length);
+            if (type == RuleChange::MODE && value != "accept" && value != "drop") {
+                return fail("the mode has to be 'accept' or 'drop'");
+            }
+            changes.push_back({type, std::move(value)});
+            return true;
+        }
+
+        bool EndArray(rapidjson::SizeType count) {
+            state = KEY;
+            return true;
+        }
+
+        bool EndObject(rapidjson::SizeType count) {
+            state = END;
+            return true;
+        }
+
+        // numbers, booleans, null
+        bool Default() {
+            return fail("the value of a change has to be an array of strings");
+        }
+
+        bool fail(const std::string &why) {
+            if (reason.empty()) {
+                reason = why;
+            }
+            return false;
+        }
+    };
+}
+
+ControlChannel::Session::Session(ControlChannel &channel, boost::asio::ip::tcp::socket &&socket)
+        : _channel(channel)
+        , _socket(std::move(socket)) {
+    boost::system::error_code err;
+    std::stringstream ss;
+    ss << _socket.remote_endpoint(err);
+    _endpoint = ss.str();
+}
+
+const std::string& ControlChannel::Session::getEndpoint() const {
+    return _endpoint;
+}
+
+void ControlChannel::Session::open() {
+    read();
+}
+
+void ControlChannel::Session::close() {
+    boost::system::error_code err;
+    _socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, err);
+    _socket.close(err);
+    _channel.onSessionClosed(shared_from_this());
+}
+
+void ControlChannel::Session::read() {
+    _socket.async_read_some(_buffer.prepare(BUFFER_SIZE),
+                            boost::bind(&Session::readHandler, shared_from_this(), _1, _2));
+}
+
+void ControlChannel::Session::readHandler(const boost::system::error_code &err, size_t bytes_transferred) {
+    if (err == boost::asio::error::eof) {
+        // the last line may have no newline, the last batch no blank line
+        if (!_line.empty()) {
+            addLine();
+        }
+        if (_lines != 0) {
+            _closing = true;
+            endBatch();
+            return;
+        }
+    }
+    if (err) {
+        if (err != boost::asio::error::operation_aborted) {
+            std::stringstream ss;
+            ss << "command connection from tcp://" << _endpoint << " closed after " << _batches << " batches";
+            logger::log(logger::INFO, ss.str());
+            close();
+        }
+        return;
+    }
+    _buffer.commit(bytes_transferred);
+    processLines();
+}
+
+void ControlChannel::Session::processLines() {
+    const char *begin = boost::asio::buffer_cast<const char*>(_buffer.data());
+    const char *end = begin + _buffer.size();
+    const char *data = begin;
+    bool complete = false;
+    for (const char *newline; !complete && (newline = std::find(data, end, '\n')) != end; data = newline + 1) {
+        _line.append(data, newline);
+        if (!_line.empty() && _line.back() == '\r') {
+            _line.pop_back();
+        }
+        if (!_line.empty()) {
+            addLine();
+        } else {
+            // blank lines before a batch are ignored
+            complete = _lines != 0;
+        }
+    }
+    if (!complete) {
+        // the beginning of the next line
+        _line.append(data, end);
+        data = end;
+    }
+    // the lines after a complete batch wait in the buffer until its answer is sent
+    _buffer.consume(data - begin);
+
+    if (_line.size() > MAX_LINE_SIZE || _changes.size() > MAX_BATCH_CHANGES) {
+        std::stringstream ss;
+        ss << "command connection from tcp://" << _endpoint << " sent ";
+        if (_line.size() > MAX_LINE_SIZE) {
+            ss << "a line longer than " << MAX_LINE_SIZE << " bytes";
+        } else {
+            ss << "a batch of more than " << MAX_BATCH_CHANGES << " changes";
+        }
+        ss << ", it is closed";
+        logger::log(logger::WARNING, ss.str());
+        close();
+        return;
+    }
+    if (complete) {
+        endBatch();
+    } else {
+        read();
+    }
+}
+
+void ControlChannel::Session::addLine() {
+    ++_lines;
+    std::string reason;
+    if (!parseLine(_line, _changes, reason)) {
+        ++_errors;
+        if (_reasons.size() < MAX_REASONS) {
+            _reasons.push_back("line " + std::to_string(_lines) + ": " + reason);
+        }
+    }
+    _line.clear();
+}
+
+void ControlChannel::Session::endBatch() {
+    size_t applied = _changes.empty() ? 0 : _channel._batch_callback(_changes, _reasons);
+    if (_reasons.size() > MAX_REASONS) {
+        _reasons.resize(MAX_REASONS);
+    }
+    ++_batches;
+    _summary = R"({"batch":)" + std::to_string(_batches) + R"(, "lines":)" + std::to_string(_lines) +
+               R"(, "changes":)" + std::to_string(_changes.size()) + R"(, "applied":)" + std::to_string(applied) +
+               R"(, "errors":)" + std::to_string(_errors) + R"(, "reasons":[)";
+    for (size_t i = 0; i < _reasons.size(); ++i) {
+        _summary += i == 0 ? "" : ", ";
+        replication::appendString(_summary, _reasons[i]);
+    }
+    _summary += "]}\n";
+    _lines = 0;
+    _errors = 0;
+    _changes.clear();
+    _reasons.clear();
+    boost::asio::async_write(_socket, boost::asio::buffer(_summary),
+                             boost::bind(&Session::writeHandler, shared_from_this(), _1));
+}
+
+void ControlChannel::Session::writeHandler(const boost::system::error_code &err) {
+    if (!err && _closing) {
+        std::stringstream ss;
+        ss << "command connection from tcp://" << _endpoint << " closed after " << _batches << " batches";
+        logger::log(logger::INFO, ss.str());
+        close();
+    } else if (!err) {
+        // the next batch may already be in the buffer
+        processLines();
+    } else if (err != boost::asio::error::operation_aborted) {
+        std::cerr << err.message() << std::endl;
+        close();
+    }
+}
+
+bool ControlChannel::Session::parseLine(const std::string &line, std::vector<RuleChange> &changes,
+                                        std::string &reason) {
+    RuleChangeHandler handler;
+    rapidjson::Reader reader;
+    rapidjson::StringStream stream(line.c_str());
+    reader.Parse(stream, handler);
+    if (reader.HasParseError() || handler.state != RuleChangeHandler::END) {
+        reason = !handler.reason.empty() ? handler.reason :
+                 "syntax error at offset " + std::to_string(reader.GetErrorOffset());
+        return false;
+    }
+    changes.insert(changes.end(), std::make_move_iterator(handler.changes.begin()),
+                   std::make_move_iterator(handler.changes.end()));
+    return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+ControlChannel::ControlChannel(boost::asio::io_service &ios, const std::string &address, uint16_t port)
+        : _ios(ios)
+        , _acceptor(ios, boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(address), port))
+        , _socket(ios) {
+
+}
+
+void ControlChannel::open(const BatchCallback &batch_callback) {
+    _batch_callback = batch_callback;
+    _acceptor.listen(16);
+    std::stringstream ss;
+    ss << "accepting bulk changes of the rules on tcp://" << _acceptor.local_endpoint();
+    logger::log(logger::INFO, ss.str());
+    accept();
+}
+
+void ControlChannel::accept() {
+    _acceptor.async_accept(_socket, boost::bind(&ControlChannel::acceptHandler, this, _1));
+}
+
+void ControlChannel::acceptHandler(const boost::system::error_code &err) {
+    if (!err) {
+        auto session = std::make_shared<Session>(*this, std::move(_socket));
+        _socket = boost::asio::ip::tcp::socket(_ios);
+        std::stringstream ss;
+        ss << "new command connection from tcp://" << session->getEndpoint();
+        logger::log(logger::INFO, ss.str());
+        _sessions.insert(session);
+        session->open();
+        accept();
+    } else if (err != boost::asio::error::operation_aborted) {
+        std::cerr << err.message() << std::endl;
+        accept();
+    }
+}
+
+void ControlChannel::onSessionClosed(const std::shared_ptr<Session> &session) {
+    _sessions.erase(session);
+}
@@ -0,0 +1,115 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "replication.h"
+
+// bulk changes of the rules over TCP, one JSON object per line, e.g., {"append-drop":["/a", "/b"]} (the names of
+// the 'post' method changing the rules), parsed with the SAX reader so that a long line is never held as a document
+// a blank line (or the end of the connection) ends a batch, each batch is applied at once and answered with one
+// line, nothing more is read until the answer is sent so that the answers come in the order of the batches and a
+// client pushing faster than the rules are applied is slowed down by TCP
+// {"batch":1, "lines":120, "changes":50000, "applied":49998, "errors":2, "reasons":["..."]}
+class ControlChannel {
+public:
+    // applies the changes, returns how many changed the rules, the reasons of the others up to MAX_REASONS
+    using BatchCallback = std::function<size_t(const std::vector<RuleChange> &changes,
+                                               std::vector<std::string> &reasons)>;
+
+    static const size_t BUFFER_SIZE = 1 << 16;
+    // a line longer than that, or a batch with more changes, closes the connection
+    static const size_t MAX_LINE_SIZE = 1 << 26;
+    static const size_t MAX_BATCH_CHANGES = 1 << 22;
+    static const size_t MAX_REASONS = 8;
+
+private:
+    class Session : public std::enable_shared_from_this<Session> {
+    private:
+        ControlChannel &_channel;
+        boost::asio::ip::tcp::socket _socket;
+        std::string _endpoint;
+        boost::asio::streambuf _buffer;
+        std::string _line;
+        // the batch being read
+        size_t _lines = 0;
+        size_t _errors = 0;
+        std::vector<RuleChange> _changes;
+        std::vector<std::string> _reasons;
+        std::string _summary;
+        uint64_t _batches = 0;
+        // the connection is closed once the answer of the last batch is sent
+        bool _closing = false;
+
+    public:
+        Session(ControlChannel &channel, boost::asio::ip::tcp::socket &&socket);
+
+        const std::string& getEndpoint() const;
+
+        void open();
+
+        void close();
+
+    private:
+        void read();
+
+        void readHandler(const boost::system::error_code &err, size_t bytes_transferred);
+
+        // the lines received up to the end of a batch, which is then applied, read() again if it is not complete
+        void processLines();
+
+        // _line into the batch
+        void addLine();
+
+        // applies the batch and sends its answer
+        void endBatch();
+
+        void writeHandler(const boost::system::error_code &err);
+
+        // false and reason set if the line is not an object of rule changes
+        static bool parseLine(const std::string &line, std::vector<RuleChange> &changes, std::string &reason);
+    };
+
+    boost::asio::io_service &_ios;
+    boost::asio::ip::tcp::acceptor _acceptor;
+    boost::asio::ip::tcp::socket _socket;
+    BatchCallback _batch_callback;
+    std::unordered_set<std::shared_ptr<Session>> _sessions;
+
+public:
+    // the handlers run on ios, it must be the one of the online commands so that no lock is needed
+    ControlChannel(boost::asio::io_service &ios, const std::string &address, uint16_t port);
+
+    ~ControlChannel() = default;
+
+    void open(const BatchCallback &batch_callback);
+
+private:
+    void accept();
+
+    void acceptHandler(const boost::system::error_code &err);
+
+    void onSessionClosed(const std::shared_ptr<Session> &session);
+};
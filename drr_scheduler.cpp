@@ -0,0 +1,253 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "drr_scheduler.h"
+
+#include "network/send_queue.h"
+
+// the remote address of a face from its endpoint (e.g., 10.0.0.1:6363 or [::1]:6363)
+static bool getAddress(const Face &face, boost::asio::ip::address &address) {
+    std::string endpoint = face.getUnderlyingEndpoint();
+    size_t pos = endpoint.rfind(':');
+    if (pos == std::string::npos) {
+        return false;
+    }
+    std::string host = endpoint.substr(0, pos);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    boost::system::error_code err;
+    address = boost::asio::ip::address::from_string(host, err);
+    return !err;
+}
+
+static bool isInNetwork(const boost::asio::ip::address &address, const boost::asio::ip::address &network,
+                        unsigned prefix_length) {
+    if (address.is_v4() && network.is_v4()) {
+        uint32_t mask = prefix_length == 0 ? 0 : 0xFFFFFFFF << (32 - prefix_length);
+        return (address.to_v4().to_ulong() & mask) == (network.to_v4().to_ulong() & mask);
+    }
+    if (address.is_v6() && network.is_v6()) {
+        auto a = address.to_v6().to_bytes();
+        auto n = network.to_v6().to_bytes();
+        for (unsigned i = 0; i < 16 && prefix_length > 0; ++i) {
+            unsigned bits = prefix_length < 8 ? prefix_length : 8;
+            uint8_t mask = (uint8_t)(0xFF << (8 - bits));
+            if ((a[i] & mask) != (n[i] & mask)) {
+                return false;
+            }
+            prefix_length -= bits;
+        }
+        return true;
+    }
+    return false;
+}
+
+DrrScheduler::DrrScheduler(boost::asio::io_service &ios, const std::shared_ptr<Face> &egress_face,
+                           const std::vector<Weight> &weights, const std::shared_ptr<IngressLimit> &ingress_limit)
+        : _ios(ios)
+        , _egress_face(egress_face)
+        , _ingress_limit(ingress_limit)
+        , _max_backlog(SendQueueLimits::getMaxPackets())
+        , _weights(weights)
+        , _in_flight_packets(0)
+        , _in_flight_bytes(0)
+        , _waiting(false)
+        , _dropped_packets(0) {
+
+}
+
+DrrScheduler::~DrrScheduler() {
+    if ((_ingress_limit->backlog -= _backlog) < _max_backlog / 4) {
+        _ingress_limit->gate->open();
+    }
+}
+
+const std::shared_ptr<Face>& DrrScheduler::getEgressFace() const {
+    return _egress_face;
+}
+
+uint64_t DrrScheduler::getDroppedPackets() const {
+    return _dropped_packets;
+}
+
+void DrrScheduler::enqueue(const std::shared_ptr<Face> &face, const ndn::Block &wire) {
+    bool wait;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_active.empty() && hasCredit(wire.size())) {
+            // nothing to share, no need to queue
+            send(wire);
+            return;
+        }
+
+        auto it = _flows.find(face);
+        if (it == _flows.end()) {
+            // forget the faces gone since, their packets can't be answered anyway
+            for (auto f = _flows.begin(); f != _flows.end();) {
+                if (f->first.expired() && !f->second.active) {
+                    f = _flows.erase(f);
+                } else {
+                    ++f;
+                }
+            }
+            it = _flows.emplace(face, Flow(QUANTUM * getWeight(*face))).first;
+        }
+        Flow &flow = it->second;
+        if (flow.queue.size() >= MAX_FLOW_PACKETS) {
+            // the face only hurts itself
+            ++_dropped_packets;
+            return;
+        }
+        flow.queue.push_back(wire);
+        if (!flow.active) {
+            flow.active = true;
+            _active.push_back(it);
+        }
+        ++_backlog;
+        if (++_ingress_limit->backlog >= _max_backlog / 2) {
+            _ingress_limit->gate->close();
+        }
+
+        wait = drain();
+    }
+    if (wait) {
+        waitForCredit();
+    }
+}
+
+bool DrrScheduler::hasCredit(size_t size) const {
+    // a packet larger than EGRESS_HIGH_BYTES still goes once nothing else is in flight
+    size_t bytes = _in_flight_bytes;
+    return _in_flight_packets < EGRESS_HIGH_PACKETS && (bytes == 0 || bytes + size <= EGRESS_HIGH_BYTES);
+}
+
+void DrrScheduler::send(const ndn::Block &wire) {
+    _in_flight_packets += 1;
+    _in_flight_bytes += wire.size();
+    // the block given to the egress face owns the credit through an aliasing pointer to the same buffer, the face and
+    // its send queue are unchanged
+    auto credit = std::make_shared<Credit>(shared_from_this(), wire.getBuffer(), wire.size());
+    ndn::ConstBufferPtr buffer(credit, credit->buffer.get());
+    _egress_face->send(ndn::Block(buffer, wire.begin(), wire.end(), false));
+}
+
+void DrrScheduler::release(size_t size) {
+    // the face may drop a packet inside send() with _mutex held, the flows are resumed from _ios
+    size_t packets = --_in_flight_packets;
+    size_t bytes = (_in_flight_bytes -= size);
+    if (packets <= EGRESS_HIGH_PACKETS / 2 && bytes <= EGRESS_HIGH_BYTES / 2 && _waiting.exchange(false)) {
+        std::weak_ptr<DrrScheduler> weak = shared_from_this();
+        _ios.post([weak]() {
+            if (auto self = weak.lock()) {
+                self->resume();
+            }
+        });
+    }
+}
+
+void DrrScheduler::waitForCredit() {
+    _waiting = true;
+    // the last credit may have come back between drain() and now, nobody else would resume the flows
+    if (_in_flight_packets == 0 && _waiting.exchange(false)) {
+        resume();
+    }
+}
+
+void DrrScheduler::resume() {
+    bool wait;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        wait = drain();
+    }
+    if (wait) {
+        waitForCredit();
+    }
+}
+
+bool DrrScheduler::drain() {
+    while (!_active.empty()) {
+        auto it = _active.front();
+        Flow &flow = it->second;
+        if (!_quantum_given) {
+            flow.deficit += flow.quantum;
+            _quantum_given = true;
+        }
+        if (!flow.queue.empty() && flow.queue.front().size() <= flow.deficit) {
+            if (!hasCredit(flow.queue.front().size())) {
+                break;
+            }
+            flow.deficit -= flow.queue.front().size();
+            send(flow.queue.front());
+            flow.queue.pop_front();
+            --_backlog;
+            --_ingress_limit->backlog;
+            continue;
+        }
+        // end of the turn of this flow
+        _active.pop_front();
+        if (flow.queue.empty()) {
+            flow.active = false;
+            flow.deficit = 0;
+        } else {
+            _active.push_back(it);
+        }
+        _quantum_given = false;
+    }
+    if (_ingress_limit->backlog < _max_backlog / 4) {
+        _ingress_limit->gate->open();
+    }
+    return !_active.empty();
+}
+
+size_t DrrScheduler::getWeight(const Face &face) const {
+    boost::asio::ip::address address;
+    if (_weights.empty() || !getAddress(face, address)) {
+        return 1;
+    }
+    // the longest matching prefix wins
+    const Weight *best = nullptr;
+    for (const auto &weight : _weights) {
+        if (isInNetwork(address, weight.network, weight.prefix_length) &&
+            (!best || weight.prefix_length > best->prefix_length)) {
+            best = &weight;
+        }
+    }
+    return best ? best->weight : 1;
+}
+
+bool DrrScheduler::parseWeight(const std::string &value, Weight &weight) {
+    size_t slash = value.find('/');
+    size_t equal = value.find('=');
+    if (equal == std::string::npos || equal + 1 == value.size()) {
+        return false;
+    }
+    std::string network = value.substr(0, slash < equal ? slash : equal);
+    boost::system::error_code err;
+    weight.network = boost::asio::ip::address::from_string(network, err);
+    if (err) {
+        return false;
+    }
+    unsigned max_length = weight.network.is_v4() ? 32 : 128;
+    try {
+        weight.prefix_length = slash < equal ? (unsigned)std::stoul(value.substr(slash + 1, equal - slash - 1)) : max_length;
+        weight.weight = (size_t)std::stoul(value.substr(equal + 1));
+    } catch (const std::exception &e) {
+        return false;
+    }
+    return weight.prefix_length <= max_length && weight.weight > 0;
+}
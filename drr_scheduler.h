@@ -0,0 +1,152 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/encoding/block.hpp>
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "network/face.h"
+#include "network/read_gate.h"
+
+// deficit round-robin between the ingress faces in front of the egress face, at most EGRESS_HIGH_PACKETS and
+// EGRESS_HIGH_BYTES sent by the scheduler wait in the send queue of the egress face so the backlog waits in one flow
+// per ingress face where a heavy consumer can only delay itself
+class DrrScheduler : public std::enable_shared_from_this<DrrScheduler> {
+public:
+    // bytes a flow of weight 1 may send per round, a whole packet always fits
+    static const size_t QUANTUM = ndn::MAX_NDN_PACKET_SIZE;
+    static const size_t MAX_FLOW_PACKETS = 256;
+    // packets sent to the egress face and not written yet, the scheduler resumes once they are down to half of it
+    static const size_t EGRESS_HIGH_PACKETS = 64;
+    static const size_t EGRESS_HIGH_BYTES = 1 << 16;
+
+    // faces whose remote address is in network/prefix_length get weight times the quantum
+    struct Weight {
+        boost::asio::ip::address network;
+        unsigned prefix_length;
+        size_t weight;
+    };
+
+    // shared by the schedulers of all the upstreams, the ingress faces stop reading on their total backlog
+    struct IngressLimit {
+        std::shared_ptr<ReadGate> gate;
+        std::atomic<size_t> backlog;
+
+        IngressLimit() : gate(std::make_shared<ReadGate>()), backlog(0) {
+
+        }
+    };
+
+private:
+    struct Flow {
+        std::deque<ndn::Block> queue;
+        size_t quantum;
+        size_t deficit = 0;
+        bool active = false;
+
+        explicit Flow(size_t quantum) : quantum(quantum) {
+
+        }
+    };
+
+    // shares the buffer of a packet sent to the egress face, the credit of the packet comes back when the face is
+    // done with the last copy of its block, whether it was written or dropped
+    struct Credit {
+        std::weak_ptr<DrrScheduler> scheduler;
+        ndn::ConstBufferPtr buffer;
+        size_t size;
+
+        Credit(const std::shared_ptr<DrrScheduler> &scheduler, const ndn::ConstBufferPtr &buffer, size_t size)
+                : scheduler(scheduler), buffer(buffer), size(size) {
+
+        }
+
+        ~Credit() {
+            if (auto self = scheduler.lock()) {
+                self->release(size);
+            }
+        }
+    };
+
+    using FlowMap = std::map<std::weak_ptr<Face>, Flow, std::owner_less<std::weak_ptr<Face>>>;
+
+    std::mutex _mutex;
+
+    boost::asio::io_service &_ios;
+    std::shared_ptr<Face> _egress_face;
+    std::shared_ptr<IngressLimit> _ingress_limit;
+    size_t _max_backlog;
+    std::vector<Weight> _weights;
+
+    FlowMap _flows;
+    std::deque<FlowMap::iterator> _active;
+    // the flow in front of _active already got its quantum for this round
+    bool _quantum_given = false;
+    size_t _backlog = 0;
+    // sent to the egress face and not released yet
+    std::atomic<size_t> _in_flight_packets;
+    std::atomic<size_t> _in_flight_bytes;
+    // flows are left but out of credit, the next release below the low marks resumes them
+    std::atomic<bool> _waiting;
+    std::atomic<uint64_t> _dropped_packets;
+
+public:
+    // the flows resume on ios once the egress face has written enough of what it was given
+    DrrScheduler(boost::asio::io_service &ios, const std::shared_ptr<Face> &egress_face, const std::vector<Weight> &weights,
+                 const std::shared_ptr<IngressLimit> &ingress_limit);
+
+    // the packets still queued no longer count in the ingress backlog
+    ~DrrScheduler();
+
+    const std::shared_ptr<Face>& getEgressFace() const;
+
+    uint64_t getDroppedPackets() const;
+
+    // send the wire received by face to the egress face, now if nothing is waiting, else in its turn
+    void enqueue(const std::shared_ptr<Face> &face, const ndn::Block &wire);
+
+    // parse network/prefix_length=weight (e.g., 10.0.0.0/8=4)
+    static bool parseWeight(const std::string &value, Weight &weight);
+
+private:
+    bool hasCredit(size_t size) const;
+
+    // send wire to the egress face with a credit of its size, _mutex must be held
+    void send(const ndn::Block &wire);
+
+    // called when the egress face drops the last copy of a packet sent, may run on any thread with or without _mutex
+    void release(size_t size);
+
+    void waitForCredit();
+
+    void resume();
+
+    // send as much packets as the credit allows, return true if packets are left, _mutex must be held
+    bool drain();
+
+    size_t getWeight(const Face &face) const;
+};
@@ -0,0 +1,50 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dump_page.h"
+
+DumpPage::DumpPage(size_t max_entries)
+        : _writer(_buffer)
+        , _max_entries(max_entries) {
+    _writer.StartObject();
+}
+
+DumpPage::Writer& DumpPage::getWriter() {
+    return _writer;
+}
+
+void DumpPage::startEntries(const char *key) {
+    _writer.Key(key);
+    _writer.StartArray();
+}
+
+size_t DumpPage::size() const {
+    return _entries;
+}
+
+const std::string& DumpPage::finish(bool more) {
+    _writer.EndArray();
+    _writer.Key("next");
+    if (more) {
+        _writer.String(_last.c_str(), static_cast<rapidjson::SizeType>(_last.size()));
+    } else {
+        _writer.Null();
+    }
+    _writer.EndObject();
+    _last.assign(_buffer.GetString(), _buffer.GetSize());
+    return _last;
+}
@@ -0,0 +1,76 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "rapidjson/include/rapidjson/stringbuffer.h"
+#include "rapidjson/include/rapidjson/writer.h"
+
+// one page of a dump answered in one datagram, {..., "<key>":[entry, ...], "next":<cursor>}, streamed with the writer
+// the entries are added in order until the page is full, the client asks for the next page from the cursor
+class DumpPage {
+public:
+    using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
+
+    // under the maximum UDP payload
+    static const size_t MAX_SIZE = 60000;
+
+private:
+    rapidjson::StringBuffer _buffer;
+    Writer _writer;
+    // the entry being added, dropped if it doesn't fit
+    rapidjson::StringBuffer _entry;
+    size_t _max_entries;
+    size_t _entries = 0;
+    std::string _last;
+
+public:
+    explicit DumpPage(size_t max_entries);
+
+    ~DumpPage() = default;
+
+    // to write the members before the entries
+    Writer& getWriter();
+
+    void startEntries(const char *key);
+
+    // false if the page is full, write_entry writes one value with the writer it's given, name is its cursor
+    template <class F>
+    bool add(const std::string &name, rapidjson::Type type, F write_entry) {
+        if (_entries >= _max_entries) {
+            return false;
+        }
+        _entry.Clear();
+        Writer writer(_entry);
+        write_entry(writer);
+        // the cursor closing the page is not longer than the entry, a first entry always fits
+        if (_entries > 0 && _buffer.GetSize() + 2 * _entry.GetSize() + 16 > MAX_SIZE) {
+            return false;
+        }
+        _writer.RawValue(_entry.GetString(), _entry.GetSize(), type);
+        _last = name;
+        ++_entries;
+        return true;
+    }
+
+    size_t size() const;
+
+    // the whole page, "next" is the name of the last entry if more is left, null otherwise
+    const std::string& finish(bool more);
+};
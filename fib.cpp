@@ -0,0 +1,64 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fib.h"
+
+Fib::Fib() : _size(0) {
+
+}
+
+size_t Fib::size() const {
+    return _size;
+}
+
+void Fib::insert(const ndn::Name &prefix, const Upstreams &upstreams) {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
+    if (!_tree.find(prefix)) {
+        ++_size;
+    }
+    _tree.insert(prefix, std::make_shared<Upstreams>(upstreams), true);
+}
+
+bool Fib::remove(const ndn::Name &prefix) {
+    boost::unique_lock<boost::shared_mutex> lock(_mutex);
+    if (!_tree.find(prefix)) {
+        return false;
+    }
+    _tree.remove(prefix);
+    --_size;
+    return true;
+}
+
+std::shared_ptr<const Fib::Upstreams> Fib::findLongestPrefix(const ndn::Name &name) const {
+    if (_size == 0) {
+        // no lookup until the first route is added
+        return nullptr;
+    }
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    return _tree.findLastUntil(name).second;
+}
+
+std::vector<std::pair<ndn::Name, std::shared_ptr<const Fib::Upstreams>>> Fib::list() const {
+    std::vector<std::pair<ndn::Name, std::shared_ptr<const Upstreams>>> routes;
+    boost::shared_lock<boost::shared_mutex> lock(_mutex);
+    for (const auto &node : _tree.findAllFrom("/")) {
+        if (node.second) {
+            routes.emplace_back(node.first, node.second);
+        }
+    }
+    return routes;
+}
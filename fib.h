@@ -0,0 +1,61 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/name.hpp>
+
+#include <boost/thread/shared_mutex.hpp>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "tree/named_tree.h"
+
+// name prefixes to the upstreams serving them, an Interest goes to the upstreams of its longest matching prefix and
+// to all the upstreams if none matches
+class Fib {
+public:
+    // indexes in the UpstreamSet
+    using Upstreams = std::vector<size_t>;
+
+private:
+    // read by every worker and only written by the command handler
+    mutable boost::shared_mutex _mutex;
+
+    NamedTree<Upstreams> _tree;
+    std::atomic<size_t> _size;
+
+public:
+    Fib();
+
+    ~Fib() = default;
+
+    size_t size() const;
+
+    // replace the upstreams of the prefix if it is already there
+    void insert(const ndn::Name &prefix, const Upstreams &upstreams);
+
+    bool remove(const ndn::Name &prefix);
+
+    // nullptr if no prefix of the name is in the FIB
+    std::shared_ptr<const Upstreams> findLongestPrefix(const ndn::Name &name) const;
+
+    std::vector<std::pair<ndn::Name, std::shared_ptr<const Upstreams>>> list() const;
+};
@@ -17,8 +17,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstdio>
 #include <cctype>
+#include <sstream>
+#include <vector>
 #include <ndn-cxx/common.hpp>
 #include "ndn-firewall.h"
+#include "network/io_service_pool.h"
+#include "network/io_uring.h"
+#include "network/send_queue.h"
 #include "log/logger.h"
 
 bool checkUnsignedInt(char *p) {
@@ -30,29 +35,97 @@ bool checkUnsignedInt(char *p) {
     return result != 0;
 }
 
-static bool stop = false;
-static boost::asio::io_service ios;
+// parse a comma separated list of cpu numbers (e.g., 0,2,4,6)
+bool checkCpuList(char *p, std::vector<int> &cpus) {
+    std::stringstream ss(p);
+    std::string cpu;
+    while (std::getline(ss, cpu, ',')) {
+        if (cpu.empty() || !checkUnsignedInt(&cpu[0])) {
+            return false;
+        }
+        cpus.push_back(atoi(cpu.c_str()));
+    }
+    return !cpus.empty();
+}
 
-static void signal_handler(int signum) {
-    ios.stop();
-    stop = true;
+// address or address:port ([address]:port for IPv6), the port is 0 if not given
+bool checkRemoteList(char *p, std::vector<std::pair<std::string, uint16_t>> &remotes) {
+    std::stringstream ss(p);
+    std::string remote;
+    while (std::getline(ss, remote, ',')) {
+        std::string address = remote;
+        std::string port;
+        size_t pos = remote.rfind(':');
+        if (!remote.empty() && remote[0] == '[') {
+            if (pos == std::string::npos || pos == 0 || remote[pos - 1] != ']') {
+                return false;
+            }
+            address = remote.substr(1, pos - 2);
+            port = remote.substr(pos + 1);
+        } else if (pos != std::string::npos && remote.find(':') == pos) {
+            address = remote.substr(0, pos);
+            port = remote.substr(pos + 1);
+        }
+        boost::system::error_code ec;
+        boost::asio::ip::address::from_string(address, ec);
+        if (ec || (!port.empty() && (!checkUnsignedInt(&port[0]) || atoi(port.c_str()) == 0))) {
+            return false;
+        }
+        remotes.emplace_back(address, port.empty() ? 0 : (uint16_t) atoi(port.c_str()));
+    }
+    return !remotes.empty();
 }
 
+bool checkWeightList(char *p, std::vector<DrrScheduler::Weight> &weights) {
+    std::stringstream ss(p);
+    std::string value;
+    while (std::getline(ss, value, ',')) {
+        DrrScheduler::Weight weight;
+        if (!DrrScheduler::parseWeight(value, weight)) {
+            return false;
+        }
+        weights.push_back(weight);
+    }
+    return !weights.empty();
+}
+
+static bool stop = false;
+static std::unique_ptr<IoServicePool> pool;
+
 int main(int argc, char *argv[]) {
     logger::setFilename("log.txt");
     logger::isTee(true);
     logger::setMinimalLogLevel(logger::INFO);
 
-    boost::asio::io_service::work work(ios);
-
     // default parameters
     std::string mode = "accept";
     size_t totalItemsInWhitelist = 1000000;
     size_t totalItemsInBlacklist = 1000000;
     uint16_t localPort = 6361;
+    uint16_t localUdpPort = 0;
+    std::string localInterface;
+    std::string localUnixPath;
     uint16_t localPortForCommand = 6362;
-    std::string remoteAddress = "127.0.0.1";
+    uint16_t localTcpPortForCommand = 0;
+    std::string localTcpAddressForCommand = "127.0.0.1";
+    std::vector<std::pair<std::string, uint16_t>> remoteAddresses = {{"127.0.0.1", 0}};
     uint16_t remotePort = 6363;
+    uint16_t remoteUdpPort = 0;
+    std::vector<std::string> remoteUnixPaths;
+    size_t threads = 1;
+    std::vector<int> cpus;
+    bool nack = false;
+    size_t queuePackets = SendQueueLimits::DEFAULT_MAX_PACKETS;
+    size_t queueBytes = SendQueueLimits::DEFAULT_MAX_BYTES;
+    SendQueueLimits::Policy queuePolicy = SendQueueLimits::DROP_TAIL;
+    std::vector<DrrScheduler::Weight> weights;
+    std::string probeName = "/localhost/nfd/status/general";
+    size_t rttDepth = 1;
+    std::string sharedRulesName;
+    uint16_t replicationPort = 0;
+    std::string replicationAddress = "127.0.0.1";
+    std::pair<std::string, uint16_t> replicationSource;
+    std::string snapshotPath;
 
     bool breakCheck = false;
 
@@ -98,6 +171,18 @@ int main(int argc, char *argv[]) {
                 breakCheck = true;
                 break;
             }
+        } else if (!strcmp(argv[i], "-lup")) {
+            if (checkUnsignedInt(argv[i + 1])) {
+                localUdpPort = (uint16_t) atoi(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-li")) {
+            localInterface = std::string(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-lu")) {
+            localUnixPath = std::string(argv[i + 1]);
         } else if (!strcmp(argv[i], "-lpc")) {
             if (checkUnsignedInt(argv[i + 1])) {
                 localPortForCommand = (uint16_t) atoi(argv[i + 1]);
@@ -106,11 +191,27 @@ int main(int argc, char *argv[]) {
                 breakCheck = true;
                 break;
             }
-        } else if (!strcmp(argv[i], "-ra")) {
-            remoteAddress = std::string(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-lpt")) {
+            if (checkUnsignedInt(argv[i + 1])) {
+                localTcpPortForCommand = (uint16_t) atoi(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-lta")) {
             boost::system::error_code ec;
-            boost::asio::ip::address::from_string(remoteAddress, ec);
-            if (ec) {
+            boost::asio::ip::address::from_string(argv[i + 1], ec);
+            if (!ec) {
+                localTcpAddressForCommand = std::string(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-ra")) {
+            remoteAddresses.clear();
+            if (!checkRemoteList(argv[i + 1], remoteAddresses)) {
                 std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
                 breakCheck = true;
                 break;
@@ -123,12 +224,148 @@ int main(int argc, char *argv[]) {
                 breakCheck = true;
                 break;
             }
+        } else if (!strcmp(argv[i], "-rup")) {
+            if (checkUnsignedInt(argv[i + 1])) {
+                remoteUdpPort = (uint16_t) atoi(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-ru")) {
+            std::stringstream ss(argv[i + 1]);
+            std::string path;
+            while (std::getline(ss, path, ',')) {
+                if (!path.empty()) {
+                    remoteUnixPaths.push_back(path);
+                }
+            }
+        } else if (!strcmp(argv[i], "-rd")) {
+            if (checkUnsignedInt(argv[i + 1])) {
+                rttDepth = (size_t) atoi(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-sr")) {
+            // a POSIX shared memory object name has a single leading slash
+            if (argv[i + 1][0] == '/' && argv[i + 1][1] != '\0' && !strchr(argv[i + 1] + 1, '/')) {
+                sharedRulesName = std::string(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-rl")) {
+            if (checkUnsignedInt(argv[i + 1])) {
+                replicationPort = (uint16_t) atoi(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-rla")) {
+            boost::system::error_code ec;
+            boost::asio::ip::address::from_string(argv[i + 1], ec);
+            if (!ec) {
+                replicationAddress = std::string(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-rf")) {
+            std::vector<std::pair<std::string, uint16_t>> sources;
+            if (checkRemoteList(argv[i + 1], sources) && sources.size() == 1 && sources[0].second != 0) {
+                replicationSource = sources[0];
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-sn")) {
+            snapshotPath = std::string(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-hp")) {
+            probeName = strcmp(argv[i + 1], "none") ? std::string(argv[i + 1]) : std::string();
+        } else if (!strcmp(argv[i], "-t")) {
+            if (checkUnsignedInt(argv[i + 1]) && atoi(argv[i + 1]) > 0) {
+                threads = (size_t) atoi(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-io")) {
+            if (!strcmp(argv[i + 1], "asio")) {
+#ifdef HAVE_IO_URING
+                IoUring::setEnabled(false);
+            } else if (!strcmp(argv[i + 1], "uring")) {
+                IoUring::setEnabled(true);
+#endif
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-nack")) {
+            if (!strcmp(argv[i + 1], "on") || !strcmp(argv[i + 1], "off")) {
+                nack = !strcmp(argv[i + 1], "on");
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-qp")) {
+            if (checkUnsignedInt(argv[i + 1]) && atoi(argv[i + 1]) > 0) {
+                queuePackets = (size_t) atoi(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-qb")) {
+            if (checkUnsignedInt(argv[i + 1]) && atoi(argv[i + 1]) > 0) {
+                queueBytes = (size_t) atoi(argv[i + 1]);
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-qo")) {
+            if (!strcmp(argv[i + 1], "drop-tail")) {
+                queuePolicy = SendQueueLimits::DROP_TAIL;
+            } else if (!strcmp(argv[i + 1], "drop-oldest")) {
+                queuePolicy = SendQueueLimits::DROP_OLDEST;
+            } else if (!strcmp(argv[i + 1], "close")) {
+                queuePolicy = SendQueueLimits::CLOSE;
+            } else {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-dw")) {
+            if (!checkWeightList(argv[i + 1], weights)) {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
+        } else if (!strcmp(argv[i], "-ca")) {
+            if (!checkCpuList(argv[i + 1], cpus)) {
+                std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
+                breakCheck = true;
+                break;
+            }
         } else {
             std::cout << "invalid option: " << argv[i] << " " << argv[i + 1] << std::endl;
             breakCheck = true;
             break;
         }
     }
+    if (!breakCheck && replicationPort != 0 && !replicationSource.first.empty()) {
+        std::cout << "invalid options: -rl and -rf can't be combined" << std::endl;
+        breakCheck = true;
+    }
     if (breakCheck) {
         std::cout << "version: 0.1.0\n"
                   << "usage: " << argv[0] << " [options...]\n"
@@ -136,26 +373,82 @@ int main(int argc, char *argv[]) {
                   << " -w\t# of items in whitelist (e.g., [-w 1000000])\t# default = 1000000\n"
                   << " -b\t# of items in blacklist (e.g., [-b 1000000])\t# default = 1000000\n"
                   << " -lp\tlocal port # (e.g., [-lp 6361])\t\t\t# default = 6361\n"
-                  << " -lpc\tlocal port # for command (e.g., [-lpc 6362])\t# default = 6362\n"
-                  << " -ra\tremote address (e.g., [-ra 127.0.0.1])\t\t# default = 127.0.0.1\n"
+                  << " -lup\tlocal UDP port # (e.g., [-lup 6361])\t\t# default = 0 (disabled)\n"
+                  << " -li\tlocal Ethernet interface (e.g., [-li eth0])\t# default = none (disabled)\n"
+                  << " -lu\tlocal Unix socket (e.g., [-lu /tmp/fw.sock])\t# default = none (disabled)\n"
+                  << " -lpc\tlocal port # for command (e.g., [-lpc 6362])\t# default = 6362 (0 = none, worker of -sr)\n"
+                  << " -lpt\tlocal TCP port # for bulk rules (e.g., [-lpt 6362])\t# default = 0 (disabled)\n"
+                  << " -lta\tlocal address for bulk rules (e.g., [-lta 0.0.0.0])\t# default = 127.0.0.1\n"
+                  << " -ra\tremote addresses (e.g., [-ra 10.0.0.1,10.0.0.2:6364])\t# default = 127.0.0.1\n"
                   << " -rp\tremote port # (e.g., [-rp 6363])\t\t# default = 6363\n"
+                  << " -rup\tremote UDP port # (e.g., [-rup 6363])\t\t# default = 0 (use -rp)\n"
+                  << " -ru\tremote Unix sockets (e.g., [-ru /run/nfd.sock])\t# default = none (use -ra and -rp)\n"
+                  << " -hp\thealth probe name (e.g., [-hp /localhost/nfd/status/general])\t# default = /localhost/nfd/status/general (local NFDs only)\n"
+                  << " -rd\tRTT prefix depth (e.g., [-rd 2])\t\t\t# default = 1\n"
+                  << " -t\t# of worker threads (e.g., [-t 4])\t\t# default = 1\n"
+                  << " -ca\tcpu of each worker (e.g., [-ca 0,1,2,3])\t# default = not pinned\n"
+                  << " -io\tface backend ([-io asio] or [-io uring])\t# default = asio\n"
+                  << " -nack\tNack dropped Interests ([-nack on|off])\t# default = off\n"
+                  << " -qp\tmax packets per send queue (e.g., [-qp 4096])\t# default = 4096\n"
+                  << " -qb\tmax bytes per send queue (e.g., [-qb 4194304])\t# default = 4194304\n"
+                  << " -qo\tqueue overflow ([-qo drop-tail|drop-oldest|close])\t# default = drop-tail\n"
+                  << " -dw\tweight of consumers (e.g., [-dw 10.0.0.0/8=4,::1=2])\t# default = 1\n"
+                  << " -sr\tshared memory rule table (e.g., [-sr /ndnfirewall])\t# default = none (rules of this process)\n"
+                  << " -rl\tport # for the replicas (e.g., [-rl 6364])\t# default = 0 (disabled)\n"
+                  << " -rla\taddress for the replicas (e.g., [-rla 0.0.0.0])\t# default = 127.0.0.1\n"
+                  << " -rf\treplicate the rules of (e.g., [-rf 10.0.0.1:6364])\t# default = none (disabled)\n"
+                  << " -sn\trule snapshot file (e.g., [-sn rules.snapshot])\t# default = none (disabled)\n"
                   << " -h\thelp"
                   << std::endl;
         return 1;
     }
 
-    cuckooFilterForNdnFirewall cuckooFilterForWhitelist(totalItemsInWhitelist);
-    cuckooFilterForNdnFirewall cuckooFilterForBlacklist(totalItemsInBlacklist);
+    // the process with the command port writes the shared rules, the others only read them
+    std::shared_ptr<SharedRuleTable> sharedRules;
+    if (!sharedRulesName.empty()) {
+        try {
+            if (localPortForCommand != 0) {
+                sharedRules = SharedRuleTable::create(sharedRulesName, totalItemsInWhitelist, totalItemsInBlacklist);
+            } else {
+                sharedRules = SharedRuleTable::attach(sharedRulesName);
+            }
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // the cuckoo filters are not used with shared rules
+    cuckooFilterForNdnFirewall cuckooFilterForWhitelist(sharedRules ? 1 : totalItemsInWhitelist);
+    cuckooFilterForNdnFirewall cuckooFilterForBlacklist(sharedRules ? 1 : totalItemsInBlacklist);
+
+    SendQueueLimits::set(queuePackets, queueBytes, queuePolicy);
 
-    NdnFirewall ndnFirewall(ios, mode, totalItemsInWhitelist, totalItemsInBlacklist, cuckooFilterForWhitelist,
-                            cuckooFilterForBlacklist, localPort, localPortForCommand, remoteAddress, remotePort);
+    pool.reset(new IoServicePool(threads));
+    pool->setCpuAffinity(cpus);
+
+    NdnFirewall ndnFirewall(*pool, mode, totalItemsInWhitelist, totalItemsInBlacklist, cuckooFilterForWhitelist,
+                            cuckooFilterForBlacklist, localPort, localUdpPort, localInterface, localUnixPath,
+                            localPortForCommand, remoteAddresses, remotePort, remoteUdpPort, remoteUnixPaths,
+                            nack, weights, probeName, rttDepth, sharedRules, replicationPort, replicationAddress,
+                            replicationSource, snapshotPath, localTcpPortForCommand, localTcpAddressForCommand);
     ndnFirewall.start();
 
-    signal(SIGINT, signal_handler);
+    // SIGTERM is what service managers and container runtimes send, the rules are saved on both
+    boost::asio::signal_set signals(pool->getIoService(0), SIGINT, SIGTERM);
+    signals.async_wait([](const boost::system::error_code &err, int signum) {
+        if (!err) {
+            stop = true;
+            pool->stop();
+        }
+    });
 
     do {
-        ios.run();
+        pool->run();
     } while (!stop);
 
+    // the workers are stopped, the rules are loaded from there at the next launch
+    ndnFirewall.saveRules();
+
     return 0;
 }
\ No newline at end of file
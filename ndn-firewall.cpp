@@ -17,52 +17,214 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ndn-firewall.h"
 
+#include <ndn-cxx/lp/tags.hpp>
+
 #include <boost/bind.hpp>
 #include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <unistd.h>
 
 #include "network/tcp_master_face.h"
 #include "network/tcp_face.h"
 #include "network/udp_master_face.h"
 #include "network/udp_face.h"
+#include "network/unix_master_face.h"
+#include "network/unix_face.h"
+#include "network/ethernet_master_face.h"
 #include "log/logger.h"
 
-NdnFirewall::NdnFirewall(boost::asio::io_service &ios, std::string &mode,
+// ndn::Name throws on what it can't parse as a URI
+static bool isName(const rapidjson::Value &value) {
+    if (!value.IsString()) {
+        return false;
+    }
+    try {
+        ndn::Name name(value.GetString());
+    } catch (const std::exception &e) {
+        return false;
+    }
+    return true;
+}
+
+NdnFirewall::NdnFirewall(IoServicePool &pool, std::string &mode,
                          size_t &totalItemsInWhitelist, size_t &totalItemsInBlacklist,
                          cuckooFilterForNdnFirewall &cuckooFilterForWhitelist,
                          cuckooFilterForNdnFirewall &cuckooFilterForBlacklist,
-                         const uint16_t &localPort, const uint16_t &localPortForCommand,
-                         const std::string &remoteAddress, const uint16_t &remotePort) :
-        m_ios(ios), m_mode(mode),
+                         const uint16_t &localPort, const uint16_t &localUdpPort,
+                         const std::string &localInterface, const std::string &localUnixPath,
+                         const uint16_t &localPortForCommand,
+                         const std::vector<std::pair<std::string, uint16_t>> &remoteAddresses,
+                         const uint16_t &remotePort, const uint16_t &remoteUdpPort,
+                         const std::vector<std::string> &remoteUnixPaths, const bool &nack,
+                         const std::vector<DrrScheduler::Weight> &weights, const std::string &probeName,
+                         const size_t &rttDepth, const std::shared_ptr<SharedRuleTable> &sharedRules,
+                         const uint16_t &replicationPort, const std::string &replicationAddress,
+                         const std::pair<std::string, uint16_t> &replicationSource,
+                         const std::string &snapshotPath, const uint16_t &localTcpPortForCommand,
+                         const std::string &localTcpAddressForCommand) :
+        m_pool(pool), m_mode(mode), m_nack(nack),
         m_totalItemsInWhitelist(totalItemsInWhitelist), m_totalItemsInBlacklist(totalItemsInBlacklist),
         m_cuckooFilterForWhitelist(cuckooFilterForWhitelist), m_cuckooFilterForBlacklist(cuckooFilterForBlacklist),
         m_slashCounterForWhitelist(1, std::make_pair(0, 0)), m_slashCounterForBlacklist(1, std::make_pair(0, 0)),
-        m_commandSocket(ios, {boost::asio::ip::udp::v4(), localPortForCommand}),
-        m_egressFace(std::make_shared<TcpFace>(ios, remoteAddress, remotePort)),
-        m_ingressMasterFace(std::make_shared<TcpMasterFace>(ios, 128, localPort)),
-        m_pit(1000000) {
+        m_sharedRules(sharedRules), m_commandSocket(pool.getIoService(0)), m_pit(1000000, rttDepth),
+        m_snapshotPath(snapshotPath) {
+    // the workers of a multi-process firewall have no command socket, they follow the shared rules
+    if (localPortForCommand != 0) {
+        m_commandSocket.open(boost::asio::ip::udp::v4());
+        m_commandSocket.bind({boost::asio::ip::udp::v4(), localPortForCommand});
+        if (m_sharedRules) {
+            m_sharedRules->beginUpdate();
+            m_sharedRules->setDropMode(m_mode == "drop");
+            m_sharedRules->endUpdate();
+        }
+        if (localTcpPortForCommand != 0) {
+            m_controlChannel.reset(new ControlChannel(pool.getIoService(0), localTcpAddressForCommand,
+                                                      localTcpPortForCommand));
+        }
+    }
+    // on the io_service of the online commands, the rules are only changed there
+    if (replicationPort != 0) {
+        m_replicationServer.reset(new ReplicationServer(pool.getIoService(0), replicationAddress, replicationPort));
+    } else if (!replicationSource.first.empty()) {
+        m_replicationClient.reset(new ReplicationClient(pool.getIoService(0), replicationSource.first,
+                                                        replicationSource.second));
+    }
+    m_upstreams.reset(new UpstreamSet(pool.getIoService(0), weights, probeName));
+    // the upstream faces are spread over the workers, a failed face is created again by its factory
+    IoServicePool *p = &pool;
+    // a NFD running on the same host is better reached through its Unix socket
+    for (const auto &path : remoteUnixPaths) {
+        size_t worker = m_upstreams->size() % pool.size();
+        m_upstreams->add("unix://" + path, [p, worker, path]() -> std::shared_ptr<Face> {
+            return std::make_shared<UnixFace>(p->getIoService(worker), path);
+        }, true);
+    }
+    if (remoteUnixPaths.empty()) {
+        for (const auto &remote : remoteAddresses) {
+            size_t worker = m_upstreams->size() % pool.size();
+            std::string address = remote.first;
+            bool local = boost::asio::ip::address::from_string(address).is_loopback();
+            std::stringstream ss;
+            if (remoteUdpPort != 0) {
+                // no head-of-line blocking between the Interests of different consumers
+                uint16_t port = remote.second != 0 ? remote.second : remoteUdpPort;
+                ss << "udp://" << boost::asio::ip::udp::endpoint(boost::asio::ip::address::from_string(address), port);
+                m_upstreams->add(ss.str(), [p, worker, address, port]() -> std::shared_ptr<Face> {
+                    return std::make_shared<UdpFace>(p->getIoService(worker), address, port);
+                }, local);
+            } else {
+                uint16_t port = remote.second != 0 ? remote.second : remotePort;
+                ss << "tcp://" << boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(address), port);
+                m_upstreams->add(ss.str(), [p, worker, address, port]() -> std::shared_ptr<Face> {
+                    return std::make_shared<TcpFace>(p->getIoService(worker), address, port);
+                }, local);
+            }
+        }
+    }
+    // the firewall processes sharing their rules also share the ingress ports
+    bool reusePort = m_sharedRules != nullptr;
+    m_ingressMasterFaces.emplace_back(std::make_shared<TcpMasterFace>(pool, 128, localPort, reusePort));
+    if (!localUnixPath.empty()) {
+        m_ingressMasterFaces.emplace_back(std::make_shared<UnixMasterFace>(pool, 128, localUnixPath));
+    }
+    if (localUdpPort != 0) {
+        // one SO_REUSEPORT socket per worker, each with its own sub-faces
+        for (size_t i = 0; i < pool.size(); ++i) {
+            m_ingressMasterFaces.emplace_back(std::make_shared<UdpMasterFace>(pool.getIoService(i), 128, localUdpPort,
+                                                                              pool.size() > 1 || reusePort,
+                                                                              pool.getCpu(i)));
+        }
+    }
+#ifdef __linux__
+    if (!localInterface.empty()) {
+        // one ring per worker in a fanout group of this process, each with its own sub-faces
+        int fanoutGroup = pool.size() > 1 ? getpid() & 0xffff : -1;
+        for (size_t i = 0; i < pool.size(); ++i) {
+            m_ingressMasterFaces.emplace_back(std::make_shared<EthernetMasterFace>(pool.getIoService(i), 128,
+                                                                                   localInterface, fanoutGroup));
+        }
+    }
+#endif
+    loadRules();
 }
 
 void NdnFirewall::start() {
-    commandRead();
-    m_egressFace->open(boost::bind(&NdnFirewall::onEgressInterest, this, _1, _2),
-                       boost::bind(&NdnFirewall::onEgressData, this, _1, _2),
-                       boost::bind(&NdnFirewall::onFaceError, this, _1));
-    m_ingressMasterFace->listen(boost::bind(&NdnFirewall::onMasterFaceNotification, this, _1, _2),
-                                boost::bind(&NdnFirewall::onIngressInterest, this, _1, _2),
-                                boost::bind(&NdnFirewall::onIngressData, this, _1, _2),
-                                boost::bind(&NdnFirewall::onMasterFaceError, this, _1, _2));
-}
-
-void NdnFirewall::onIngressInterest(const std::shared_ptr<Face> &face, const ndn::Interest &interest) {
-    std::string uri = interest.getName().toUri();
+    if (m_commandSocket.is_open()) {
+        commandRead();
+    }
+    if (m_controlChannel) {
+        m_controlChannel->open(boost::bind(&NdnFirewall::applyRuleBatch, this, _1, _2));
+    }
+    if (m_replicationServer) {
+        m_replicationServer->open(boost::bind(&NdnFirewall::getRuleSnapshot, this));
+    } else if (m_replicationClient) {
+        m_replicationClient->open(boost::bind(&NdnFirewall::onReplicatedChanges, this, _1, _2, _3));
+    }
+    // the ingress faces stop reading while the schedulers hold too many packets for the upstreams
+    for (const auto &masterFace : m_ingressMasterFaces) {
+        masterFace->setReadGate(m_upstreams->getIngressGate());
+    }
+    m_upstreams->open(boost::bind(&NdnFirewall::onEgressInterest, this, _1, _2),
+                      boost::bind(&NdnFirewall::onEgressData, this, _1, _2),
+                      boost::bind(&NdnFirewall::onFaceError, this, _1),
+                      boost::bind(&Pit::isPending, &m_pit, _1));
+    for (const auto &masterFace : m_ingressMasterFaces) {
+        masterFace->listen(boost::bind(&NdnFirewall::onMasterFaceNotification, this, _1, _2),
+                           boost::bind(&NdnFirewall::onIngressInterest, this, _1, _2),
+                           boost::bind(&NdnFirewall::onIngressData, this, _1, _2),
+                           boost::bind(&NdnFirewall::onMasterFaceError, this, _1, _2));
+    }
+}
+
+void NdnFirewall::onIngressInterest(const std::shared_ptr<Face> &face, const InterestView &interest) {
+    std::string uri = interest.getNameUri();
     if (interestNameFilter(uri)) {
-        if (m_pit.insert(interest, face)) {
-            m_egressFace->send(interest);
+        switch (m_pit.insert(interest, uri, face)) {
+            case Pit::FORWARD: {
+                // only the upstreams of the longest FIB prefix, all of them if none matches
+                auto upstreams = m_fib.size() != 0 ? m_fib.findLongestPrefix(interest.getName()) : nullptr;
+                // forward the original wire untouched, in the turn of the face
+                if (!m_upstreams->forward(face, uri, interest, upstreams.get())) {
+                    std::stringstream ss;
+                    ss << "no healthy upstream, the Interest name " << uri << " was dropped";
+                    logger::log(logger::WARNING, ss.str());
+                    // the Interests aggregated meanwhile would otherwise wait for their lifetime, and the
+                    // retransmissions would be suppressed
+                    for (const auto &f : m_pit.remove(interest)) {
+                        sendNack(f.first, interest, LpPacket::NACK_NO_ROUTE, f.second);
+                    }
+                }
+                break;
+            }
+            case Pit::FULL: {
+                std::stringstream ss;
+                ss << "the PIT is full, the Interest name " << uri << " was dropped";
+                logger::log(logger::WARNING, ss.str());
+                sendNack(face, interest, LpPacket::NACK_CONGESTION);
+                break;
+            }
+            default:
+                break;
         }
     } else {
         std::stringstream ss;
         ss << "the Interest name " << uri << " was dropped";
         logger::log(logger::INFO, ss.str());
+        sendNack(face, interest, LpPacket::NACK_NO_ROUTE);
+    }
+}
+
+void NdnFirewall::sendNack(const std::shared_ptr<Face> &face, const InterestView &interest, LpPacket::NackReason reason) {
+    sendNack(face, interest, reason, interest.getPitToken());
+}
+
+void NdnFirewall::sendNack(const std::shared_ptr<Face> &face, const InterestView &interest, LpPacket::NackReason reason,
+                           const std::string &pitToken) {
+    // the consumer does not have to wait for the Interest lifetime
+    if (m_nack) {
+        face->send(LpPacket::encodeNack(interest.wireEncode(), reason, pitToken));
     }
 }
 
@@ -70,15 +232,31 @@ void NdnFirewall::onIngressData(const std::shared_ptr<Face> &face, const ndn::Da
 //    m_egressFace->send(data);
 }
 
-void NdnFirewall::onEgressInterest(const std::shared_ptr<Face> &face, const ndn::Interest &interest) {
-//    m_ingressMasterFace->sendToAllFaces(interest);
+void NdnFirewall::onEgressInterest(const std::shared_ptr<Face> &face, const InterestView &interest) {
+//    for (const auto &masterFace : m_ingressMasterFaces) {
+//        masterFace->sendToAllFaces(interest);
+//    }
 }
 
 void NdnFirewall::onEgressData(const std::shared_ptr<Face> &face, const ndn::Data &data) {
-//    m_ingressMasterFace->sendToAllFaces(data);
+//    for (const auto &masterFace : m_ingressMasterFaces) {
+//        masterFace->sendToAllFaces(data);
+//    }
+    m_upstreams->onData(face);
+    // the Data of any upstream satisfies the Interests, whichever upstream they were forwarded to
     auto faces = m_pit.get(data);
+    LpHeaders headers;
+    if (auto congestion_mark = data.getTag<ndn::lp::CongestionMarkTag>()) {
+        headers.congestion_mark = congestion_mark->get();
+    }
     for (const auto &f : faces) {
-        f->send(data);
+        // the PitToken of the Interest goes back with the Data
+        headers.pit_token = f.second;
+        if (headers.empty()) {
+            f.first->send(data);
+        } else {
+            f.first->send(LpPacket::encode(data.wireEncode(), headers));
+        }
     }
 }
 
@@ -93,27 +271,24 @@ void NdnFirewall::onMasterFaceNotification(const std::shared_ptr<MasterFace> &ma
 void NdnFirewall::onMasterFaceError(const std::shared_ptr<MasterFace> &master_face, const std::shared_ptr<Face> &face) {
     std::stringstream ss;
     ss << "face with ID = " << face->getFaceId() << " from master face with ID = " << master_face->getMasterFaceId()
-       << " can't process normally";
+       << " can't process normally (" << face->getDroppedPackets() << " packets dropped by the face, "
+       << master_face->getDroppedPackets() << " by the master face)";
     logger::log(logger::ERROR, ss.str());
 }
 
 void NdnFirewall::onFaceError(const std::shared_ptr<Face> &face) {
     std::stringstream ss;
-    ss << "face with ID = " << face->getFaceId() << " can't process normally";
+    ss << "upstream face with ID = " << face->getFaceId() << " can't process normally ("
+       << face->getDroppedPackets() << " packets dropped, " << m_upstreams->getDroppedPackets()
+       << " by the schedulers of all the upstreams)";
     logger::log(logger::ERROR, ss.str());
-    if (face == m_egressFace) {
-        exit(-1);
-    }
 }
 
-bool NdnFirewall::interestNameFilter(std::string uri) {
-    if (m_slashCounterForWhitelist.back().first == 0 &&
-        m_slashCounterForBlacklist.back().first == 0) { // rules do not exist in both lists
-        if (m_mode == "accept") {
-            return true;
-        } else if (m_mode == "drop") {
-            return false;
-        }
+template <class Contains>
+bool NdnFirewall::matchRules(const std::string &uri, uint16_t whitelistDepth, uint16_t blacklistDepth, bool dropMode,
+                             const Contains &contains) {
+    if (whitelistDepth == 0 && blacklistDepth == 0) { // rules do not exist in both lists
+        return !dropMode;
     } else {
         uint16_t slashCounter = 0;
         std::vector<uint16_t> lengthOfEachNamePrefix;
@@ -126,8 +301,7 @@ bool NdnFirewall::interestNameFilter(std::string uri) {
                 slashCounter++;
                 if (slashCounter != 1) {
                     lengthOfEachNamePrefix.push_back(characterCounter);
-                    if (slashCounter ==
-                        std::max(m_slashCounterForWhitelist.back().first, m_slashCounterForBlacklist.back().first)) {
+                    if (slashCounter == std::max(whitelistDepth, blacklistDepth)) {
                         breakCheck = true;
                         break;
                     }
@@ -147,12 +321,10 @@ bool NdnFirewall::interestNameFilter(std::string uri) {
         while (it != lengthOfEachNamePrefix.rend()) {
             std::string namePrefix = uri.substr(0, *it);
             size_t hash = std::hash<std::string>()(namePrefix);
-            if (m_slashCounterForWhitelist.back().first >= slashCounter &&
-                m_cuckooFilterForWhitelist.Contain(hash) == cuckoofilter::Ok) {
+            if (whitelistDepth >= slashCounter && contains(true, hash)) {
                 whitelistCheck = true;
                 break;
-            } else if (m_slashCounterForBlacklist.back().first >= slashCounter &&
-                       m_cuckooFilterForBlacklist.Contain(hash) == cuckoofilter::Ok) {
+            } else if (blacklistDepth >= slashCounter && contains(false, hash)) {
                 blacklistCheck = true;
                 break;
             }
@@ -165,13 +337,35 @@ bool NdnFirewall::interestNameFilter(std::string uri) {
         } else if (blacklistCheck) {
             return false;   // e.g., drop /a
         } else {
-            if (m_mode == "accept") {   // accept Interest if the Interest is listed in neither whitelist nor blacklist
-                return true;
-            } else if (m_mode == "drop") {// drop Interest if the Interest is listed in neither whitelist nor blacklist
-                return false;
+            // accept or drop Interest if the Interest is listed in neither whitelist nor blacklist
+            return !dropMode;
+        }
+    }
+}
+
+bool NdnFirewall::interestNameFilter(std::string uri) {
+    if (m_sharedRules) {
+        // lock-free, the name is checked again if the control process changed the rules meanwhile
+        const SharedRuleTable &rules = *m_sharedRules;
+        for (size_t retries = 0; retries < SharedRuleTable::MAX_READ_RETRIES; ++retries) {
+            uint64_t version = rules.readBegin();
+            bool result = matchRules(uri, rules.getDepth(version, SharedRuleTable::WHITELIST),
+                                     rules.getDepth(version, SharedRuleTable::BLACKLIST), rules.isDropMode(version),
+                                     [&rules, version](bool whitelist, size_t hash) {
+                return rules.contains(version, whitelist ? SharedRuleTable::WHITELIST : SharedRuleTable::BLACKLIST, hash);
+            });
+            if (!rules.readRetry(version)) {
+                return result;
             }
         }
+        // the rules keep changing under this reader, a firewall must not let the name through without checking it
+        return false;
     }
+    boost::shared_lock<boost::shared_mutex> lock(m_rulesMutex);
+    return matchRules(uri, m_slashCounterForWhitelist.back().first, m_slashCounterForBlacklist.back().first,
+                      m_mode == "drop", [this](bool whitelist, size_t hash) {
+        return (whitelist ? m_cuckooFilterForWhitelist : m_cuckooFilterForBlacklist).Contain(hash) == cuckoofilter::Ok;
+    });
 }
 
 void NdnFirewall::commandRead() {
@@ -195,11 +389,14 @@ void NdnFirewall::commandReadHandler(const boost::system::error_code &err, size_
                 }
             }
             if (syntaxCheck) {
+                // the rules are only written on this io_service, reading them does not need to stop the workers
                 for (const auto &pair : document.GetObject()) {
                     std::string memberName = pair.name.GetString();
                     if (memberName == "get") {
+                        boost::shared_lock<boost::shared_mutex> lock(m_rulesMutex);
                         commandGet(document);
                     } else if (memberName == "post") {
+                        // takes the lock itself, only to apply the changes
                         commandPost(document);
                     }
                 }
@@ -219,8 +416,9 @@ void NdnFirewall::commandGet(const rapidjson::Document &document) {
         bool syntaxCheck = true;
         for (const auto &pair : document["get"].GetObject()) {
             std::string memberName = pair.name.GetString();
-            if (memberName != "mode" && memberName != "rules") {
-                std::string response = R"({"status":"syntax error", "reason":"only 'mode' or 'rules' are supported in 'get' method"})";
+            if (memberName != "mode" && memberName != "rules" && memberName != "fib" && memberName != "upstreams" &&
+                memberName != "rtt" && memberName != "replication" && memberName != "dump") {
+                std::string response = R"({"status":"syntax error", "reason":"only 'mode', 'rules', 'fib', 'upstreams', 'rtt', 'replication', or 'dump' are supported in 'get' method"})";
                 m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
                 syntaxCheck = false;
                 break;
@@ -232,8 +430,26 @@ void NdnFirewall::commandGet(const rapidjson::Document &document) {
                 break;
             }
             for (const auto &value : document["get"][memberName.c_str()].GetArray()) {
-                if (memberName == "mode") {
-                    std::string response = R"({"status":"syntax error", "reason":"'mode' array has to be empty"})";
+                if (memberName == "rtt") {
+                    if (!value.IsString() || document["get"]["rtt"].Size() > 1) {
+                        std::string response = R"({"status":"syntax error", "reason":"'rtt' array has to be empty or hold the 'next' cursor of the previous page"})";
+                        m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+                        syntaxCheck = false;
+                        break;
+                    }
+                } else if (memberName == "dump") {
+                    if (!value.IsObject() || !value.HasMember("table") || !value["table"].IsString() ||
+                        (value["table"] != "white" && value["table"] != "black" && value["table"] != "pit") ||
+                        (value.HasMember("prefix") && !value["prefix"].IsString()) ||
+                        (value.HasMember("after") && !value["after"].IsString()) ||
+                        (value.HasMember("limit") && (!value["limit"].IsUint() || value["limit"].GetUint() == 0))) {
+                        std::string response = R"({"status":"syntax error", "reason":"value in 'dump' array has to be an object with a 'table' ('white', 'black', or 'pit'), and optionally a 'prefix', an 'after' cursor, and a 'limit'"})";
+                        m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+                        syntaxCheck = false;
+                        break;
+                    }
+                } else if (memberName != "rules") {
+                    std::string response = R"({"status":"syntax error", "reason":"')" + memberName + R"(' array has to be empty"})";
                     m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
                     syntaxCheck = false;
                     break;
@@ -262,6 +478,20 @@ void NdnFirewall::commandGet(const rapidjson::Document &document) {
                             getRules(m_blacklist, value.GetString());
                         }
                     }
+                } else if (memberName == "fib") {
+                    getFib();
+                } else if (memberName == "upstreams") {
+                    std::string response = R"({"upstreams":)" + m_upstreams->toJSON() + "}";
+                    m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+                } else if (memberName == "rtt") {
+                    const auto &cursor = document["get"]["rtt"];
+                    getRtt(cursor.Size() == 0 ? "" : cursor.GetArray().begin()->GetString());
+                } else if (memberName == "replication") {
+                    getReplication();
+                } else if (memberName == "dump") {
+                    for (const auto &value : document["get"]["dump"].GetArray()) {
+                        getDump(value);
+                    }
                 }
             }
         }
@@ -271,22 +501,104 @@ void NdnFirewall::commandGet(const rapidjson::Document &document) {
     }
 }
 
-void NdnFirewall::getRules(const std::set<std::string> &list, const std::string &value) {
-    std::string response("[");
-    for (const auto &namePrefix : list) {
-        response = response + "\"" + namePrefix + "\", ";
+void NdnFirewall::getRules(const RuleList &list, const std::string &value) {
+    // a list too large for one datagram is continued with 'dump'
+    DumpPage page(std::numeric_limits<size_t>::max());
+    page.startEntries(value == "white" ? "whitelist" : "blacklist");
+    bool more = dumpRules(list, "/", "", page);
+    boost::system::error_code err;
+    m_commandSocket.send_to(boost::asio::buffer(page.finish(more)), m_remoteEndpoint, 0, err);
+    if (err) {
+        std::cerr << err.message() << std::endl;
     }
-    if (response != "[") {   // rules do not exist in whitelist or blacklist
-        response.pop_back();    // ' '
-        response.pop_back();    // ','
+}
+
+bool NdnFirewall::dumpRules(const RuleList &list, const std::string &prefix, const std::string &after,
+                            DumpPage &page) {
+    auto add = [&page](const std::string &namePrefix) {
+        return page.add(namePrefix, rapidjson::kStringType, [&namePrefix](DumpPage::Writer &writer) {
+            writer.String(namePrefix.c_str(), static_cast<rapidjson::SizeType>(namePrefix.size()));
+        });
+    };
+    std::string scope = prefix;
+    while (!scope.empty() && scope.back() == '/') {
+        scope.pop_back();
     }
-    response.push_back(']');
-    if (value == "white") {
-        response = R"({"whitelist":)" + response + R"(})";
-    } else if (value == "black") {
-        response = R"({"blacklist":)" + response + R"(})";
+    // the rule of the prefix itself, then the range of those under it, '0' follows '/' so the rules only sharing
+    // the characters of the prefix (e.g., /a-b for /a) are never visited
+    std::string children = scope + "/";
+    if (!scope.empty() && (after.empty() || after < scope) && list.contains(scope) && !add(scope)) {
+        return true;
+    }
+    std::string end = scope + "0";
+    auto it = after.empty() || after < children ? list.lower_bound(children) : list.upper_bound(after);
+    for (; it != list.end() && (scope.empty() || *it < end); ++it) {
+        if (!add(*it)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void NdnFirewall::getDump(const rapidjson::Value &request) {
+    std::string table = request["table"].GetString();
+    std::string prefix = request.HasMember("prefix") ? request["prefix"].GetString() : "/";
+    std::string after = request.HasMember("after") ? request["after"].GetString() : "";
+    size_t limit = request.HasMember("limit") ? request["limit"].GetUint() : std::numeric_limits<size_t>::max();
+
+    DumpPage page(limit);
+    page.getWriter().Key("dump");
+    page.getWriter().String(table.c_str(), static_cast<rapidjson::SizeType>(table.size()));
+    page.getWriter().Key("prefix");
+    page.getWriter().String(prefix.c_str(), static_cast<rapidjson::SizeType>(prefix.size()));
+    page.startEntries("entries");
+    bool more;
+    if (table == "white") {
+        more = dumpRules(m_whitelist, prefix, after, page);
+    } else if (table == "black") {
+        more = dumpRules(m_blacklist, prefix, after, page);
+    } else {
+        ndn::Name prefixName;
+        ndn::Name afterName;
+        try {
+            prefixName = ndn::Name(prefix);
+            afterName = ndn::Name(after);
+        } catch (const std::exception &e) {
+            std::string response = R"({"status":"syntax error", "reason":"'prefix' and 'after' have to be names"})";
+            m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+            return;
+        }
+        more = m_pit.dump(prefixName, afterName, [&page](const ndn::Name &name, PitEntry &entry) {
+            std::string uri = name.toUri();
+            return page.add(uri, rapidjson::kObjectType, [&uri, &entry](DumpPage::Writer &writer) {
+                writer.StartObject();
+                writer.Key("name");
+                writer.String(uri.c_str(), static_cast<rapidjson::SizeType>(uri.size()));
+                entry.writeJSON(writer);
+                writer.EndObject();
+            });
+        });
+    }
+    boost::system::error_code err;
+    m_commandSocket.send_to(boost::asio::buffer(page.finish(more)), m_remoteEndpoint, 0, err);
+    if (err) {
+        std::cerr << err.message() << std::endl;
+    }
+}
+
+void NdnFirewall::getRtt(const std::string &after) {
+    DumpPage page(std::numeric_limits<size_t>::max());
+    page.getWriter().Key("rtt");
+    m_pit.writeRttSummary(page.getWriter());
+    page.startEntries("prefixes");
+    bool more = m_pit.dumpRtt(after, [&page](const std::string &prefix, const std::function<void(DumpPage::Writer&)> &writeEntry) {
+        return page.add(prefix, rapidjson::kObjectType, writeEntry);
+    });
+    boost::system::error_code err;
+    m_commandSocket.send_to(boost::asio::buffer(page.finish(more)), m_remoteEndpoint, 0, err);
+    if (err) {
+        std::cerr << err.message() << std::endl;
     }
-    m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
 }
 
 void NdnFirewall::commandPost(const rapidjson::Document &document) {
@@ -295,8 +607,9 @@ void NdnFirewall::commandPost(const rapidjson::Document &document) {
         for (const auto &pair : document["post"].GetObject()) {
             std::string memberName = pair.name.GetString();
             if (memberName != "mode" && memberName != "append-accept" && memberName != "append-drop" &&
-                memberName != "delete-accept" && memberName != "delete-drop") {
-                std::string response = R"({"status":"syntax error", "reason":"only 'mode', 'append-accept', 'append-drop', 'delete-accept', or 'delete-drop' are supported in 'post' method"})";
+                memberName != "delete-accept" && memberName != "delete-drop" && memberName != "fib-add" &&
+                memberName != "fib-delete" && memberName != "save") {
+                std::string response = R"({"status":"syntax error", "reason":"only 'mode', 'append-accept', 'append-drop', 'delete-accept', 'delete-drop', 'fib-add', 'fib-delete', or 'save' are supported in 'post' method"})";
                 m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
                 syntaxCheck = false;
                 break;
@@ -308,11 +621,36 @@ void NdnFirewall::commandPost(const rapidjson::Document &document) {
                 break;
             }
             for (const auto &value : document["post"][memberName.c_str()].GetArray()) {
-                if (memberName == "mode" && (value != "accept" && value != "drop")) {
+                if (memberName == "save") {
+                    std::string response = R"({"status":"syntax error", "reason":"'save' array has to be empty"})";
+                    m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+                    syntaxCheck = false;
+                    break;
+                } else if (memberName == "mode" && (value != "accept" && value != "drop")) {
                     std::string response = R"({"status":"syntax error", "reason":"value in 'mode' array has to be 'accept' or 'drop'"})";
                     m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
                     syntaxCheck = false;
                     break;
+                } else if (memberName == "fib-add") {
+                    bool routeCheck = value.IsObject() && value.HasMember("prefix") && isName(value["prefix"]) &&
+                                      value.HasMember("upstreams") && value["upstreams"].IsArray() &&
+                                      value["upstreams"].Size() > 0;
+                    if (routeCheck) {
+                        for (const auto &upstream : value["upstreams"].GetArray()) {
+                            routeCheck = routeCheck && upstream.IsString();
+                        }
+                    }
+                    if (!routeCheck) {
+                        std::string response = R"({"status":"syntax error", "reason":"value in 'fib-add' array has to be {'prefix': name, 'upstreams': [string, ...]}"})";
+                        m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+                        syntaxCheck = false;
+                        break;
+                    }
+                } else if (memberName == "fib-delete" && !isName(value)) {
+                    std::string response = R"({"status":"syntax error", "reason":"value in 'fib-delete' array has to be a name"})";
+                    m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+                    syntaxCheck = false;
+                    break;
                 } else if (!value.IsString()) {
                     std::string response = R"({"status":"syntax error", "reason":"value in array has to be string"})";
                     m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
@@ -325,92 +663,76 @@ void NdnFirewall::commandPost(const rapidjson::Document &document) {
             }
         }
         if (syntaxCheck) {
+            // the command is valid, the workers are only kept out while it is applied and the responses are sent
+            // once they are back
+            std::vector<std::string> responses;
+            boost::unique_lock<boost::shared_mutex> lock(m_rulesMutex);
+            // the workers see all the changes of the command at once
+            if (m_sharedRules) {
+                m_sharedRules->beginUpdate();
+            }
             for (const auto &pair : document["post"].GetObject()) {
                 std::string memberName = pair.name.GetString();
-                if (memberName == "mode") {
-                    for (const auto &mode : document["post"]["mode"].GetArray()) {
-                        m_mode = mode.GetString();
-                    }
-                } else if (memberName == "append-accept") {
-                    for (const auto &namePrefix : document["post"]["append-accept"].GetArray()) {
-                        std::string allowedNamePrefix = namePrefix.GetString();
-                        if (m_blacklist.find(allowedNamePrefix) != m_blacklist.end()) {
-                            std::string response = allowedNamePrefix;
-                            response = R"({"status":"warning", "reason":"')" + response +
-                                       R"(' has been already appended in blacklist, so that it cannot be appended in whitelist"})";
-                            m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
-                        } else if (m_whitelist.find(allowedNamePrefix) == m_whitelist.end()) {
-                            if (m_totalItemsInWhitelist >= (m_whitelist.size() + 1)) {
-                                if (!appendRules(m_whitelist, allowedNamePrefix, m_cuckooFilterForWhitelist,
-                                                 m_slashCounterForWhitelist)) {
-                                    std::string response = R"({"status":"warning", "reason":"cuckoo filter for whitelist does not have enough space"})";
-                                    m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
-                                }
-                            } else {
-                                std::string response = R"({"status":"warning", "reason":"whitelist has been already full"})";
-                                m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
-                            }
-                        } else {
-                            std::string response = allowedNamePrefix;
-                            response = R"({"status":"warning", "reason":"')" + response +
-                                       R"(' has been already appended in whitelist"})";
-                            m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
-                        }
-                    }
-                } else if (memberName == "append-drop") {
-                    for (const auto &namePrefix : document["post"]["append-drop"].GetArray()) {
-                        std::string deniedNamePrefix = namePrefix.GetString();
-                        if (m_whitelist.find(deniedNamePrefix) != m_whitelist.end()) {
-                            std::string response = deniedNamePrefix;
-                            response = R"({"status":"warning", "reason":"')" + response +
-                                       R"(' has been already appended in whitelist, so that it cannot be appended in blacklist"})";
-                            m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
-                        } else if (m_blacklist.find(deniedNamePrefix) == m_blacklist.end()) {
-                            if (m_totalItemsInBlacklist >= (m_blacklist.size() + 1)) {
-                                if (!appendRules(m_blacklist, deniedNamePrefix, m_cuckooFilterForBlacklist,
-                                                 m_slashCounterForBlacklist)) {
-                                    std::string response = R"({"status":"warning", "reason":"cuckoo filter for blacklist does not have enough space"})";
-                                    m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
-                                }
-                            } else {
-                                std::string response = R"({"status":"warning", "reason":"blacklist has been already full"})";
-                                m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
-                            }
-                        } else {
-                            std::string response = deniedNamePrefix;
-                            response = R"({"status":"warning", "reason":"')" + response +
-                                       R"(' has been already appended in blacklist"})";
-                            m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+                if (m_replicationClient && memberName != "fib-add" && memberName != "fib-delete" &&
+                    memberName != "save") {
+                    std::string response = R"({"status":"warning", "reason":"the rules are replicated from )" +
+                                           m_replicationClient->getSource() + R"(, ')" + memberName +
+                                           R"(' has to be posted there"})";
+                    responses.push_back(response);
+                } else if (memberName == "fib-add") {
+                    for (const auto &route : document["post"]["fib-add"].GetArray()) {
+                        std::string warning;
+                        if (!addRoute(route, warning)) {
+                            responses.push_back(R"({"status":"warning", "reason":")" + warning + R"("})");
                         }
                     }
-                } else if (memberName == "delete-accept") {
-                    for (const auto &namePrefix : document["post"]["delete-accept"].GetArray()) {
-                        std::string allowedNamePrefix = namePrefix.GetString();
-                        auto deletionCheck = m_whitelist.erase(allowedNamePrefix);
-                        if (deletionCheck == 0) {
-                            std::string response = allowedNamePrefix;
-                            response = R"({"status":"warning", "reason":"')" + response +
-                                       R"(' does not exist in whitelist"})";
-                            m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
-                        } else {
-                            deleteRules(allowedNamePrefix, m_cuckooFilterForWhitelist, m_slashCounterForWhitelist);
+                } else if (memberName == "save") {
+                    // once the command is applied, under a shared lock so that the workers are not paused
+                    m_pool.getIoService(0).post(boost::bind(&NdnFirewall::commandSave, this, m_remoteEndpoint));
+                } else if (memberName == "fib-delete") {
+                    for (const auto &namePrefix : document["post"]["fib-delete"].GetArray()) {
+                        std::string prefix = namePrefix.GetString();
+                        if (!m_fib.remove(prefix)) {
+                            std::string response = R"({"status":"warning", "reason":"')" + prefix +
+                                                   R"(' does not exist in fib"})";
+                            responses.push_back(response);
                         }
                     }
-                } else if (memberName == "delete-drop") {
-                    for (const auto &namePrefix : document["post"]["delete-drop"].GetArray()) {
-                        std::string deniedNamePrefix = namePrefix.GetString();
-                        auto deletionCheck = m_blacklist.erase(deniedNamePrefix);
-                        if (deletionCheck == 0) {
-                            std::string response = deniedNamePrefix;
-                            response = R"({"status":"warning", "reason":"')" + response +
-                                       R"(' does not exist in blacklist"})";
-                            m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
-                        } else {
-                            deleteRules(deniedNamePrefix, m_cuckooFilterForBlacklist, m_slashCounterForBlacklist);
+                } else {
+                    // the same changes as the control channel and the replicas
+                    RuleChange::Type type;
+                    RuleChange::fromString(memberName.c_str(), memberName.size(), type);
+                    for (const auto &value : document["post"][memberName.c_str()].GetArray()) {
+                        RuleChange change{type, value.GetString()};
+                        std::string warning;
+                        if (applyRuleChange(change, warning)) {
+                            m_ruleChanges.push_back(change);
+                        } else if (!warning.empty()) {
+                            responses.push_back(R"({"status":"warning", "reason":"')" + change.value +
+                                                R"(' cannot be appended, )" + warning + R"("})");
+                        } else if (type != RuleChange::MODE) {
+                            // nothing to change
+                            std::string list = type == RuleChange::APPEND_ACCEPT || type == RuleChange::DELETE_ACCEPT ?
+                                               "whitelist" : "blacklist";
+                            std::string reason = type == RuleChange::APPEND_ACCEPT || type == RuleChange::APPEND_DROP ?
+                                                 "has been already appended in " : "does not exist in ";
+                            responses.push_back(R"({"status":"warning", "reason":"')" + change.value + "' " +
+                                                reason + list + R"("})");
                         }
                     }
                 }
             }
+            if (m_sharedRules) {
+                m_sharedRules->endUpdate();
+            }
+            lock.unlock();
+            if (m_replicationServer && !m_ruleChanges.empty()) {
+                m_replicationServer->publish(m_ruleChanges);
+            }
+            m_ruleChanges.clear();
+            for (const auto &response : responses) {
+                m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+            }
         }
     } else {
         std::string response = R"({"status":"syntax error", "reason":"value has to be object"})";
@@ -418,39 +740,400 @@ void NdnFirewall::commandPost(const rapidjson::Document &document) {
     }
 }
 
-bool NdnFirewall::appendRules(std::set<std::string> &list, const std::string &namePrefix,
+void NdnFirewall::getFib() {
+    std::stringstream ss;
+    ss << R"({"fib":[)";
+    bool firstRoute = true;
+    for (const auto &route : m_fib.list()) {
+        ss << (firstRoute ? "" : ", ") << R"({"prefix":")" << route.first << R"(", "upstreams":[)";
+        for (size_t i = 0; i < route.second->size(); ++i) {
+            ss << (i == 0 ? "" : ", ") << "\"" << m_upstreams->getName((*route.second)[i]) << "\"";
+        }
+        ss << "]}";
+        firstRoute = false;
+    }
+    ss << "]}";
+    std::string response = ss.str();
+    m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+}
+
+bool NdnFirewall::addRoute(const rapidjson::Value &route, std::string &warning) {
+    Fib::Upstreams upstreams;
+    for (const auto &name : route["upstreams"].GetArray()) {
+        size_t index;
+        if (!m_upstreams->find(name.GetString(), index)) {
+            warning = "'" + std::string(name.GetString()) + "' is not an upstream, see 'upstreams' in 'get' method";
+            return false;
+        }
+        upstreams.push_back(index);
+    }
+    m_fib.insert(ndn::Name(route["prefix"].GetString()), upstreams);
+    return true;
+}
+
+void NdnFirewall::getReplication() {
+    std::stringstream ss;
+    if (m_replicationServer) {
+        ss << R"({"replication":{"role":"source", "generation":)" << m_replicationServer->getGeneration()
+           << R"(, "replicas":)" << m_replicationServer->getPeers() << "}}";
+    } else if (m_replicationClient) {
+        ss << R"({"replication":{"role":"replica", "source":")" << m_replicationClient->getSource()
+           << R"(", "connected":)" << (m_replicationClient->isConnected() ? "true" : "false")
+           << R"(, "generation":)" << m_replicationClient->getGeneration() << R"(, "pending":)"
+           << m_pendingRuleChanges.size() << "}}";
+    } else {
+        ss << R"({"replication":{"role":"none"}})";
+    }
+    std::string response = ss.str();
+    m_commandSocket.send_to(boost::asio::buffer(response), m_remoteEndpoint);
+}
+
+std::vector<RuleChange> NdnFirewall::getRuleSnapshot() {
+    std::vector<RuleChange> changes;
+    changes.reserve(1 + m_whitelist.size() + m_blacklist.size());
+    changes.push_back({RuleChange::MODE, m_mode});
+    for (const auto &namePrefix : m_whitelist) {
+        changes.push_back({RuleChange::APPEND_ACCEPT, namePrefix});
+    }
+    for (const auto &namePrefix : m_blacklist) {
+        changes.push_back({RuleChange::APPEND_DROP, namePrefix});
+    }
+    return changes;
+}
+
+void NdnFirewall::onReplicatedChanges(uint64_t generation, bool reset, const std::vector<RuleChange> &changes) {
+    if (reset) {
+        // the changes not applied yet are superseded, only the differences with the current rules are applied
+        // so that the rules in both stay in force during the resynchronization
+        m_pendingRuleChanges.clear();
+        std::string mode = m_mode;
+        std::set<std::string> whitelist;
+        std::set<std::string> blacklist;
+        for (const auto &change : changes) {
+            if (change.type == RuleChange::MODE) {
+                mode = change.value;
+            } else if (change.type == RuleChange::APPEND_ACCEPT) {
+                whitelist.insert(change.value);
+            } else if (change.type == RuleChange::APPEND_DROP) {
+                blacklist.insert(change.value);
+            }
+        }
+        // a rule moved from a list to the other is deleted first
+        for (const auto &namePrefix : m_whitelist) {
+            if (whitelist.find(namePrefix) == whitelist.end()) {
+                m_pendingRuleChanges.push_back({RuleChange::DELETE_ACCEPT, namePrefix});
+            }
+        }
+        for (const auto &namePrefix : m_blacklist) {
+            if (blacklist.find(namePrefix) == blacklist.end()) {
+                m_pendingRuleChanges.push_back({RuleChange::DELETE_DROP, namePrefix});
+            }
+        }
+        if (mode != m_mode) {
+            m_pendingRuleChanges.push_back({RuleChange::MODE, mode});
+        }
+        for (const auto &namePrefix : whitelist) {
+            if (!m_whitelist.contains(namePrefix)) {
+                m_pendingRuleChanges.push_back({RuleChange::APPEND_ACCEPT, namePrefix});
+            }
+        }
+        for (const auto &namePrefix : blacklist) {
+            if (!m_blacklist.contains(namePrefix)) {
+                m_pendingRuleChanges.push_back({RuleChange::APPEND_DROP, namePrefix});
+            }
+        }
+        std::stringstream ss;
+        ss << "resynchronizing the rules with generation " << generation << " of "
+           << m_replicationClient->getSource() << ", " << m_pendingRuleChanges.size() << " changes";
+        logger::log(logger::INFO, ss.str());
+    } else {
+        m_pendingRuleChanges.insert(m_pendingRuleChanges.end(), changes.begin(), changes.end());
+    }
+    if (!m_applyingRuleChanges && !m_pendingRuleChanges.empty()) {
+        m_applyingRuleChanges = true;
+        applyReplicatedChanges();
+    }
+}
+
+void NdnFirewall::applyReplicatedChanges() {
+    boost::unique_lock<boost::shared_mutex> lock(m_rulesMutex);
+    if (m_sharedRules) {
+        m_sharedRules->beginUpdate();
+    }
+    for (size_t i = 0; i < MAX_CHANGES_PER_LOCK && !m_pendingRuleChanges.empty(); ++i) {
+        std::string warning;
+        if (!applyRuleChange(m_pendingRuleChanges.front(), warning) && !warning.empty()) {
+            // the replica drifts from its source until the rule is deleted there
+            std::stringstream ss;
+            ss << "the replicated rule " << m_pendingRuleChanges.front().value << " was not appended (" << warning
+               << ")";
+            logger::log(logger::WARNING, ss.str());
+        }
+        m_pendingRuleChanges.pop_front();
+    }
+    if (m_sharedRules) {
+        m_sharedRules->endUpdate();
+    }
+    lock.unlock();
+    if (!m_pendingRuleChanges.empty()) {
+        // let the workers take the lock and the other handlers run
+        m_pool.getIoService(0).post(boost::bind(&NdnFirewall::applyReplicatedChanges, this));
+    } else {
+        m_applyingRuleChanges = false;
+    }
+}
+
+size_t NdnFirewall::applyRuleBatch(const std::vector<RuleChange> &changes, std::vector<std::string> &reasons) {
+    // the rules of a replica follow its source only
+    if (m_replicationClient) {
+        reasons.push_back("this instance is a replica of " + m_replicationClient->getSource() +
+                          ", the changes have to be sent there");
+        return 0;
+    }
+    size_t applied = 0;
+    for (size_t first = 0; first < changes.size(); first += MAX_CHANGES_PER_LOCK) {
+        // let the workers take the lock between the chunks of a large batch
+        boost::unique_lock<boost::shared_mutex> lock(m_rulesMutex);
+        if (m_sharedRules) {
+            m_sharedRules->beginUpdate();
+        }
+        for (size_t i = first; i < changes.size() && i < first + MAX_CHANGES_PER_LOCK; ++i) {
+            std::string warning;
+            if (applyRuleChange(changes[i], warning)) {
+                m_ruleChanges.push_back(changes[i]);
+                ++applied;
+            } else if (!warning.empty() && reasons.size() < ControlChannel::MAX_REASONS) {
+                reasons.push_back(changes[i].value + ": " + warning);
+            }
+        }
+        if (m_sharedRules) {
+            m_sharedRules->endUpdate();
+        }
+    }
+    if (m_replicationServer && !m_ruleChanges.empty()) {
+        m_replicationServer->publish(m_ruleChanges);
+    }
+    m_ruleChanges.clear();
+    return applied;
+}
+
+bool NdnFirewall::applyRuleChange(const RuleChange &change, std::string &warning) {
+    switch (change.type) {
+        case RuleChange::MODE:
+            if (m_mode == change.value) {
+                return false;
+            }
+            m_mode = change.value;
+            if (m_sharedRules) {
+                m_sharedRules->setDropMode(m_mode == "drop");
+            }
+            return true;
+        case RuleChange::APPEND_ACCEPT:
+            if (m_whitelist.contains(change.value)) {
+                return false;
+            } else if (m_blacklist.contains(change.value)) {
+                warning = "it is in blacklist";
+                return false;
+            } else if (m_totalItemsInWhitelist < (m_whitelist.size() + 1) ||
+                       !appendRules(m_whitelist, change.value, m_cuckooFilterForWhitelist,
+                                    m_slashCounterForWhitelist, SharedRuleTable::WHITELIST)) {
+                warning = "whitelist is full";
+                return false;
+            }
+            return true;
+        case RuleChange::APPEND_DROP:
+            if (m_blacklist.contains(change.value)) {
+                return false;
+            } else if (m_whitelist.contains(change.value)) {
+                warning = "it is in whitelist";
+                return false;
+            } else if (m_totalItemsInBlacklist < (m_blacklist.size() + 1) ||
+                       !appendRules(m_blacklist, change.value, m_cuckooFilterForBlacklist,
+                                    m_slashCounterForBlacklist, SharedRuleTable::BLACKLIST)) {
+                warning = "blacklist is full";
+                return false;
+            }
+            return true;
+        case RuleChange::DELETE_ACCEPT:
+            if (m_whitelist.erase(change.value) == 0) {
+                return false;
+            }
+            deleteRules(change.value, m_cuckooFilterForWhitelist, m_slashCounterForWhitelist,
+                        SharedRuleTable::WHITELIST);
+            return true;
+        case RuleChange::DELETE_DROP:
+            if (m_blacklist.erase(change.value) == 0) {
+                return false;
+            }
+            deleteRules(change.value, m_cuckooFilterForBlacklist, m_slashCounterForBlacklist,
+                        SharedRuleTable::BLACKLIST);
+            return true;
+    }
+    return false;
+}
+
+bool NdnFirewall::saveRules() {
+    // the workers of shared rules have no rules of their own, the control process saves them
+    if (m_snapshotPath.empty() || (m_sharedRules && !m_commandSocket.is_open())) {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    boost::shared_lock<boost::shared_mutex> lock(m_rulesMutex);
+    try {
+        RuleSnapshot::write(m_snapshotPath, m_mode == "drop", m_whitelist, m_slashCounterForWhitelist, m_blacklist,
+                            m_slashCounterForBlacklist);
+    } catch (const std::exception &e) {
+        std::stringstream ss;
+        ss << "can't save the rules: " << e.what();
+        logger::log(logger::ERROR, ss.str());
+        return false;
+    }
+    std::stringstream ss;
+    ss << "saved " << m_whitelist.size() + m_blacklist.size() << " rules to " << m_snapshotPath << " in "
+       << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+       << " ms";
+    logger::log(logger::INFO, ss.str());
+    return true;
+}
+
+void NdnFirewall::commandSave(const boost::asio::ip::udp::endpoint &remoteEndpoint) {
+    if (m_snapshotPath.empty()) {
+        std::string response = R"({"status":"warning", "reason":"no snapshot file, see -sn"})";
+        m_commandSocket.send_to(boost::asio::buffer(response), remoteEndpoint);
+    } else if (!saveRules()) {
+        std::string response = R"({"status":"warning", "reason":"the rules can't be saved to ')" + m_snapshotPath +
+                               R"(', see the log"})";
+        m_commandSocket.send_to(boost::asio::buffer(response), remoteEndpoint);
+    }
+}
+
+void NdnFirewall::loadRules() {
+    if (m_snapshotPath.empty() || (m_sharedRules && !m_commandSocket.is_open())) {
+        return;
+    }
+    if (!std::ifstream(m_snapshotPath)) {
+        std::stringstream ss;
+        ss << "no rule snapshot in " << m_snapshotPath << " yet";
+        logger::log(logger::INFO, ss.str());
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    try {
+        // kept mapped, the lists read their names from it
+        auto snapshot = std::make_shared<const RuleSnapshot>(m_snapshotPath);
+        boost::unique_lock<boost::shared_mutex> lock(m_rulesMutex);
+        if (m_sharedRules) {
+            m_sharedRules->beginUpdate();
+        }
+        m_mode = snapshot->isDropMode() ? "drop" : "accept";
+        if (m_sharedRules) {
+            m_sharedRules->setDropMode(snapshot->isDropMode());
+        }
+        size_t skipped = loadRules(snapshot, RuleSnapshot::WHITELIST, m_whitelist, m_cuckooFilterForWhitelist,
+                                   m_slashCounterForWhitelist, m_totalItemsInWhitelist, SharedRuleTable::WHITELIST);
+        skipped += loadRules(snapshot, RuleSnapshot::BLACKLIST, m_blacklist, m_cuckooFilterForBlacklist,
+                             m_slashCounterForBlacklist, m_totalItemsInBlacklist, SharedRuleTable::BLACKLIST);
+        if (m_sharedRules) {
+            m_sharedRules->endUpdate();
+        }
+        std::stringstream ss;
+        ss << "loaded " << m_whitelist.size() + m_blacklist.size() << " rules (mode " << m_mode << ") from "
+           << m_snapshotPath << " in "
+           << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+           << " ms";
+        if (skipped != 0) {
+            ss << ", " << skipped << " rules did not fit in the lists (see -w and -b)";
+        }
+        logger::log(skipped != 0 ? logger::WARNING : logger::INFO, ss.str());
+    } catch (const std::exception &e) {
+        std::stringstream ss;
+        ss << "can't load the rules: " << e.what();
+        logger::log(logger::ERROR, ss.str());
+    }
+}
+
+size_t NdnFirewall::loadRules(const std::shared_ptr<const RuleSnapshot> &snapshot, RuleSnapshot::List list,
+                              RuleList &rules, cuckooFilterForNdnFirewall &cuckooFilter,
+                              std::vector<std::pair<uint16_t, uint16_t>> &slashCounter, size_t totalItems,
+                              SharedRuleTable::List sharedList) {
+    bool sameHash = snapshot->hasSameHash();
+    size_t loaded = 0;
+    size_t skipped = 0;
+    // the names stay in the snapshot, only the rules that don't fit are marked as deleted
+    rules.assign(snapshot, list, [&](const char *name, size_t length, size_t hash) {
+        if (loaded >= totalItems) {
+            ++skipped;
+            return false;
+        }
+        if (!sameHash) {
+            hash = std::hash<std::string>()(std::string(name, length));
+        }
+        if (m_sharedRules ? !m_sharedRules->add(sharedList, hash) : cuckooFilter.Add(hash) != cuckoofilter::Ok) {
+            ++skipped;
+            return false;
+        }
+        ++loaded;
+        return true;
+    });
+    auto depths = snapshot->getDepths(list);
+    if (skipped == 0 && !depths.empty()) {
+        slashCounter = depths;
+    } else {
+        slashCounter.assign(1, std::make_pair(0, 0));
+        for (const auto &namePrefix : rules) {
+            addSlashCounter(namePrefix, slashCounter);
+        }
+    }
+    if (m_sharedRules) {
+        m_sharedRules->setDepth(sharedList, slashCounter.back().first);
+    }
+    return skipped;
+}
+
+bool NdnFirewall::appendRules(RuleList &list, const std::string &namePrefix,
                               cuckooFilterForNdnFirewall &cuckooFilter,
-                              std::vector<std::pair<uint16_t, uint16_t>> &slashCounter) {
+                              std::vector<std::pair<uint16_t, uint16_t>> &slashCounter,
+                              SharedRuleTable::List sharedList) {
     size_t hash = std::hash<std::string>()(namePrefix);
-    if (cuckooFilter.Add(hash) != cuckoofilter::Ok) {
+    // the cuckoo filters are not used when the rules are shared
+    if (m_sharedRules ? !m_sharedRules->add(sharedList, hash) : cuckooFilter.Add(hash) != cuckoofilter::Ok) {
         return false;
     } else {
         list.insert(namePrefix);
-        if (slashCounter.back().first < (std::count(namePrefix.begin(), namePrefix.end(), '/') + 1)) {
+        addSlashCounter(namePrefix, slashCounter);
+        if (m_sharedRules) {
+            m_sharedRules->setDepth(sharedList, slashCounter.back().first);
+        }
+        return true;
+    }
+}
+
+void NdnFirewall::addSlashCounter(const std::string &namePrefix,
+                                  std::vector<std::pair<uint16_t, uint16_t>> &slashCounter) {
+    if (slashCounter.back().first < (std::count(namePrefix.begin(), namePrefix.end(), '/') + 1)) {
+        slashCounter.emplace_back(
+                static_cast<uint16_t>(std::count(namePrefix.begin(), namePrefix.end(), '/') + 1), 1);
+    } else {
+        bool counterCheck = false;
+        for (auto &eachCounter : slashCounter) {
+            if (eachCounter.first == (std::count(namePrefix.begin(), namePrefix.end(), '/') + 1)) {
+                eachCounter.second++;
+                counterCheck = true;
+                break;
+            }
+        }
+        if (!counterCheck) {
             slashCounter.emplace_back(
                     static_cast<uint16_t>(std::count(namePrefix.begin(), namePrefix.end(), '/') + 1), 1);
-        } else {
-            bool counterCheck = false;
-            for (auto &eachCounter : slashCounter) {
-                if (eachCounter.first == (std::count(namePrefix.begin(), namePrefix.end(), '/') + 1)) {
-                    eachCounter.second++;
-                    counterCheck = true;
-                    break;
-                }
-            }
-            if (!counterCheck) {
-                slashCounter.emplace_back(
-                        static_cast<uint16_t>(std::count(namePrefix.begin(), namePrefix.end(), '/') + 1), 1);
-                sort(slashCounter.begin(), slashCounter.end());
-            }
+            sort(slashCounter.begin(), slashCounter.end());
         }
-        return true;
     }
 }
 
 // note that deleteRules function does not erase rules from m_whitelist or m_blacklist, which means erase functions of them have to be called
 void NdnFirewall::deleteRules(const std::string &namePrefix, cuckooFilterForNdnFirewall &cuckooFilter,
-                              std::vector<std::pair<uint16_t, uint16_t>> &slashCounter) {
+                              std::vector<std::pair<uint16_t, uint16_t>> &slashCounter,
+                              SharedRuleTable::List sharedList) {
     uint16_t i = 0;
     for (auto &eachCounter : slashCounter) {
         if (eachCounter.first == (std::count(namePrefix.begin(), namePrefix.end(), '/') + 1)) {
@@ -463,5 +1146,10 @@ void NdnFirewall::deleteRules(const std::string &namePrefix, cuckooFilterForNdnF
         i++;
     }
     size_t hash = std::hash<std::string>()(namePrefix);
-    cuckooFilter.Delete(hash);
+    if (m_sharedRules) {
+        m_sharedRules->remove(sharedList, hash);
+        m_sharedRules->setDepth(sharedList, slashCounter.back().first);
+    } else {
+        cuckooFilter.Delete(hash);
+    }
 }
\ No newline at end of file
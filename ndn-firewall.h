@@ -21,17 +21,31 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <ndn-cxx/data.hpp>
 
 #include <boost/asio.hpp>
+#include <boost/thread/shared_mutex.hpp>
 
+#include <deque>
 #include <memory>
 #include <string>
 #include <queue>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "network/master_face.h"
 #include "network/face.h"
+#include "network/io_service_pool.h"
 #include "cuckoofilter/src/cuckoofilter.h"
 #include "rapidjson/include/rapidjson/document.h"
 #include "pit.h"
+#include "upstream_set.h"
+#include "fib.h"
+#include "shared_rule_table.h"
+#include "replication.h"
+#include "control_channel.h"
+#include "dump_page.h"
+#include "rule_snapshot.h"
+#include "rule_list.h"
+#include "tlv/lp_packet.h"
 
 #define BITS_FOR_EACH_ITEM 32
 
@@ -41,18 +55,27 @@ using cuckooFilterForNdnFirewall = cuckoofilter::CuckooFilter<size_t, BITS_FOR_E
 
 class NdnFirewall {
 
-    boost::asio::io_service &m_ios;
+    // replicated and bulk changes applied under one lock of the rules, the workers are not paused by a resynchronization
+    static const size_t MAX_CHANGES_PER_LOCK = 1024;
+
+    IoServicePool &m_pool;
+
+    // the rules are read by every worker and only written by the command handler
+    boost::shared_mutex m_rulesMutex;
 
     std::string &m_mode;
 
+    // answer the dropped Interests with a Nack
+    bool m_nack;
+
     size_t &m_totalItemsInWhitelist;
     size_t &m_totalItemsInBlacklist;
 
     cuckooFilterForNdnFirewall &m_cuckooFilterForWhitelist;
     cuckooFilterForNdnFirewall &m_cuckooFilterForBlacklist;
 
-    std::set<std::string> m_whitelist;
-    std::set<std::string> m_blacklist;
+    RuleList m_whitelist;
+    RuleList m_blacklist;
 
     // firewall needs to extract name prefixes (initial pair of (number of slashes, counter) is (0, 0))
     // m_slashCounterForWhitelist and m_slashCounterForBlacklist have to be sorted based on the number of slashes before calling interestNameFilter function
@@ -60,30 +83,69 @@ class NdnFirewall {
     std::vector<std::pair<uint16_t, uint16_t>> m_slashCounterForWhitelist;
     std::vector<std::pair<uint16_t, uint16_t>> m_slashCounterForBlacklist;
 
+    // the rules shared with other firewall processes, written only by the one with the command socket
+    std::shared_ptr<SharedRuleTable> m_sharedRules;
+
     boost::asio::ip::udp::socket m_commandSocket;
     char m_commandBuffer[65536];
     boost::asio::ip::udp::endpoint m_remoteEndpoint;
 
-    std::shared_ptr<Face> m_egressFace;
-    std::shared_ptr<MasterFace> m_ingressMasterFace;
+    std::vector<std::shared_ptr<MasterFace>> m_ingressMasterFaces;
 
     Pit m_pit;
 
+    // the NFDs the accepted Interests are forwarded to
+    std::unique_ptr<UpstreamSet> m_upstreams;
+    Fib m_fib;
+
+    // the rules are either streamed to the replicas of this instance or followed from another instance
+    std::unique_ptr<ReplicationServer> m_replicationServer;
+    std::unique_ptr<ReplicationClient> m_replicationClient;
+    // the changes of the online command being applied, for the replicas
+    std::vector<RuleChange> m_ruleChanges;
+    // the replicated changes not applied yet
+    std::deque<RuleChange> m_pendingRuleChanges;
+    bool m_applyingRuleChanges = false;
+
+    // bulk changes of the rules over TCP, alongside the command socket
+    std::unique_ptr<ControlChannel> m_controlChannel;
+
+    // loaded at launch, written on command and on shutdown, none if empty
+    std::string m_snapshotPath;
+
 public:
-    NdnFirewall(boost::asio::io_service &ios, std::string &mode, size_t &totalItemsInWhitelist,
+    NdnFirewall(IoServicePool &pool, std::string &mode, size_t &totalItemsInWhitelist,
                 size_t &totalItemsInBlacklist, cuckooFilterForNdnFirewall &cuckooFilterForWhitelist,
                 cuckooFilterForNdnFirewall &cuckooFilterForBlacklist, const uint16_t &localPort,
-                const uint16_t &localPortForCommand, const std::string &remoteAddress, const uint16_t &remotePort);
+                const uint16_t &localUdpPort, const std::string &localInterface, const std::string &localUnixPath,
+                const uint16_t &localPortForCommand,
+                const std::vector<std::pair<std::string, uint16_t>> &remoteAddresses, const uint16_t &remotePort,
+                const uint16_t &remoteUdpPort, const std::vector<std::string> &remoteUnixPaths, const bool &nack,
+                const std::vector<DrrScheduler::Weight> &weights, const std::string &probeName,
+                const size_t &rttDepth, const std::shared_ptr<SharedRuleTable> &sharedRules,
+                const uint16_t &replicationPort, const std::string &replicationAddress,
+                const std::pair<std::string, uint16_t> &replicationSource,
+                const std::string &snapshotPath, const uint16_t &localTcpPortForCommand,
+                const std::string &localTcpAddressForCommand);
 
     ~NdnFirewall() = default;
 
     void start();
 
-    void onIngressInterest(const std::shared_ptr<Face> &face, const ndn::Interest &interest);
+    // false if there is no snapshot file or it can't be written, the workers keep running meanwhile
+    bool saveRules();
+
+    void onIngressInterest(const std::shared_ptr<Face> &face, const InterestView &interest);
 
     void onIngressData(const std::shared_ptr<Face> &face, const ndn::Data &data);
 
-    void onEgressInterest(const std::shared_ptr<Face> &face, const ndn::Interest &interest);
+    void sendNack(const std::shared_ptr<Face> &face, const InterestView &interest, LpPacket::NackReason reason);
+
+    // with the PitToken of another Interest for the same name
+    void sendNack(const std::shared_ptr<Face> &face, const InterestView &interest, LpPacket::NackReason reason,
+                  const std::string &pitToken);
+
+    void onEgressInterest(const std::shared_ptr<Face> &face, const InterestView &interest);
 
     void onEgressData(const std::shared_ptr<Face> &face, const ndn::Data &data);
 
@@ -95,20 +157,67 @@ public:
 
     bool interestNameFilter(std::string uri);
 
+    // contains(whitelist, hash) looks a name prefix up in the whitelist or the blacklist
+    template <class Contains>
+    bool matchRules(const std::string &uri, uint16_t whitelistDepth, uint16_t blacklistDepth, bool dropMode,
+                    const Contains &contains);
+
     void commandRead();
 
     void commandReadHandler(const boost::system::error_code &err, size_t bytes_transferred);
 
     void commandGet(const rapidjson::Document &document);
 
-    void getRules(const std::set<std::string> &list, const std::string &value);
+    void getRules(const RuleList &list, const std::string &value);
+
+    // the rules under prefix after the cursor, true if the page is full before the last one
+    bool dumpRules(const RuleList &list, const std::string &prefix, const std::string &after,
+                   DumpPage &page);
+
+    // one page of the RTTs of the prefixes, after the cursor if not empty
+    void getRtt(const std::string &after);
 
+    // one page of the whitelist, the blacklist, or the PIT
+    void getDump(const rapidjson::Value &request);
+
+    // checks the whole command before taking m_rulesMutex, the responses are sent once it is released
     void commandPost(const rapidjson::Document &document);
 
-    bool appendRules(std::set<std::string> &list, const std::string &namePrefix,
+    void getFib();
+
+    // false if an upstream of the route is unknown, the warning tells which one
+    bool addRoute(const rapidjson::Value &route, std::string &warning);
+
+    void getReplication();
+
+    std::vector<RuleChange> getRuleSnapshot();
+
+    void onReplicatedChanges(uint64_t generation, bool reset, const std::vector<RuleChange> &changes);
+
+    void applyReplicatedChanges();
+
+    // the changes of a control channel batch, returns how many changed the rules
+    size_t applyRuleBatch(const std::vector<RuleChange> &changes, std::vector<std::string> &reasons);
+
+    // true if the rules changed, the warning is set if the change was refused, not if it was already done
+    bool applyRuleChange(const RuleChange &change, std::string &warning);
+
+    void loadRules();
+
+    // the rules not appended (list full) are counted
+    size_t loadRules(const std::shared_ptr<const RuleSnapshot> &snapshot, RuleSnapshot::List list, RuleList &rules,
+                     cuckooFilterForNdnFirewall &cuckooFilter,
+                     std::vector<std::pair<uint16_t, uint16_t>> &slashCounter, size_t totalItems,
+                     SharedRuleTable::List sharedList);
+
+    void commandSave(const boost::asio::ip::udp::endpoint &remoteEndpoint);
+
+    void addSlashCounter(const std::string &namePrefix, std::vector<std::pair<uint16_t, uint16_t>> &slashCounter);
+
+    bool appendRules(RuleList &list, const std::string &namePrefix,
                      cuckooFilterForNdnFirewall &cuckooFilter,
-                     std::vector<std::pair<uint16_t, uint16_t>> &slashCounter);
+                     std::vector<std::pair<uint16_t, uint16_t>> &slashCounter, SharedRuleTable::List sharedList);
 
     void deleteRules(const std::string &namePrefix, cuckooFilterForNdnFirewall &cuckooFilter,
-                     std::vector<std::pair<uint16_t, uint16_t>> &slashCounter);
+                     std::vector<std::pair<uint16_t, uint16_t>> &slashCounter, SharedRuleTable::List sharedList);
 };
\ No newline at end of file
@@ -0,0 +1,340 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ethernet_master_face.h"
+
+#ifdef __linux__
+
+#include <boost/bind.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include "../log/logger.h"
+#include "../tlv/tlv.h"
+
+EthernetMasterFace::EthernetSubFace::EthernetSubFace(EthernetMasterFace &master_face, const PacketRing::MacAddress &address)
+        : Face(master_face.get_io_service())
+        , _master_face(master_face)
+        , _address(address)
+        , _last_activity(master_face._sweeps) {
+
+}
+
+std::string EthernetMasterFace::EthernetSubFace::getUnderlyingProtocol() const {
+    return "ETHER";
+}
+
+std::string EthernetMasterFace::EthernetSubFace::getUnderlyingEndpoint() const {
+    return PacketRing::toString(_address);
+}
+
+const PacketRing::MacAddress& EthernetMasterFace::EthernetSubFace::getAddress() {
+    return _address;
+}
+
+void EthernetMasterFace::EthernetSubFace::open(const InterestCallback &interest_callback,
+                                               const DataCallback &data_callback,
+                                               const ErrorCallback &error_callback) {
+    _interest_callback = interest_callback;
+    _data_callback = data_callback;
+    _error_callback = error_callback;
+    _is_connected = true;
+}
+
+void EthernetMasterFace::EthernetSubFace::close() {
+    _is_connected = false;
+    _error_callback(shared_from_this());
+}
+
+void EthernetMasterFace::EthernetSubFace::send(const std::string &message) {
+    _master_face._strand.post(boost::bind(&EthernetSubFace::sendImpl, shared_from_this(), Message(message)));
+}
+
+void EthernetMasterFace::EthernetSubFace::send(const ndn::Block &wire) {
+    if (wire.size() > _master_face._ring.getMtu()) {
+        _master_face._strand.post(boost::bind(&EthernetSubFace::sendFragments, shared_from_this(), wire));
+    } else {
+        _master_face._strand.post(boost::bind(&EthernetSubFace::sendImpl, shared_from_this(), Message(wire)));
+    }
+}
+
+void EthernetMasterFace::EthernetSubFace::send(const ndn::Interest &interest) {
+    send(interest.wireEncode());
+}
+
+void EthernetMasterFace::EthernetSubFace::send(const ndn::Data &data) {
+    send(data.wireEncode());
+}
+
+void EthernetMasterFace::EthernetSubFace::sendFragments(const ndn::Block &wire) {
+    try {
+        for (const auto &fragment : fragmentPacket(wire, _master_face._ring.getMtu())) {
+            sendImpl(Message(fragment));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void EthernetMasterFace::EthernetSubFace::sendImpl(const Message &message) {
+    _last_activity = _master_face._sweeps;
+    if (_master_face.sendImpl(message, _address) == Queue::OVERFLOWED && _is_connected) {
+        std::stringstream ss;
+        ss << "send queue of ether://" << PacketRing::toString(_address) << " is full, face with ID = " << _face_id
+           << " is closed";
+        logger::log(logger::WARNING, ss.str());
+        close();
+    }
+}
+
+void EthernetMasterFace::EthernetSubFace::proceedPacket(const uint8_t *buffer, size_t size) {
+    _last_activity = _master_face._sweeps;
+
+    // short frames are padded, the TLV gives the actual size of the packet
+    const uint8_t *pos = buffer;
+    const uint8_t *end = buffer + size;
+    uint64_t type;
+    uint64_t length;
+    if (!tlv::readVarNumber(pos, end, type) || !tlv::readVarNumber(pos, end, length) ||
+        length > (uint64_t)(end - pos)) {
+        return;
+    }
+    size = (size_t)(pos - buffer + length);
+
+    try {
+        std::vector<InterestView> interests;
+        std::vector<ndn::Data> datas;
+        // the only copy of the packet: the ring block goes back to the kernel once its frames are read, the Interests
+        // and the Data decoded share this Block
+        decodePacket(ndn::Block(buffer, size), interests, datas);
+        for (const auto &interest : interests) {
+            _interest_callback(shared_from_this(), interest);
+        }
+        for (const auto &data : datas) {
+            _data_callback(shared_from_this(), data);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+bool EthernetMasterFace::EthernetSubFace::sweep(uint64_t sweeps) {
+    uint64_t idle = sweeps - _last_activity;
+    if (idle >= IDLE_TIMEOUT) {
+        std::stringstream ss;
+        ss << "no activity from/to ether://" << PacketRing::toString(_address) << " since " << idle * SWEEP_INTERVAL << "s";
+        logger::log(logger::INFO, ss.str());
+        return true;
+    }
+    return false;
+}
+
+size_t EthernetMasterFace::MacAddressHash::operator()(const PacketRing::MacAddress &address) const {
+    uint64_t hash = 0;
+    for (auto byte : address) {
+        hash = (hash << 8) | byte;
+    }
+    return std::hash<uint64_t>()(hash);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+EthernetMasterFace::EthernetMasterFace(boost::asio::io_service &ios, size_t max_connection, const std::string &interface,
+                                       int fanout_group)
+        : MasterFace(ios, max_connection)
+        , _interface(interface)
+        , _ring(interface, ETHERTYPE_NDN, fanout_group)
+        , _descriptor(_ios, _ring.getFd())
+        , _strand(_ios)
+        , _queue(_dropped_packets)
+        , _sweep_timer(_ios) {
+
+}
+
+EthernetMasterFace::~EthernetMasterFace() {
+    // the socket belongs to the ring
+    _descriptor.release();
+}
+
+std::string EthernetMasterFace::getUnderlyingProtocol() const {
+    return "ETHER";
+}
+
+void EthernetMasterFace::listen(const MasterFace::NotificationCallback &notification_callback, const Face::InterestCallback &interest_callback,
+                                const Face::DataCallback &data_callback, const MasterFace::ErrorCallback &error_callback) {
+    _notification_callback = notification_callback;
+    _interest_callback = interest_callback;
+    _data_callback = data_callback;
+    _error_callback = error_callback;
+    std::stringstream ss;
+    ss << "master face with ID = " << _master_face_id << " listening on ether://" << _interface << " ("
+       << PacketRing::toString(_ring.getAddress()) << ", MTU " << _ring.getMtu() << ")";
+    logger::log(logger::INFO, ss.str());
+    read();
+    _sweep_timer.expires_from_now(boost::posix_time::seconds(SWEEP_INTERVAL));
+    _sweep_timer.async_wait(_strand.wrap(boost::bind(&EthernetMasterFace::sweepHandler, shared_from_this(), _1)));
+}
+
+void EthernetMasterFace::close() {
+    boost::system::error_code err;
+    _descriptor.cancel(err);
+    _sweep_timer.cancel();
+    // closing a sub-face removes it from _faces
+    auto faces = _faces;
+    for(const auto &face : faces) {
+        face.second->close();
+    }
+}
+
+void EthernetMasterFace::sendToAllFaces(const std::string &message) {
+    for(const auto &face : _faces) {
+        face.second->send(message);
+    }
+}
+
+void EthernetMasterFace::sendToAllFaces(const ndn::Block &wire) {
+    for(const auto &face : _faces) {
+        face.second->send(wire);
+    }
+}
+
+void EthernetMasterFace::sendToAllFaces(const ndn::Interest &interest) {
+    sendToAllFaces(interest.wireEncode());
+}
+
+void EthernetMasterFace::sendToAllFaces(const ndn::Data &data) {
+    sendToAllFaces(data.wireEncode());
+}
+
+void EthernetMasterFace::read() {
+    if (_read_gate && !_read_gate->isOpen()) {
+        // the egress face can't keep up, stop reading until it drains
+        auto self = shared_from_this();
+        _read_gate->wait([self]() {
+            self->_strand.post(boost::bind(&EthernetMasterFace::read, self));
+        });
+        return;
+    }
+    // only wait for a block to be handed over, frames are then read in place from the ring
+    _descriptor.async_read_some(boost::asio::null_buffers(),
+                                _strand.wrap(boost::bind(&EthernetMasterFace::readHandler, shared_from_this(), _1)));
+}
+
+void EthernetMasterFace::readHandler(const boost::system::error_code &err) {
+    if (!err) {
+        if (_ring.receive(boost::bind(&EthernetMasterFace::proceedFrame, this, _1, _2, _3), MAX_BLOCKS_PER_READ)) {
+            // more blocks are ready, the reactor is edge-triggered and would not wake us up again
+            _strand.post(boost::bind(&EthernetMasterFace::readHandler, shared_from_this(), boost::system::error_code()));
+            return;
+        }
+        read();
+    } else if (err != boost::asio::error::operation_aborted) {
+        std::cerr << "[ERROR] " << err.message() << std::endl;
+    }
+}
+
+void EthernetMasterFace::proceedFrame(const PacketRing::MacAddress &source, const uint8_t *payload, size_t size) {
+    auto it = _faces.find(source);
+    if (it != _faces.end()) {
+        it->second->proceedPacket(payload, size);
+    } else if (_faces.size() < _max_connection) {
+        std::stringstream ss;
+        ss << "new connection from ether://" << PacketRing::toString(source);
+        logger::log(logger::INFO, ss.str());
+        auto face = std::make_shared<EthernetSubFace>(*this, source);
+        face->open(_interest_callback, _data_callback, boost::bind(&EthernetMasterFace::onFaceError, shared_from_this(), _1));
+        _notification_callback(shared_from_this(), face);
+        _faces.emplace(source, face);
+        face->proceedPacket(payload, size);
+    }
+}
+
+EthernetMasterFace::Queue::Result EthernetMasterFace::sendImpl(const Message &message, const PacketRing::MacAddress &destination) {
+    bool idle = _queue.empty();
+    auto result = _queue.push(std::make_pair(message, destination));
+    if (idle) {
+        // let the other sends of this round fill the tx ring, they will leave with the same system call
+        _strand.post(boost::bind(&EthernetMasterFace::write, shared_from_this()));
+    }
+    return result;
+}
+
+void EthernetMasterFace::write() {
+    size_t pushed = 0;
+    while (!_queue.empty()) {
+        const auto &frame = _queue.front();
+        if (frame.first.size() > _ring.getMtu()) {
+            // only raw strings can get there, packets are fragmented by the sub-faces
+            std::stringstream ss;
+            ss << "packet of " << frame.first.size() << " bytes larger than the MTU of " << _interface << ", dropped";
+            logger::log(logger::WARNING, ss.str());
+        } else if (_ring.push(frame.second, frame.first.data(), frame.first.size())) {
+            ++pushed;
+        } else {
+            break;
+        }
+        _queue.pop();
+    }
+    if (pushed > 0 && _ring.send() < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        std::cerr << strerror(errno) << std::endl;
+    }
+    if (!_queue.empty()) {
+        // the tx ring is full, wait for the kernel to release frames
+        _descriptor.async_write_some(boost::asio::null_buffers(),
+                                     _strand.wrap(boost::bind(&EthernetMasterFace::writeHandler, shared_from_this(), _1)));
+    }
+}
+
+void EthernetMasterFace::writeHandler(const boost::system::error_code &err) {
+    if (!err) {
+        if (!_queue.empty()) {
+            write();
+        }
+    } else {
+        std::cerr << err.message() << std::endl;
+    }
+}
+
+void EthernetMasterFace::onFaceError(const std::shared_ptr<Face> &face) {
+    _faces.erase(((EthernetSubFace*)face.get())->getAddress());
+    _error_callback(shared_from_this(), face);
+}
+
+void EthernetMasterFace::sweep() {
+    ++_sweeps;
+    std::vector<std::shared_ptr<EthernetSubFace>> idle_faces;
+    for (const auto &face : _faces) {
+        if (face.second->sweep(_sweeps)) {
+            idle_faces.push_back(face.second);
+        }
+    }
+    // closing a sub-face removes it from _faces
+    for (const auto &face : idle_faces) {
+        face->close();
+    }
+}
+
+void EthernetMasterFace::sweepHandler(const boost::system::error_code &err) {
+    if (!err) {
+        sweep();
+        _sweep_timer.expires_from_now(boost::posix_time::seconds(SWEEP_INTERVAL));
+        _sweep_timer.async_wait(_strand.wrap(boost::bind(&EthernetMasterFace::sweepHandler, shared_from_this(), _1)));
+    }
+}
+
+#endif
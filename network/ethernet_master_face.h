@@ -0,0 +1,142 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef __linux__
+
+#include <unordered_map>
+
+#include "master_face.h"
+#include "face.h"
+#include "packet_ring.h"
+
+// NDN directly over Ethernet, one sub-face per source MAC address
+class EthernetMasterFace : public MasterFace, public std::enable_shared_from_this<EthernetMasterFace> {
+public:
+    // shared by the sub-faces, the frames leave by the same ring
+    using Queue = SendQueue<std::pair<Message, PacketRing::MacAddress>>;
+
+    static const uint16_t ETHERTYPE_NDN = 0x8624;
+    // blocks handed per wakeup so other handlers are not starved by a flood
+    static const size_t MAX_BLOCKS_PER_READ = 4;
+    // seconds between two checks of the idle sub-faces, a frame only records the current check
+    static const long SWEEP_INTERVAL = 1;
+
+    struct MacAddressHash {
+        size_t operator()(const PacketRing::MacAddress &address) const;
+    };
+
+    class EthernetSubFace : public Face, public std::enable_shared_from_this<EthernetSubFace> {
+    public:
+        // in sweeps, there is no way to probe a peer on Ethernet, a sub-face lasts as long as it is used
+        static const uint64_t IDLE_TIMEOUT = 60;
+
+    private:
+        EthernetMasterFace &_master_face;
+
+        PacketRing::MacAddress _address;
+        // sweep of the last frame from/to the peer
+        uint64_t _last_activity;
+
+    public:
+        EthernetSubFace(EthernetMasterFace &master_face, const PacketRing::MacAddress &address);
+
+        ~EthernetSubFace() override = default;
+
+        std::string getUnderlyingProtocol() const override;
+
+        std::string getUnderlyingEndpoint() const override;
+
+        const PacketRing::MacAddress& getAddress();
+
+        void open(const InterestCallback &interest_callback, const DataCallback &data_callback, const ErrorCallback &error_callback) override;
+
+        void close() override;
+
+        void send(const std::string &message) override;
+
+        void send(const ndn::Block &wire) override;
+
+        void send(const ndn::Interest &interest) override;
+
+        void send(const ndn::Data &data) override;
+
+        void proceedPacket(const uint8_t *buffer, size_t size);
+
+        // true if the peer was idle for too long
+        bool sweep(uint64_t sweeps);
+
+    private:
+        void sendFragments(const ndn::Block &wire);
+
+        void sendImpl(const Message &message);
+    };
+
+private:
+    std::string _interface;
+    PacketRing _ring;
+    boost::asio::posix::stream_descriptor _descriptor;
+    boost::asio::strand _strand;
+    std::unordered_map<PacketRing::MacAddress, std::shared_ptr<EthernetSubFace>, MacAddressHash> _faces;
+    Queue _queue;
+    boost::asio::deadline_timer _sweep_timer;
+    uint64_t _sweeps = 0;
+
+public:
+    // the master faces given the same fanout_group share the frames of the interface, one per worker
+    EthernetMasterFace(boost::asio::io_service &ios, size_t max_connection, const std::string &interface,
+                       int fanout_group = -1);
+
+    ~EthernetMasterFace() override;
+
+    std::string getUnderlyingProtocol() const override;
+
+    void listen(const NotificationCallback &notification_callback, const Face::InterestCallback &interest_callback,
+                const Face::DataCallback &data_callback, const ErrorCallback &error_callback) override;
+
+    void close() override;
+
+    void sendToAllFaces(const std::string &message) override;
+
+    void sendToAllFaces(const ndn::Block &wire) override;
+
+    void sendToAllFaces(const ndn::Interest &interest) override;
+
+    void sendToAllFaces(const ndn::Data &data) override;
+
+private:
+    void read();
+
+    void readHandler(const boost::system::error_code &err);
+
+    void proceedFrame(const PacketRing::MacAddress &source, const uint8_t *payload, size_t size);
+
+    Queue::Result sendImpl(const Message &message, const PacketRing::MacAddress &destination);
+
+    void write();
+
+    void writeHandler(const boost::system::error_code &err);
+
+    void onFaceError(const std::shared_ptr<Face> &face);
+
+    void sweep();
+
+    void sweepHandler(const boost::system::error_code &err);
+};
+
+#endif
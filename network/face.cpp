@@ -17,4 +17,54 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "face.h"
 
-size_t Face::counter = 0;
\ No newline at end of file
+#include <ndn-cxx/lp/tags.hpp>
+
+#include "../tlv/tlv.h"
+
+std::atomic<size_t> Face::counter(0);
+
+void Face::decodePacket(const ndn::Block &wire, std::vector<InterestView> &interests, std::vector<ndn::Data> &datas) {
+    ndn::Block packet = wire;
+    LpHeaders headers;
+    if (wire.type() == tlv::LP_PACKET) {
+        LpPacket lp_packet(wire);
+        if (!lp_packet.hasFragment()) {
+            // idle packet
+            return;
+        }
+        if (lp_packet.getFragCount() > 1) {
+            if (!_reassembler.receive(lp_packet, packet, headers)) {
+                return;
+            }
+        } else {
+            packet = lp_packet.getFragment();
+            headers = lp_packet.getHeaders();
+        }
+        if (headers.nack) {
+            // Nacks are not handled, they must not be taken for the Interest they carry
+            return;
+        }
+    }
+
+    switch (packet.type()) {
+        case tlv::INTEREST:
+            interests.emplace_back(packet);
+            interests.back().setPitToken(headers.pit_token);
+            break;
+        case tlv::DATA:
+            datas.emplace_back(packet);
+            if (headers.congestion_mark != 0) {
+                datas.back().setTag(std::make_shared<ndn::lp::CongestionMarkTag>(headers.congestion_mark));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+std::vector<ndn::Block> Face::fragmentPacket(const ndn::Block &wire, size_t mtu) {
+    if (wire.size() <= mtu) {
+        return {wire};
+    }
+    return LpPacket::fragment(wire, mtu, _lp_sequence);
+}
\ No newline at end of file
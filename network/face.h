@@ -19,23 +19,33 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ndn-cxx/interest.hpp>
 #include <ndn-cxx/data.hpp>
+#include <ndn-cxx/util/random.hpp>
+
+#include "message.h"
+#include "read_gate.h"
+#include "send_queue.h"
+#include "../tlv/interest_view.h"
+#include "../tlv/lp_reassembler.h"
 
 #include <boost/asio.hpp>
 //#include <boost/function.hpp>
 
 #include <functional>
 
+#include <atomic>
 #include <memory>
 #include <string>
+#include <vector>
 
 class Face {
 public:
-    using InterestCallback = std::function<void(const std::shared_ptr<Face>&, const ndn::Interest&)>;
+    using InterestCallback = std::function<void(const std::shared_ptr<Face>&, const InterestView&)>;
     using DataCallback = std::function<void(const std::shared_ptr<Face>&, const ndn::Data&)>;
     using ErrorCallback = std::function<void(const std::shared_ptr<Face>&)>;
+    using ConnectCallback = std::function<void(const std::shared_ptr<Face>&)>;
 
 private:
-    static size_t counter;
+    static std::atomic<size_t> counter;
 
 protected:
     const size_t _face_id;
@@ -47,9 +57,26 @@ protected:
     InterestCallback _interest_callback;
     DataCallback _data_callback;
     ErrorCallback _error_callback;
+    // when set, the face drops what it could not send while reconnecting, the callback sends again what is still needed
+    ConnectCallback _connect_callback;
+
+    // packets dropped because the send queue was full
+    std::atomic<uint64_t> _dropped_packets;
+    // when set, the face only reads while it is open
+    std::shared_ptr<ReadGate> _read_gate;
+    // when set, the face closes this gate while its send queue is saturated
+    Backpressure _backpressure;
+
+    // NDNLPv2 state of datagram faces, the reassembler is only used by the read path and the sequence by the write path
+    LpReassembler _reassembler;
+    uint64_t _lp_sequence;
 
 public:
-    explicit Face(boost::asio::io_service &ios) : _face_id(++counter), _ios(ios) {
+    explicit Face(boost::asio::io_service &ios)
+            : _face_id(++counter)
+            , _ios(ios)
+            , _dropped_packets(0)
+            , _lp_sequence(ndn::random::generateWord64()) {
 
     };
 
@@ -63,6 +90,27 @@ public:
         return _is_connected;
     }
 
+    uint64_t getDroppedPackets() const {
+        return _dropped_packets;
+    }
+
+    // must be called before open()
+    void setReadGate(const std::shared_ptr<ReadGate> &read_gate) {
+        _read_gate = read_gate;
+    }
+
+    // must be called before open()
+    void setBackpressureGate(const std::shared_ptr<ReadGate> &gate, size_t high_packets, size_t high_bytes) {
+        _backpressure.gate = gate;
+        _backpressure.high_packets = high_packets;
+        _backpressure.high_bytes = high_bytes;
+    }
+
+    // must be called before open(), called each time a face reaching its peer by itself is connected
+    void setConnectCallback(const ConnectCallback &connect_callback) {
+        _connect_callback = connect_callback;
+    }
+
     virtual std::string getUnderlyingProtocol() const = 0;
 
     virtual std::string getUnderlyingEndpoint() const = 0;
@@ -73,7 +121,17 @@ public:
 
     virtual void send(const std::string &message) = 0;
 
+    virtual void send(const ndn::Block &wire) = 0;
+
     virtual void send(const ndn::Interest &interest) = 0;
 
     virtual void send(const ndn::Data &data) = 0;
+
+protected:
+    // decode a packet received by this face, LpPackets are unwrapped and their fragments reassembled, the Interests
+    // and Data found are appended to the given vectors, throw if the packet is malformed
+    void decodePacket(const ndn::Block &wire, std::vector<InterestView> &interests, std::vector<ndn::Data> &datas);
+
+    // split the wire in NDNLPv2 fragments no larger than mtu, a wire that fits is given back as is
+    std::vector<ndn::Block> fragmentPacket(const ndn::Block &wire, size_t mtu);
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io_service_pool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+static void pinCurrentThread(int cpu) {
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu, &cpu_set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+            std::cerr << "can't pin worker thread to cpu " << cpu << std::endl;
+        }
+    }
+#endif
+}
+
+IoServicePool::IoServicePool(size_t size) : _cpus(std::max<size_t>(size, 1), -1), _next(0) {
+    for (size_t i = 0; i < std::max<size_t>(size, 1); ++i) {
+        auto ios = std::make_shared<boost::asio::io_service>(1);
+        _works.emplace_back(std::make_shared<boost::asio::io_service::work>(*ios));
+        _io_services.emplace_back(ios);
+    }
+}
+
+size_t IoServicePool::size() const {
+    return _io_services.size();
+}
+
+boost::asio::io_service& IoServicePool::getIoService(size_t index) {
+    return *_io_services[index % _io_services.size()];
+}
+
+boost::asio::io_service& IoServicePool::getNextIoService() {
+    return getIoService(_next++);
+}
+
+void IoServicePool::setCpuAffinity(const std::vector<int> &cpus) {
+    for (size_t i = 0; i < _cpus.size() && i < cpus.size(); ++i) {
+        _cpus[i] = cpus[i];
+    }
+}
+
+int IoServicePool::getCpu(size_t index) const {
+    return _cpus[index % _cpus.size()];
+}
+
+void IoServicePool::run() {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < _io_services.size(); ++i) {
+        threads.emplace_back([this, i]() {
+            pinCurrentThread(_cpus[i]);
+            _io_services[i]->run();
+        });
+    }
+    pinCurrentThread(_cpus[0]);
+    _io_services[0]->run();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void IoServicePool::stop() {
+    for (const auto &ios : _io_services) {
+        ios->stop();
+    }
+}
@@ -0,0 +1,56 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// one io_service per worker thread, faces are pinned to a worker by creating them on its io_service
+class IoServicePool {
+private:
+    std::vector<std::shared_ptr<boost::asio::io_service>> _io_services;
+    std::vector<std::shared_ptr<boost::asio::io_service::work>> _works;
+    // cpu each worker thread is pinned to, -1 if not pinned
+    std::vector<int> _cpus;
+    std::atomic<size_t> _next;
+
+public:
+    explicit IoServicePool(size_t size);
+
+    ~IoServicePool() = default;
+
+    size_t size() const;
+
+    boost::asio::io_service& getIoService(size_t index);
+
+    // round robin over the workers
+    boost::asio::io_service& getNextIoService();
+
+    // pin the worker threads to these cpus (worker i to cpus[i]), must be called before run()
+    void setCpuAffinity(const std::vector<int> &cpus);
+
+    int getCpu(size_t index) const;
+
+    // run each io_service in its own thread (the first one in the calling thread) until all of them are stopped
+    void run();
+
+    void stop();
+};
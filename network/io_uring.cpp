@@ -0,0 +1,425 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "io_uring.h"
+
+#ifdef HAVE_IO_URING
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include "../log/logger.h"
+
+boost::asio::io_service::id IoUring::id;
+
+bool IoUring::enabled = false;
+
+IoUring::BufferRing::BufferRing(IoUring &ring, unsigned count, size_t size)
+        : _ring(ring)
+        , _group(ring._next_buffer_group++)
+        , _count(count)
+        , _size(size)
+        , _buffers(count * size) {
+    // count must be a power of 2, the memory of the ring must be page aligned
+    void *memory = mmap(nullptr, _count * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return;
+    }
+    _buffer_ring = (io_uring_buf_ring *)memory;
+
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)_buffer_ring;
+    reg.ring_entries = _count;
+    reg.bgid = _group;
+    if (syscall(__NR_io_uring_register, _ring._ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        std::stringstream ss;
+        ss << "can't register io_uring buffer ring: " << strerror(errno);
+        logger::log(logger::ERROR, ss.str());
+        return;
+    }
+    _registered = true;
+    for (unsigned i = 0; i < _count; ++i) {
+        recycle((uint16_t)i);
+    }
+}
+
+IoUring::BufferRing::~BufferRing() {
+    if (_registered) {
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.bgid = _group;
+        syscall(__NR_io_uring_register, _ring._ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+    if (_buffer_ring) {
+        munmap(_buffer_ring, _count * sizeof(io_uring_buf));
+    }
+}
+
+bool IoUring::BufferRing::isRegistered() const {
+    return _registered;
+}
+
+uint16_t IoUring::BufferRing::getGroup() const {
+    return _group;
+}
+
+size_t IoUring::BufferRing::getBufferSize() const {
+    return _size;
+}
+
+uint8_t* IoUring::BufferRing::getBuffer(uint16_t buffer_id) {
+    return _buffers.data() + buffer_id * _size;
+}
+
+void IoUring::BufferRing::recycle(uint16_t buffer_id) {
+    // bufs is not usable in C++, __DECLARE_FLEX_ARRAY shifts it behind an empty struct
+    uint16_t tail = _buffer_ring->tail;
+    io_uring_buf *buffer = (io_uring_buf *)_buffer_ring + (tail & (_count - 1));
+    buffer->addr = (uint64_t)getBuffer(buffer_id);
+    buffer->len = (uint32_t)_size;
+    buffer->bid = buffer_id;
+    __atomic_store_n(&_buffer_ring->tail, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+IoUring::IoUring(boost::asio::io_service &ios)
+        : boost::asio::io_service::service(ios)
+        , _event(ios) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int ring_fd = (int)syscall(__NR_io_uring_setup, ENTRIES, &params);
+    if (ring_fd < 0) {
+        std::stringstream ss;
+        ss << "can't create io_uring, fall back to asio: " << strerror(errno);
+        logger::log(logger::ERROR, ss.str());
+        return;
+    }
+
+    _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+    _sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    _cq_ring = single_mmap ? _sq_ring :
+               mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    int event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_sq_ring == MAP_FAILED || _cq_ring == MAP_FAILED || sqes == MAP_FAILED || event_fd < 0 ||
+        syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1) < 0) {
+        std::stringstream ss;
+        ss << "can't set up io_uring, fall back to asio: " << strerror(errno);
+        logger::log(logger::ERROR, ss.str());
+        if (_sq_ring != MAP_FAILED) {
+            munmap(_sq_ring, _sq_ring_size);
+        }
+        if (!single_mmap && _cq_ring != MAP_FAILED) {
+            munmap(_cq_ring, _cq_ring_size);
+        }
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, _sqes_size);
+        }
+        if (event_fd >= 0) {
+            ::close(event_fd);
+        }
+        ::close(ring_fd);
+        _sq_ring = _cq_ring = nullptr;
+        return;
+    }
+
+    auto sq_ring = (uint8_t *)_sq_ring;
+    auto cq_ring = (uint8_t *)_cq_ring;
+    _sq_head = (unsigned *)(sq_ring + params.sq_off.head);
+    _sq_tail = (unsigned *)(sq_ring + params.sq_off.tail);
+    _sq_mask = *(unsigned *)(sq_ring + params.sq_off.ring_mask);
+    _sq_array = (unsigned *)(sq_ring + params.sq_off.array);
+    _sq_flags = (unsigned *)(sq_ring + params.sq_off.flags);
+    _cq_head = (unsigned *)(cq_ring + params.cq_off.head);
+    _cq_tail = (unsigned *)(cq_ring + params.cq_off.tail);
+    _cq_mask = *(unsigned *)(cq_ring + params.cq_off.ring_mask);
+    _cqes = (io_uring_cqe *)(cq_ring + params.cq_off.cqes);
+    _sqes = (io_uring_sqe *)sqes;
+
+    _ring_fd = ring_fd;
+    _event_fd = event_fd;
+    _event.assign(_event_fd);
+    wait();
+}
+
+IoUring::~IoUring() {
+    if (_ring_fd >= 0) {
+        munmap(_sqes, _sqes_size);
+        if (_cq_ring != _sq_ring) {
+            munmap(_cq_ring, _cq_ring_size);
+        }
+        munmap(_sq_ring, _sq_ring_size);
+        ::close(_ring_fd);
+    }
+}
+
+void IoUring::setEnabled(bool state) {
+    enabled = state;
+}
+
+bool IoUring::isEnabled() {
+    return enabled;
+}
+
+IoUring* IoUring::get(boost::asio::io_service &ios) {
+    if (!enabled) {
+        return nullptr;
+    }
+    auto &ring = boost::asio::use_service<IoUring>(ios);
+    return ring.isValid() ? &ring : nullptr;
+}
+
+bool IoUring::isValid() const {
+    return _ring_fd >= 0;
+}
+
+uint64_t IoUring::recv(int fd, void *buffer, size_t size, const Handler &handler) {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        return 0;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)buffer;
+    sqe->len = (uint32_t)size;
+    return prepare(sqe, handler);
+}
+
+uint64_t IoUring::writev(int fd, const iovec *iovecs, unsigned count, const Handler &handler) {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        return 0;
+    }
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)iovecs;
+    sqe->len = count;
+    return prepare(sqe, handler);
+}
+
+uint64_t IoUring::recvmsgMultishot(int fd, msghdr *message, BufferRing &buffer_ring, const Handler &handler) {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        return 0;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)message;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buffer_ring.getGroup();
+    return prepare(sqe, handler);
+}
+
+void IoUring::cancel(uint64_t user_data) {
+    io_uring_sqe *sqe = getSqe();
+    if (!sqe) {
+        // the operation keeps running meanwhile, its handler is called as usual
+        get_io_service().post(boost::bind(&IoUring::cancel, this, user_data));
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    // no handler for the cancellation itself, the canceled operation completes with -ECANCELED
+    prepare(sqe, nullptr);
+}
+
+bool IoUring::getRecvmsgPayload(const msghdr *message, uint8_t *buffer, size_t size,
+                                boost::asio::ip::udp::endpoint &endpoint, const char *&payload, size_t &payload_size) {
+    // layout of the buffer: io_uring_recvmsg_out, name, control, payload
+    size_t header_size = sizeof(io_uring_recvmsg_out) + message->msg_namelen + message->msg_controllen;
+    if (size < header_size) {
+        return false;
+    }
+    auto out = (const io_uring_recvmsg_out *)buffer;
+    if (out->flags & MSG_TRUNC || out->namelen > message->msg_namelen || out->namelen > endpoint.capacity()) {
+        return false;
+    }
+    std::memcpy(endpoint.data(), buffer + sizeof(io_uring_recvmsg_out), out->namelen);
+    endpoint.resize(out->namelen);
+    payload = (const char *)buffer + header_size;
+    payload_size = std::min<size_t>(out->payloadlen, size - header_size);
+    return true;
+}
+
+void IoUring::shutdown_service() {
+    // handlers may hold the last reference to faces
+    _handlers.clear();
+    boost::system::error_code err;
+    _event.close(err);
+}
+
+bool IoUring::isFull() const {
+    return *_sq_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) > _sq_mask;
+}
+
+io_uring_sqe* IoUring::getSqe() {
+    if (isFull()) {
+        // the submission queue is full, submit right now to make room
+        flush();
+        if (isFull()) {
+            // the completion queue is full too, empty it without running the handlers here and try again
+            collect();
+            flush();
+            if (isFull()) {
+                return nullptr;
+            }
+        }
+    }
+    unsigned index = *_sq_tail & _sq_mask;
+    io_uring_sqe *sqe = &_sqes[index];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    _sq_array[index] = index;
+    return sqe;
+}
+
+uint64_t IoUring::prepare(io_uring_sqe *sqe, const Handler &handler) {
+    uint64_t user_data = 0;
+    if (handler) {
+        user_data = _next_user_data++;
+        _handlers.emplace(user_data, handler);
+    }
+    sqe->user_data = user_data;
+    __atomic_store_n(_sq_tail, *_sq_tail + 1, __ATOMIC_RELEASE);
+    ++_pending;
+    if (!_flush_posted) {
+        // let the other handlers of this round prepare their operations, they will be submitted together
+        _flush_posted = true;
+        get_io_service().post(boost::bind(&IoUring::flush, this));
+    }
+    return user_data;
+}
+
+void IoUring::flush() {
+    _flush_posted = false;
+    while (_pending > 0) {
+        int submitted = (int)syscall(__NR_io_uring_enter, _ring_fd, _pending, 0, 0, nullptr, 0);
+        if (submitted < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EBUSY) {
+                // the completion queue is full, try again once it has been reaped
+                _flush_posted = true;
+                get_io_service().post(boost::bind(&IoUring::flush, this));
+                return;
+            }
+            std::stringstream ss;
+            ss << "io_uring submission failed: " << strerror(errno);
+            logger::log(logger::ERROR, ss.str());
+            failPending(errno);
+            return;
+        }
+        _pending -= std::min<unsigned>(_pending, (unsigned)submitted);
+    }
+}
+
+void IoUring::wait() {
+    _event.async_read_some(boost::asio::buffer(&_event_value, sizeof(_event_value)),
+                           boost::bind(&IoUring::waitHandler, this, _1));
+}
+
+void IoUring::waitHandler(const boost::system::error_code &err) {
+    if (err == boost::asio::error::operation_aborted) {
+        return;
+    }
+    reap();
+    wait();
+}
+
+void IoUring::failPending(int error) {
+    // the kernel has not read the submissions left between head and tail, they are taken back
+    unsigned head = __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+    for (unsigned i = head; i != *_sq_tail; ++i) {
+        const io_uring_sqe &sqe = _sqes[_sq_array[i & _sq_mask]];
+        if (sqe.user_data != 0) {
+            io_uring_cqe cqe;
+            std::memset(&cqe, 0, sizeof(cqe));
+            cqe.user_data = sqe.user_data;
+            cqe.res = -error;
+            _completions.emplace_back(cqe);
+        }
+    }
+    __atomic_store_n(_sq_tail, head, __ATOMIC_RELEASE);
+    _pending = 0;
+    postDispatch();
+}
+
+void IoUring::collect() {
+    do {
+        unsigned head = *_cq_head;
+        unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            _completions.emplace_back(_cqes[head & _cq_mask]);
+            ++head;
+        }
+        __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        // the completions that did not fit are kept by the kernel until asked for, without another eventfd signal
+    } while ((__atomic_load_n(_sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) &&
+             syscall(__NR_io_uring_enter, _ring_fd, 0, 0, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0);
+    postDispatch();
+}
+
+void IoUring::postDispatch() {
+    if (!_completions.empty() && !_dispatch_posted) {
+        _dispatch_posted = true;
+        get_io_service().post(boost::bind(&IoUring::dispatch, this));
+    }
+}
+
+void IoUring::reap() {
+    collect();
+    dispatch();
+}
+
+void IoUring::dispatch() {
+    _dispatch_posted = false;
+    // the handlers may prepare new operations and collect more completions
+    std::vector<io_uring_cqe> cqes;
+    cqes.swap(_completions);
+    for (const auto &cqe : cqes) {
+        auto it = _handlers.find(cqe.user_data);
+        if (it == _handlers.end()) {
+            continue;
+        }
+        Handler handler = it->second;
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            _handlers.erase(it);
+        }
+        handler(cqe.res, cqe.flags);
+    }
+}
+
+#endif
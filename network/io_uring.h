@@ -0,0 +1,177 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <boost/asio.hpp>
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "message.h"
+
+// io_uring instance of an io_service, obtained with boost::asio::use_service<IoUring>(ios)
+// completions are signaled through an eventfd watched by the io_service itself so the faces keep running their
+// handlers in the usual loop, submissions made during one round of handlers are sent with a single system call
+// an instance must only be used from the thread running its io_service
+class IoUring : public boost::asio::io_service::service {
+public:
+    static boost::asio::io_service::id id;
+
+    // called with the result of the operation (negative errno on error) and the flags of the completion
+    using Handler = std::function<void(int result, uint32_t flags)>;
+
+    static const unsigned ENTRIES = 1024;
+
+    // buffers given to the multishot receives of a datagram socket
+    static const unsigned DATAGRAM_BUFFER_COUNT = 256;
+    static const size_t DATAGRAM_BUFFER_SIZE = sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage) + ndn::MAX_NDN_PACKET_SIZE;
+
+    // pool of buffers registered to the ring, the kernel picks one of them for each multishot receive completion
+    class BufferRing {
+    private:
+        IoUring &_ring;
+        const uint16_t _group;
+        const unsigned _count;
+        const size_t _size;
+        io_uring_buf_ring *_buffer_ring = nullptr;
+        std::vector<uint8_t> _buffers;
+        bool _registered = false;
+
+    public:
+        BufferRing(IoUring &ring, unsigned count, size_t size);
+
+        ~BufferRing();
+
+        bool isRegistered() const;
+
+        uint16_t getGroup() const;
+
+        size_t getBufferSize() const;
+
+        uint8_t* getBuffer(uint16_t buffer_id);
+
+        // give the buffer back to the kernel once its content has been used
+        void recycle(uint16_t buffer_id);
+    };
+
+private:
+    static bool enabled;
+
+    int _ring_fd = -1;
+    int _event_fd = -1;
+
+    void *_sq_ring = nullptr;
+    size_t _sq_ring_size = 0;
+    void *_cq_ring = nullptr;
+    size_t _cq_ring_size = 0;
+    io_uring_sqe *_sqes = nullptr;
+    size_t _sqes_size = 0;
+
+    unsigned *_sq_head;
+    unsigned *_sq_tail;
+    unsigned _sq_mask;
+    unsigned *_sq_array;
+    unsigned *_sq_flags;
+    unsigned *_cq_head;
+    unsigned *_cq_tail;
+    unsigned _cq_mask;
+    io_uring_cqe *_cqes;
+
+    unsigned _pending = 0;
+    bool _flush_posted = false;
+
+    // taken out of the completion queue (or failed before submission), their handlers not run yet
+    std::vector<io_uring_cqe> _completions;
+    bool _dispatch_posted = false;
+
+    boost::asio::posix::stream_descriptor _event;
+    uint64_t _event_value;
+
+    uint64_t _next_user_data = 1;
+    std::unordered_map<uint64_t, Handler> _handlers;
+    uint16_t _next_buffer_group = 0;
+
+public:
+    explicit IoUring(boost::asio::io_service &ios);
+
+    ~IoUring() override;
+
+    // select the io_uring backend for the faces created from now on (set at launch)
+    static void setEnabled(bool state);
+
+    static bool isEnabled();
+
+    // return nullptr if the backend is not selected or if the kernel refused to create the ring
+    static IoUring* get(boost::asio::io_service &ios);
+
+    bool isValid() const;
+
+    // the operations return 0 if the submission queue stays full, the caller falls back to asio
+    uint64_t recv(int fd, void *buffer, size_t size, const Handler &handler);
+
+    uint64_t writev(int fd, const iovec *iovecs, unsigned count, const Handler &handler);
+
+    // the handler is called for every received datagram as long as IORING_CQE_F_MORE is set in the flags, each
+    // datagram is stored in the buffer of the ring given by the flags (see getRecvmsgPayload)
+    uint64_t recvmsgMultishot(int fd, msghdr *message, BufferRing &buffer_ring, const Handler &handler);
+
+    void cancel(uint64_t user_data);
+
+    // locate the source endpoint and the payload of a datagram written in a buffer by a multishot recvmsg
+    // return false if the datagram has been truncated
+    static bool getRecvmsgPayload(const msghdr *message, uint8_t *buffer, size_t size,
+                                  boost::asio::ip::udp::endpoint &endpoint, const char *&payload, size_t &payload_size);
+
+private:
+    void shutdown_service() override;
+
+    bool isFull() const;
+
+    // nullptr if no entry can be freed
+    io_uring_sqe* getSqe();
+
+    uint64_t prepare(io_uring_sqe *sqe, const Handler &handler);
+
+    void flush();
+
+    void wait();
+
+    void waitHandler(const boost::system::error_code &err);
+
+    // the submissions not taken by the kernel complete with -error
+    void failPending(int error);
+
+    // move the completions out of the ring, their handlers run later
+    void collect();
+
+    void postDispatch();
+
+    void reap();
+
+    void dispatch();
+};
+
+#endif
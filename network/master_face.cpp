@@ -17,4 +17,4 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "master_face.h"
 
-size_t MasterFace::counter = 0;
\ No newline at end of file
+std::atomic<size_t> MasterFace::counter(0);
\ No newline at end of file
@@ -28,7 +28,7 @@ public:
     using ErrorCallback = std::function<void(const std::shared_ptr<MasterFace> &master_face, const std::shared_ptr<Face>&)>;
 
 private:
-    static size_t counter;
+    static std::atomic<size_t> counter;
 
 protected:
     const size_t _master_face_id;
@@ -37,13 +37,22 @@ protected:
 
     size_t _max_connection;
 
+    // packets dropped because the send queue shared by the sub-faces was full
+    std::atomic<uint64_t> _dropped_packets;
+    // when set, the master face and its faces only read while it is open
+    std::shared_ptr<ReadGate> _read_gate;
+
     NotificationCallback _notification_callback;
     Face::InterestCallback _interest_callback;
     Face::DataCallback _data_callback;
     ErrorCallback _error_callback;
 
 public:
-    MasterFace(boost::asio::io_service &ios, size_t max_connection) : _master_face_id(++counter), _ios(ios), _max_connection(max_connection) {
+    MasterFace(boost::asio::io_service &ios, size_t max_connection)
+            : _master_face_id(++counter)
+            , _ios(ios)
+            , _max_connection(max_connection)
+            , _dropped_packets(0) {
 
     }
 
@@ -57,6 +66,15 @@ public:
         return _master_face_id;
     }
 
+    uint64_t getDroppedPackets() const {
+        return _dropped_packets;
+    }
+
+    // must be called before listen()
+    void setReadGate(const std::shared_ptr<ReadGate> &read_gate) {
+        _read_gate = read_gate;
+    }
+
     virtual std::string getUnderlyingProtocol() const = 0;
 
     virtual void listen(const NotificationCallback &notification_callback, const Face::InterestCallback &interest_callback,
@@ -66,6 +84,8 @@ public:
 
     virtual void sendToAllFaces(const std::string &message) = 0;
 
+    virtual void sendToAllFaces(const ndn::Block &wire) = 0;
+
     virtual void sendToAllFaces(const ndn::Interest &interest) = 0;
 
     virtual void sendToAllFaces(const ndn::Data &data) = 0;
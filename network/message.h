@@ -0,0 +1,63 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/encoding/block.hpp>
+
+#include <boost/asio.hpp>
+
+#include <memory>
+#include <string>
+
+// immutable wire queued by reference, every face sending the same packet shares its buffer which is released once
+// the last write completes
+class Message {
+private:
+    ndn::ConstBufferPtr _buffer;
+    const uint8_t *_data;
+    size_t _size;
+
+public:
+    explicit Message(const ndn::Block &block)
+            : _buffer(block.getBuffer())
+            , _data(block.wire())
+            , _size(block.size()) {
+
+    }
+
+    explicit Message(const std::string &message)
+            : _buffer(std::make_shared<ndn::Buffer>(message.data(), message.size()))
+            , _data(_buffer->data())
+            , _size(_buffer->size()) {
+
+    }
+
+    ~Message() = default;
+
+    const uint8_t* data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    boost::asio::const_buffers_1 buffer() const {
+        return boost::asio::buffer(_data, _size);
+    }
+};
@@ -0,0 +1,237 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "packet_ring.h"
+
+#ifdef __linux__
+
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/system/system_error.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+const PacketRing::MacAddress PacketRing::NDN_MULTICAST_ADDRESS = {{0x01, 0x00, 0x5e, 0x00, 0x17, 0xaa}};
+
+static void throwError(int fd, const std::string &what) {
+    int error = errno;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    throw boost::system::system_error(error, boost::system::system_category(), what);
+}
+
+PacketRing::PacketRing(const std::string &interface, uint16_t ethertype, int fanout_group)
+        : _ethertype(ethertype) {
+    int fd = socket(AF_PACKET, SOCK_RAW, htons(_ethertype));
+    if (fd < 0) {
+        throwError(fd, "socket");
+    }
+
+    ifreq request;
+    std::memset(&request, 0, sizeof(request));
+    std::strncpy(request.ifr_name, interface.c_str(), IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFINDEX, &request) < 0) {
+        throwError(fd, interface);
+    }
+    int if_index = request.ifr_ifindex;
+    if (ioctl(fd, SIOCGIFHWADDR, &request) < 0) {
+        throwError(fd, interface);
+    }
+    std::copy(request.ifr_hwaddr.sa_data, request.ifr_hwaddr.sa_data + ETH_ALEN, _address.begin());
+    if (ioctl(fd, SIOCGIFMTU, &request) < 0) {
+        throwError(fd, interface);
+    }
+    _mtu = std::min<size_t>((size_t)request.ifr_mtu, TX_FRAME_SIZE - TPACKET3_HDRLEN - ETH_HLEN);
+
+    int version = TPACKET_V3;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        throwError(fd, "PACKET_VERSION");
+    }
+#ifdef PACKET_IGNORE_OUTGOING
+    // the frames sent by this socket are not looped back to its rx ring
+    int ignore = 1;
+    setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore, sizeof(ignore));
+#endif
+
+    tpacket_req3 rx_request;
+    std::memset(&rx_request, 0, sizeof(rx_request));
+    rx_request.tp_block_size = RX_BLOCK_SIZE;
+    rx_request.tp_block_nr = RX_BLOCK_COUNT;
+    rx_request.tp_frame_size = RX_FRAME_SIZE;
+    rx_request.tp_frame_nr = RX_BLOCK_SIZE / RX_FRAME_SIZE * RX_BLOCK_COUNT;
+    rx_request.tp_retire_blk_tov = RX_BLOCK_TIMEOUT;
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &rx_request, sizeof(rx_request)) < 0) {
+        throwError(fd, "PACKET_RX_RING");
+    }
+    tpacket_req3 tx_request;
+    std::memset(&tx_request, 0, sizeof(tx_request));
+    tx_request.tp_block_size = TX_BLOCK_SIZE;
+    tx_request.tp_block_nr = TX_FRAME_COUNT * TX_FRAME_SIZE / TX_BLOCK_SIZE;
+    tx_request.tp_frame_size = TX_FRAME_SIZE;
+    tx_request.tp_frame_nr = TX_FRAME_COUNT;
+    if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &tx_request, sizeof(tx_request)) < 0) {
+        throwError(fd, "PACKET_TX_RING");
+    }
+
+    // both rings are mapped at once, the tx ring follows the rx ring
+    _map_size = RX_BLOCK_SIZE * RX_BLOCK_COUNT + TX_FRAME_SIZE * TX_FRAME_COUNT;
+    void *map = mmap(nullptr, _map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+    if (map == MAP_FAILED) {
+        // MAP_LOCKED is limited by RLIMIT_MEMLOCK, the rings still work without it
+        map = mmap(nullptr, _map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            throwError(fd, "mmap");
+        }
+    }
+    _map = (uint8_t *)map;
+
+    sockaddr_ll address;
+    std::memset(&address, 0, sizeof(address));
+    address.sll_family = AF_PACKET;
+    address.sll_protocol = htons(_ethertype);
+    address.sll_ifindex = if_index;
+    if (bind(fd, (sockaddr *)&address, sizeof(address)) < 0) {
+        munmap(_map, _map_size);
+        throwError(fd, "bind");
+    }
+
+    if (fanout_group >= 0) {
+        // the kernel hashes the IP flows only, the frames of NDN would all go to the same ring: the ring is chosen by
+        // the last bytes of the source address instead (modulo the number of rings), so a peer stays on one worker
+        int fanout = (fanout_group & 0xffff) | (PACKET_FANOUT_CBPF << 16);
+        if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) < 0) {
+            munmap(_map, _map_size);
+            throwError(fd, "PACKET_FANOUT");
+        }
+        sock_filter code[] = {
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)(SKF_LL_OFF + ETH_ALEN + 2)),
+            BPF_STMT(BPF_RET | BPF_A, 0),
+        };
+        sock_fprog program = {sizeof(code) / sizeof(code[0]), code};
+        if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT_DATA, &program, sizeof(program)) < 0) {
+            munmap(_map, _map_size);
+            throwError(fd, "PACKET_FANOUT_DATA");
+        }
+    }
+
+    packet_mreq membership;
+    std::memset(&membership, 0, sizeof(membership));
+    membership.mr_ifindex = if_index;
+    membership.mr_type = PACKET_MR_MULTICAST;
+    membership.mr_alen = ETH_ALEN;
+    std::copy(NDN_MULTICAST_ADDRESS.begin(), NDN_MULTICAST_ADDRESS.end(), membership.mr_address);
+    setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &membership, sizeof(membership));
+
+    _fd = fd;
+}
+
+PacketRing::~PacketRing() {
+    munmap(_map, _map_size);
+    ::close(_fd);
+}
+
+int PacketRing::getFd() const {
+    return _fd;
+}
+
+const PacketRing::MacAddress& PacketRing::getAddress() const {
+    return _address;
+}
+
+size_t PacketRing::getMtu() const {
+    return _mtu;
+}
+
+bool PacketRing::receive(const FrameCallback &callback, size_t max_blocks) {
+    for (size_t i = 0; i < max_blocks; ++i) {
+        auto block = (tpacket_block_desc *)(_map + _rx_block * RX_BLOCK_SIZE);
+        if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+            return false;
+        }
+
+        auto frame = (const uint8_t *)block + block->hdr.bh1.offset_to_first_pkt;
+        for (uint32_t n = 0; n < block->hdr.bh1.num_pkts; ++n) {
+            auto header = (const tpacket3_hdr *)frame;
+            auto link = (const sockaddr_ll *)(frame + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+            // frames sent by the host itself are also seen by packet sockets
+            if (link->sll_pkttype != PACKET_OUTGOING && link->sll_pkttype != PACKET_OTHERHOST &&
+                header->tp_snaplen == header->tp_len && header->tp_snaplen > ETH_HLEN) {
+                auto ethernet = (const ethhdr *)(frame + header->tp_mac);
+                MacAddress source;
+                std::copy(ethernet->h_source, ethernet->h_source + ETH_ALEN, source.begin());
+                callback(source, (const uint8_t *)ethernet + ETH_HLEN, header->tp_snaplen - ETH_HLEN);
+            }
+            frame += header->tp_next_offset;
+        }
+
+        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        _rx_block = (_rx_block + 1) % RX_BLOCK_COUNT;
+    }
+    auto block = (tpacket_block_desc *)(_map + _rx_block * RX_BLOCK_SIZE);
+    return (__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) != 0;
+}
+
+bool PacketRing::push(const MacAddress &destination, const uint8_t *payload, size_t size) {
+    auto header = (tpacket3_hdr *)(_map + RX_BLOCK_SIZE * RX_BLOCK_COUNT + _tx_frame * TX_FRAME_SIZE);
+    uint32_t status = __atomic_load_n(&header->tp_status, __ATOMIC_ACQUIRE);
+    if (status != TP_STATUS_AVAILABLE && !(status & TP_STATUS_WRONG_FORMAT)) {
+        return false;
+    }
+
+    // the kernel expects the frame right before where the sockaddr_ll of a received frame would end
+    auto frame = (uint8_t *)header + TPACKET3_HDRLEN - sizeof(sockaddr_ll);
+    auto ethernet = (ethhdr *)frame;
+    std::copy(destination.begin(), destination.end(), ethernet->h_dest);
+    std::copy(_address.begin(), _address.end(), ethernet->h_source);
+    ethernet->h_proto = htons(_ethertype);
+    std::memcpy(frame + ETH_HLEN, payload, size);
+    size_t length = ETH_HLEN + size;
+    if (length < MIN_FRAME_SIZE) {
+        // padding is ignored by the receiver, the TLV gives the size of the packet
+        std::memset(frame + length, 0, MIN_FRAME_SIZE - length);
+        length = MIN_FRAME_SIZE;
+    }
+    header->tp_len = (uint32_t)length;
+    header->tp_next_offset = 0;
+    __atomic_store_n(&header->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    _tx_frame = (_tx_frame + 1) % TX_FRAME_COUNT;
+    return true;
+}
+
+int PacketRing::send() {
+    return (int)::send(_fd, nullptr, 0, MSG_DONTWAIT);
+}
+
+std::string PacketRing::toString(const MacAddress &address) {
+    char buffer[18];
+    std::snprintf(buffer, sizeof(buffer), "%02x:%02x:%02x:%02x:%02x:%02x",
+                  address[0], address[1], address[2], address[3], address[4], address[5]);
+    return buffer;
+}
+
+#endif
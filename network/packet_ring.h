@@ -0,0 +1,87 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef __linux__
+
+#include <linux/if_packet.h>
+
+#include <array>
+#include <functional>
+#include <string>
+
+// AF_PACKET socket bound to one interface and one ethertype, with TPACKET_V3 rings shared with the kernel
+// received frames are read in place from the rx blocks and frames to send are written in place in the tx ring,
+// the kernel then sends all of them with a single system call
+class PacketRing {
+public:
+    using MacAddress = std::array<uint8_t, 6>;
+    using FrameCallback = std::function<void(const MacAddress &source, const uint8_t *payload, size_t size)>;
+
+    // the kernel hands a block to the user once it is full or after RX_BLOCK_TIMEOUT ms
+    static const size_t RX_BLOCK_SIZE = 1 << 20;
+    static const size_t RX_BLOCK_COUNT = 16;
+    static const size_t RX_FRAME_SIZE = 1 << 11;
+    static const unsigned RX_BLOCK_TIMEOUT = 1;
+    // large enough for jumbo frames
+    static const size_t TX_FRAME_SIZE = 1 << 14;
+    static const size_t TX_FRAME_COUNT = 256;
+    static const size_t TX_BLOCK_SIZE = TX_FRAME_SIZE * 4;
+    static const size_t MIN_FRAME_SIZE = 60;
+
+    // multicast address joined by NDN forwarders on Ethernet
+    static const MacAddress NDN_MULTICAST_ADDRESS;
+
+private:
+    int _fd = -1;
+    const uint16_t _ethertype;
+    MacAddress _address;
+    size_t _mtu;
+
+    uint8_t *_map = nullptr;
+    size_t _map_size = 0;
+    size_t _rx_block = 0;
+    size_t _tx_frame = 0;
+
+public:
+    // throw a boost::system::system_error if the interface can't be opened (requires CAP_NET_RAW), the rings given the
+    // same fanout_group share the received frames, those of a source address always go to the same ring
+    PacketRing(const std::string &interface, uint16_t ethertype, int fanout_group = -1);
+
+    ~PacketRing();
+
+    int getFd() const;
+
+    const MacAddress& getAddress() const;
+
+    // largest payload that fits in one frame
+    size_t getMtu() const;
+
+    // hand the frames of up to max_blocks blocks to the callback, return true if more blocks are ready
+    bool receive(const FrameCallback &callback, size_t max_blocks);
+
+    // write a frame in the tx ring, return false if the ring is full
+    bool push(const MacAddress &destination, const uint8_t *payload, size_t size);
+
+    // ask the kernel to send the pushed frames without blocking, return -1 on error (see errno)
+    int send();
+
+    static std::string toString(const MacAddress &address);
+};
+
+#endif
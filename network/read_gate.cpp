@@ -0,0 +1,57 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "read_gate.h"
+
+ReadGate::ReadGate() : _open(true) {
+
+}
+
+bool ReadGate::isOpen() const {
+    return _open;
+}
+
+void ReadGate::wait(const std::function<void()> &handler) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_open) {
+            _waiting.push_back(handler);
+            return;
+        }
+    }
+    handler();
+}
+
+void ReadGate::open() {
+    std::vector<std::function<void()>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_open) {
+            return;
+        }
+        _open = true;
+        waiting.swap(_waiting);
+    }
+    for (const auto &handler : waiting) {
+        handler();
+    }
+}
+
+void ReadGate::close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _open = false;
+}
@@ -0,0 +1,46 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// shared by the ingress faces, closed by the egress face while it can't keep up so they stop reading, their socket
+// buffers then fill and the transport (TCP window, dropped datagrams) pushes back on the consumers
+class ReadGate {
+private:
+    std::atomic<bool> _open;
+    std::mutex _mutex;
+    std::vector<std::function<void()>> _waiting;
+
+public:
+    ReadGate();
+
+    ~ReadGate() = default;
+
+    bool isOpen() const;
+
+    // run the handler right away if the gate is open, else once it opens (from the thread opening it)
+    void wait(const std::function<void()> &handler);
+
+    void open();
+
+    void close();
+};
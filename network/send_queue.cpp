@@ -0,0 +1,40 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "send_queue.h"
+
+size_t SendQueueLimits::max_packets = SendQueueLimits::DEFAULT_MAX_PACKETS;
+size_t SendQueueLimits::max_bytes = SendQueueLimits::DEFAULT_MAX_BYTES;
+SendQueueLimits::Policy SendQueueLimits::policy = SendQueueLimits::DROP_TAIL;
+
+void SendQueueLimits::set(size_t max_packets, size_t max_bytes, Policy policy) {
+    SendQueueLimits::max_packets = max_packets;
+    SendQueueLimits::max_bytes = max_bytes;
+    SendQueueLimits::policy = policy;
+}
+
+size_t SendQueueLimits::getMaxPackets() {
+    return max_packets;
+}
+
+size_t SendQueueLimits::getMaxBytes() {
+    return max_bytes;
+}
+
+SendQueueLimits::Policy SendQueueLimits::getPolicy() {
+    return policy;
+}
@@ -0,0 +1,188 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <utility>
+
+#include "message.h"
+#include "read_gate.h"
+
+// limits and overflow policy shared by the send queues of every face, set once at launch
+class SendQueueLimits {
+public:
+    enum Policy {
+        // the new packet is dropped
+        DROP_TAIL,
+        // the oldest packets not being written are dropped to make room
+        DROP_OLDEST,
+        // the face is closed, the faces that can't be closed (e.g., the egress face) drop the new packet instead
+        CLOSE,
+    };
+
+    static const size_t DEFAULT_MAX_PACKETS = 4096;
+    static const size_t DEFAULT_MAX_BYTES = 1 << 22;
+
+private:
+    static size_t max_packets;
+    static size_t max_bytes;
+    static Policy policy;
+
+public:
+    static void set(size_t max_packets, size_t max_bytes, Policy policy);
+
+    static size_t getMaxPackets();
+
+    static size_t getMaxBytes();
+
+    static Policy getPolicy();
+};
+
+// gate closed while a send queue holds at least high_packets or high_bytes and opened once it drains below a quarter
+// of them
+struct Backpressure {
+    std::shared_ptr<ReadGate> gate;
+    size_t high_packets = 0;
+    size_t high_bytes = 0;
+};
+
+// send queue bounded in packets and in bytes, Item is a Message or a pair of a Message and its destination
+// not thread-safe, a face only touches it from its strand
+template <class Item>
+class SendQueue {
+public:
+    enum Result {
+        QUEUED,
+        // the new packet or older ones were dropped to respect the limits
+        DROPPED,
+        // nothing was queued, the policy asks for the face to be closed
+        OVERFLOWED,
+    };
+
+private:
+    std::deque<Item> _items;
+    size_t _bytes = 0;
+    // the first items are referenced by a pending write, they can't be dropped
+    size_t _in_flight = 0;
+    bool _saturated = false;
+    std::atomic<uint64_t> &_dropped_packets;
+    // its gate, if any, is closed while the queue is saturated
+    const Backpressure *_backpressure;
+
+public:
+    explicit SendQueue(std::atomic<uint64_t> &dropped_packets, const Backpressure *backpressure = nullptr)
+            : _dropped_packets(dropped_packets)
+            , _backpressure(backpressure) {
+
+    }
+
+    ~SendQueue() = default;
+
+    bool empty() const {
+        return _items.empty();
+    }
+
+    size_t size() const {
+        return _items.size();
+    }
+
+    size_t bytes() const {
+        return _bytes;
+    }
+
+    typename std::deque<Item>::const_iterator begin() const {
+        return _items.begin();
+    }
+
+    typename std::deque<Item>::const_iterator end() const {
+        return _items.end();
+    }
+
+    const Item& front() const {
+        return _items.front();
+    }
+
+    Result push(const Item &item) {
+        size_t size = sizeOf(item);
+        Result result = QUEUED;
+        while (isFull(size)) {
+            if (SendQueueLimits::getPolicy() == SendQueueLimits::DROP_OLDEST && _items.size() > _in_flight) {
+                dropAt(_in_flight);
+                result = DROPPED;
+            } else {
+                ++_dropped_packets;
+                return SendQueueLimits::getPolicy() == SendQueueLimits::CLOSE ? OVERFLOWED : DROPPED;
+            }
+        }
+        _items.push_back(item);
+        _bytes += size;
+        updateGate();
+        return result;
+    }
+
+    void pop() {
+        _bytes -= sizeOf(_items.front());
+        _items.pop_front();
+        if (_in_flight > 0) {
+            --_in_flight;
+        }
+        updateGate();
+    }
+
+    // the first count items are being written
+    void setInFlight(size_t count) {
+        _in_flight = count;
+    }
+
+private:
+    static size_t sizeOf(const Message &message) {
+        return message.size();
+    }
+
+    template <class Destination>
+    static size_t sizeOf(const std::pair<Message, Destination> &item) {
+        return item.first.size();
+    }
+
+    bool isFull(size_t size) const {
+        return !_items.empty() && (_items.size() >= SendQueueLimits::getMaxPackets() ||
+                                   _bytes + size > SendQueueLimits::getMaxBytes());
+    }
+
+    void dropAt(size_t index) {
+        _bytes -= sizeOf(_items[index]);
+        _items.erase(_items.begin() + index);
+        ++_dropped_packets;
+    }
+
+    void updateGate() {
+        if (!_backpressure || !_backpressure->gate) {
+            return;
+        }
+        if (!_saturated && (_items.size() >= _backpressure->high_packets || _bytes >= _backpressure->high_bytes)) {
+            _saturated = true;
+            _backpressure->gate->close();
+        } else if (_saturated && _items.size() < _backpressure->high_packets / 4 &&
+                   _bytes < _backpressure->high_bytes / 4) {
+            _saturated = false;
+            _backpressure->gate->open();
+        }
+    }
+};
@@ -0,0 +1,413 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "face.h"
+#include "io_uring.h"
+#include "../log/logger.h"
+#include "../tlv/tlv_framer.h"
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// face over a connected asio stream socket (TCP, Unix), Protocol is boost::asio::ip::tcp or
+// boost::asio::local::stream_protocol, subclasses only give their constructors and their protocol name
+template <class Protocol>
+class StreamFace : public Face, public std::enable_shared_from_this<StreamFace<Protocol>> {
+public:
+    // limits of one gathered write, the remaining messages wait for the next one
+    static const size_t MAX_WRITE_BYTES = 1 << 16;
+    static const size_t MAX_WRITE_BUFFERS = 64;
+
+protected:
+    bool _skip_connect;
+    // lost its connection and tries to get it back
+    bool _reconnecting = false;
+
+    typename Protocol::endpoint _endpoint;
+    typename Protocol::socket _socket;
+    boost::asio::strand _strand;
+    TlvFramer _framer;
+    bool _queue_in_use = false;
+    SendQueue<Message> _queue;
+    std::vector<boost::asio::const_buffer> _write_buffers;
+#ifdef HAVE_IO_URING
+    // nullptr when the asio backend is used
+    IoUring *_uring = nullptr;
+    uint64_t _read_operation = 0;
+    uint64_t _write_operation = 0;
+    std::vector<iovec> _write_iovecs;
+#endif
+
+    boost::asio::deadline_timer _timer;
+
+public:
+    StreamFace(boost::asio::io_service &ios, const typename Protocol::endpoint &endpoint)
+            : Face(ios)
+            , _skip_connect(false)
+            , _endpoint(endpoint)
+            , _socket(ios)
+            , _strand(ios)
+            , _queue(_dropped_packets, &_backpressure)
+            , _timer(ios) {
+#ifdef HAVE_IO_URING
+        _uring = IoUring::get(ios);
+#endif
+    }
+
+    // specific constructor for master faces, not recommended to use it yourself
+    explicit StreamFace(typename Protocol::socket &&socket)
+            : Face(socket.get_io_service())
+            , _skip_connect(true)
+            , _endpoint(socket.remote_endpoint())
+            , _socket(std::move(socket))
+            , _strand(_ios)
+            , _queue(_dropped_packets, &_backpressure)
+            , _timer(_ios) {
+#ifdef HAVE_IO_URING
+        _uring = IoUring::get(_ios);
+#endif
+    }
+
+    ~StreamFace() override = default;
+
+    std::string getUnderlyingEndpoint() const override {
+        std::stringstream ss;
+        ss << _endpoint;
+        return ss.str();
+    }
+
+    void open(const InterestCallback &interest_callback, const DataCallback &data_callback, const ErrorCallback &error_callback) override {
+        _interest_callback = interest_callback;
+        _data_callback = data_callback;
+        _error_callback = error_callback;
+        if(!_skip_connect && !_is_connected) {
+            connect();
+        } else {
+            _is_connected = true;
+            read();
+        }
+    }
+
+    void close() override {
+        _is_connected = false;
+#ifdef HAVE_IO_URING
+        if (_uring) {
+            // the ring holds its own reference to the socket, closing it does not end the pending operations
+            _strand.dispatch(boost::bind(&StreamFace::uringCancel, this->shared_from_this()));
+        }
+#endif
+        _socket.close();
+    }
+
+    void send(const std::string &message) override {
+        _strand.dispatch(boost::bind(&StreamFace::sendImpl, this->shared_from_this(), Message(message)));
+    }
+
+    void send(const ndn::Block &wire) override {
+        _strand.dispatch(boost::bind(&StreamFace::sendImpl, this->shared_from_this(), Message(wire)));
+    }
+
+    void send(const ndn::Interest &interest) override {
+        send(interest.wireEncode());
+    }
+
+    void send(const ndn::Data &data) override {
+        send(data.wireEncode());
+    }
+
+protected:
+    // e.g. tcp://127.0.0.1:6363 or unix:///run/nfd.sock
+    std::string getUri() const {
+        return boost::algorithm::to_lower_copy(getUnderlyingProtocol()) + "://" + getUnderlyingEndpoint();
+    }
+
+private:
+    void connect() {
+        _timer.expires_from_now(boost::posix_time::seconds(2));
+        _timer.async_wait(_strand.wrap(boost::bind(&StreamFace::timerHandler, this->shared_from_this(), _1)));
+        _socket.async_connect(_endpoint, _strand.wrap(boost::bind(&StreamFace::connectHandler, this->shared_from_this(), _1)));
+    }
+
+    void connectHandler(const boost::system::error_code &err) {
+        _timer.cancel();
+        if (!err) {
+            std::stringstream ss;
+            ss << getUnderlyingProtocol() << " face with ID = " << _face_id << " successfully connected to " << getUri();
+            logger::log(logger::INFO, ss.str());
+            _is_connected = true;
+            read();
+            if (_connect_callback) {
+                _connect_callback(this->shared_from_this());
+            }
+        } else {
+            std::stringstream ss;
+            ss << "failed to connect to " << getUri();
+            logger::log(logger::ERROR, ss.str());
+            _error_callback(this->shared_from_this());
+        }
+    }
+
+    void reconnect(size_t remaining_attempt) {
+        std::stringstream ss;
+        ss << "try to reconnect to " << getUri();
+        logger::log(logger::INFO, ss.str());
+#ifdef HAVE_IO_URING
+        if (_uring) {
+            // the pending write ends before the connection is back, not on the new connection
+            uringCancel();
+        }
+#endif
+        _socket.close();
+        _timer.expires_from_now(boost::posix_time::seconds(2));
+        _timer.async_wait(_strand.wrap(boost::bind(&StreamFace::timerHandler, this->shared_from_this(), _1)));
+        _socket.async_connect(_endpoint, boost::bind(&StreamFace::reconnectHandler, this->shared_from_this(), _1, remaining_attempt - 1));
+    }
+
+    void reconnectHandler(const boost::system::error_code &err, size_t remaining_attempt) {
+        _timer.cancel();
+        if(!err) {
+            _reconnecting = false;
+            read();
+            if (_connect_callback) {
+                // after the failed write is cleaned up
+                _ios.post(boost::bind(_connect_callback, this->shared_from_this()));
+            } else if(_queue_in_use) {
+                write();
+            }
+        } else if (remaining_attempt > 0 && _is_connected) {
+            std::stringstream ss;
+            ss << "wait 1s before next reconnection to " << getUri();
+            logger::log(logger::INFO, ss.str());
+            _timer.expires_from_now(boost::posix_time::seconds(1));
+            _timer.async_wait(boost::bind(&StreamFace::reconnect, this->shared_from_this(), remaining_attempt));
+        } else {
+            std::stringstream ss;
+            ss << "failed to reconnect to " << getUri();
+            logger::log(logger::ERROR, ss.str());
+            _error_callback(this->shared_from_this());
+        }
+    }
+
+    void read() {
+        if (_read_gate && !_read_gate->isOpen()) {
+            // the egress face can't keep up, stop reading until it drains
+            auto self = this->shared_from_this();
+            _read_gate->wait([self]() {
+                self->_ios.post(boost::bind(&StreamFace::read, self));
+            });
+            return;
+        }
+#ifdef HAVE_IO_URING
+        if (_uring) {
+            // the kernel writes straight into the framer chunk, end of stream is reported as a 0 byte receive
+            auto buffer = _framer.prepare();
+            auto self = this->shared_from_this();
+            _read_operation = _uring->recv(_socket.native_handle(), boost::asio::buffer_cast<void *>(buffer),
+                                           boost::asio::buffer_size(buffer), [self](int result, uint32_t flags) {
+                self->_read_operation = 0;
+                if (result > 0) {
+                    self->readHandler(boost::system::error_code(), (size_t)result);
+                } else if (result == 0) {
+                    self->readHandler(boost::asio::error::eof, 0);
+                } else {
+                    self->readHandler(boost::system::error_code(-result, boost::system::system_category()), 0);
+                }
+            });
+            if (_read_operation != 0) {
+                return;
+            }
+        }
+#endif
+        boost::asio::async_read(_socket, _framer.prepare(), boost::asio::transfer_at_least(1),
+                                boost::bind(&StreamFace::readHandler, this->shared_from_this(), _1, _2));
+    }
+
+    void readHandler(const boost::system::error_code &err, size_t bytes_transferred) {
+        if(!err) {
+            _framer.commit(bytes_transferred);
+            std::vector<ndn::Block> blocks;
+            _framer.extractBlocks(blocks);
+
+            // packets share the framer chunk, decoding them does not copy the wire
+            std::vector<InterestView> interests;
+            std::vector<ndn::Data> datas;
+            for (const auto &block : blocks) {
+                try {
+                    decodePacket(block, interests, datas);
+                } catch (const std::exception &e) {
+                    std::cerr << e.what() << std::endl;
+                }
+            }
+
+            for (const auto &interest : interests) {
+                _interest_callback(this->shared_from_this(), interest);
+            }
+
+            for (const auto &data : datas) {
+                _data_callback(this->shared_from_this(), data);
+            }
+
+            read();
+        } else {
+            if(!_skip_connect && _is_connected) {
+                std::stringstream ss;
+                ss << "lost connection to " << getUri();
+                logger::log(logger::WARNING, ss.str());
+                _reconnecting = true;
+                reconnect(3);
+            } else {
+                _error_callback(this->shared_from_this());
+            }
+        }
+    }
+
+    void sendImpl(const Message &message) {
+        if (_reconnecting && _connect_callback) {
+            // sent again by the connect callback if still needed
+            return;
+        }
+        if (_queue.push(message) == SendQueue<Message>::OVERFLOWED) {
+            // a face that reconnects by itself is not closed, the packet is only dropped
+            if (_skip_connect && _is_connected) {
+                std::stringstream ss;
+                ss << "send queue of " << getUri() << " is full, " << getUnderlyingProtocol() << " face with ID = "
+                   << _face_id << " is closed";
+                logger::log(logger::WARNING, ss.str());
+                close();
+            }
+            return;
+        }
+        if (_queue_in_use) {
+            return;
+        }
+
+        _queue_in_use = true;
+        write();
+    }
+
+    void write() {
+        // gather as much pending messages as possible in a single write
+        _write_buffers.clear();
+        size_t bytes = 0;
+        for (const auto &message : _queue) {
+            if (_write_buffers.size() == MAX_WRITE_BUFFERS ||
+                (!_write_buffers.empty() && bytes + message.size() > MAX_WRITE_BYTES)) {
+                break;
+            }
+            _write_buffers.emplace_back(message.buffer());
+            bytes += message.size();
+        }
+        _queue.setInFlight(_write_buffers.size());
+#ifdef HAVE_IO_URING
+        if (_uring) {
+            _write_iovecs.clear();
+            for (const auto &buffer : _write_buffers) {
+                _write_iovecs.push_back({const_cast<void *>(boost::asio::buffer_cast<const void *>(buffer)),
+                                         boost::asio::buffer_size(buffer)});
+            }
+            uringWrite();
+            return;
+        }
+#endif
+        boost::asio::async_write(_socket, _write_buffers, _strand.wrap(boost::bind(&StreamFace::writeHandler, this->shared_from_this(), _1, _2)));
+    }
+
+    void writeHandler(const boost::system::error_code &err, size_t bytesTransferred) {
+        if(!err) {
+            for (size_t i = 0; i < _write_buffers.size(); ++i) {
+                _queue.pop();
+            }
+
+            if (!_queue.empty()) {
+                write();
+            } else {
+                _queue_in_use = false;
+            }
+        } else if (_connect_callback) {
+            // the messages still needed are sent again once reconnected, the others would only arrive late
+            while (!_queue.empty()) {
+                _queue.pop();
+            }
+            _queue_in_use = false;
+        }
+    }
+
+#ifdef HAVE_IO_URING
+    void uringWrite() {
+        auto self = this->shared_from_this();
+        _write_operation = _uring->writev(_socket.native_handle(), _write_iovecs.data(), (unsigned)_write_iovecs.size(),
+                                          [self](int result, uint32_t flags) {
+            self->_strand.dispatch(boost::bind(&StreamFace::uringWriteHandler, self, result));
+        });
+        if (_write_operation == 0) {
+            // the ring is full, what is left of this write goes through asio
+            std::vector<boost::asio::const_buffer> buffers;
+            for (const auto &iov : _write_iovecs) {
+                buffers.emplace_back(iov.iov_base, iov.iov_len);
+            }
+            boost::asio::async_write(_socket, buffers, _strand.wrap(boost::bind(&StreamFace::writeHandler, self, _1, _2)));
+        }
+    }
+
+    void uringWriteHandler(int result) {
+        _write_operation = 0;
+        if (result < 0) {
+            writeHandler(boost::system::error_code(-result, boost::system::system_category()), 0);
+            return;
+        }
+
+        // the socket may take only a part of the gathered write, submit the remaining part
+        size_t written = (size_t)result;
+        auto it = _write_iovecs.begin();
+        while (it != _write_iovecs.end() && written >= it->iov_len) {
+            written -= it->iov_len;
+            ++it;
+        }
+        _write_iovecs.erase(_write_iovecs.begin(), it);
+        if (!_write_iovecs.empty()) {
+            _write_iovecs.front().iov_base = (uint8_t *)_write_iovecs.front().iov_base + written;
+            _write_iovecs.front().iov_len -= written;
+            uringWrite();
+            return;
+        }
+        writeHandler(boost::system::error_code(), (size_t)result);
+    }
+
+    void uringCancel() {
+        if (_read_operation) {
+            _uring->cancel(_read_operation);
+        }
+        if (_write_operation) {
+            _uring->cancel(_write_operation);
+        }
+    }
+#endif
+
+    void timerHandler(const boost::system::error_code &err) {
+        if (!err) {
+            _error_callback(this->shared_from_this());
+        }
+    }
+};
@@ -0,0 +1,144 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "master_face.h"
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+#include "io_service_pool.h"
+#include "../log/logger.h"
+
+// accepts connections on an asio stream acceptor and wraps each of them in a FaceType (a StreamFace<Protocol>)
+template <class Protocol, class FaceType>
+class StreamMasterFace : public MasterFace, public std::enable_shared_from_this<StreamMasterFace<Protocol, FaceType>> {
+protected:
+    IoServicePool &_pool;
+    // each accepted face is created on the next worker of the pool
+    std::shared_ptr<typename Protocol::socket> _socket;
+    typename Protocol::acceptor _acceptor;
+    std::mutex _faces_mutex;
+    std::unordered_set<std::shared_ptr<Face>> _faces;
+
+public:
+    StreamMasterFace(IoServicePool &pool, size_t max_connection, const typename Protocol::endpoint &endpoint,
+                     bool reuse_port = false)
+            : MasterFace(pool.getIoService(0), max_connection)
+            , _pool(pool)
+            , _acceptor(_ios) {
+        _acceptor.open(endpoint.protocol());
+        _acceptor.set_option(typename Protocol::acceptor::reuse_address(true));
+#ifdef __linux__
+        // several processes accept on the same port, the kernel spreads the connections
+        if (reuse_port) {
+            _acceptor.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+        }
+#endif
+        _acceptor.bind(endpoint);
+    }
+
+    ~StreamMasterFace() override = default;
+
+    void listen(const NotificationCallback &notification_callback, const Face::InterestCallback &interest_callback,
+                const Face::DataCallback &data_callback, const ErrorCallback &error_callback) override {
+        _notification_callback = notification_callback;
+        _interest_callback = interest_callback;
+        _data_callback = data_callback;
+        _error_callback = error_callback;
+        _acceptor.listen(16);
+        std::stringstream ss;
+        ss << "master face with ID = " << _master_face_id << " listening on " << getScheme() << "://" << _acceptor.local_endpoint();
+        logger::log(logger::INFO, ss.str());
+        accept();
+    }
+
+    void close() override {
+        _acceptor.close();
+        std::lock_guard<std::mutex> lock(_faces_mutex);
+        for(const auto &face : _faces) {
+            face->close();
+        }
+    }
+
+    void sendToAllFaces(const std::string &message) override {
+        std::lock_guard<std::mutex> lock(_faces_mutex);
+        for(const auto &face : _faces) {
+            face->send(message);
+        }
+    }
+
+    void sendToAllFaces(const ndn::Block &wire) override {
+        std::lock_guard<std::mutex> lock(_faces_mutex);
+        for(const auto &face : _faces) {
+            face->send(wire);
+        }
+    }
+
+    void sendToAllFaces(const ndn::Interest &interest) override {
+        sendToAllFaces(interest.wireEncode());
+    }
+
+    void sendToAllFaces(const ndn::Data &data) override {
+        sendToAllFaces(data.wireEncode());
+    }
+
+private:
+    std::string getScheme() const {
+        return boost::algorithm::to_lower_copy(getUnderlyingProtocol());
+    }
+
+    void accept() {
+        _socket = std::make_shared<typename Protocol::socket>(_pool.getNextIoService());
+        _acceptor.async_accept(*_socket, boost::bind(&StreamMasterFace::acceptHandler, this->shared_from_this(), _1));
+    }
+
+    void acceptHandler(const boost::system::error_code &err) {
+        if(!err) {
+            std::unique_lock<std::mutex> lock(_faces_mutex);
+            if(_faces.size() < _max_connection) {
+                auto face = std::make_shared<FaceType>(std::move(*_socket));
+                face->setReadGate(_read_gate);
+                std::stringstream ss;
+                ss << "new connection from " << getScheme() << "://" << face->getUnderlyingEndpoint();
+                logger::log(logger::INFO, ss.str());
+                _faces.emplace(face);
+                lock.unlock();
+                _notification_callback(this->shared_from_this(), face);
+                face->open(_interest_callback, _data_callback, boost::bind(&StreamMasterFace::onFaceError, this->shared_from_this(), _1));
+            }
+            accept();
+        } else {
+            std::cerr << err.message() << std::endl;
+        }
+    }
+
+    void onFaceError(const std::shared_ptr<Face> &face) {
+        {
+            std::lock_guard<std::mutex> lock(_faces_mutex);
+            _faces.erase(face);
+        }
+        _error_callback(this->shared_from_this(), face);
+    }
+};
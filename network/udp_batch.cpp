@@ -0,0 +1,87 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "udp_batch.h"
+
+#ifdef __linux__
+
+#include <cstring>
+
+size_t UdpBatch::size() const {
+    return _size;
+}
+
+bool UdpBatch::receive(int fd) {
+    if (_buffer.empty()) {
+        _buffer.resize(BATCH_SIZE * SLOT_SIZE);
+    }
+    for (size_t i = 0; i < BATCH_SIZE; ++i) {
+        _iovecs[i].iov_base = _buffer.data() + i * SLOT_SIZE;
+        _iovecs[i].iov_len = SLOT_SIZE;
+        std::memset(&_headers[i], 0, sizeof(mmsghdr));
+        _headers[i].msg_hdr.msg_name = &_addresses[i];
+        _headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        _headers[i].msg_hdr.msg_iov = &_iovecs[i];
+        _headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    int result = ::recvmmsg(fd, _headers, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+    _size = result > 0 ? (size_t)result : 0;
+    return result > 0;
+}
+
+const char* UdpBatch::getData(size_t index) const {
+    return (const char *)_iovecs[index].iov_base;
+}
+
+size_t UdpBatch::getSize(size_t index) const {
+    return _headers[index].msg_len;
+}
+
+bool UdpBatch::isTruncated(size_t index) const {
+    return (_headers[index].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+}
+
+boost::asio::ip::udp::endpoint UdpBatch::getEndpoint(size_t index) const {
+    boost::asio::ip::udp::endpoint endpoint;
+    std::memcpy(endpoint.data(), &_addresses[index], _headers[index].msg_hdr.msg_namelen);
+    endpoint.resize(_headers[index].msg_hdr.msg_namelen);
+    return endpoint;
+}
+
+bool UdpBatch::push(const Message &message, const boost::asio::ip::udp::endpoint &endpoint) {
+    if (_size == BATCH_SIZE) {
+        return false;
+    }
+    _iovecs[_size].iov_base = const_cast<uint8_t *>(message.data());
+    _iovecs[_size].iov_len = message.size();
+    std::memset(&_headers[_size], 0, sizeof(mmsghdr));
+    std::memcpy(&_addresses[_size], endpoint.data(), endpoint.size());
+    _headers[_size].msg_hdr.msg_name = &_addresses[_size];
+    _headers[_size].msg_hdr.msg_namelen = (socklen_t)endpoint.size();
+    _headers[_size].msg_hdr.msg_iov = &_iovecs[_size];
+    _headers[_size].msg_hdr.msg_iovlen = 1;
+    ++_size;
+    return true;
+}
+
+int UdpBatch::send(int fd) {
+    int result = ::sendmmsg(fd, _headers, (unsigned int)_size, MSG_DONTWAIT);
+    _size = 0;
+    return result;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef __linux__
+
+#include <sys/socket.h>
+
+#include <boost/asio.hpp>
+
+#include <vector>
+
+#include "message.h"
+
+// batched datagram I/O with recvmmsg/sendmmsg, up to BATCH_SIZE datagrams are moved by one system call
+// an instance is either used to receive or to send, never both at the same time
+class UdpBatch {
+public:
+    static const size_t BATCH_SIZE = 32;
+    // a datagram larger than a NDN packet is truncated then dropped
+    static const size_t SLOT_SIZE = ndn::MAX_NDN_PACKET_SIZE;
+
+private:
+    std::vector<uint8_t> _buffer;
+    mmsghdr _headers[BATCH_SIZE];
+    iovec _iovecs[BATCH_SIZE];
+    sockaddr_storage _addresses[BATCH_SIZE];
+    size_t _size = 0;
+
+public:
+    UdpBatch() = default;
+
+    ~UdpBatch() = default;
+
+    size_t size() const;
+
+    // receive as much datagrams as possible without blocking, return false if nothing can be read (see errno)
+    bool receive(int fd);
+
+    const char* getData(size_t index) const;
+
+    size_t getSize(size_t index) const;
+
+    bool isTruncated(size_t index) const;
+
+    boost::asio::ip::udp::endpoint getEndpoint(size_t index) const;
+
+    // prepare a datagram to send, return false if the batch is full
+    bool push(const Message &message, const boost::asio::ip::udp::endpoint &endpoint);
+
+    // send the prepared datagrams without blocking, return the number of datagrams sent or -1 (see errno)
+    int send(int fd);
+};
+
+#endif
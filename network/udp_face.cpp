@@ -19,6 +19,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <boost/bind.hpp>
 
+#include <cerrno>
+#include <cstring>
 #include <sstream>
 
 UdpFace::UdpFace(boost::asio::io_service &ios, const std::string &host, uint16_t port)
@@ -26,7 +28,11 @@ UdpFace::UdpFace(boost::asio::io_service &ios, const std::string &host, uint16_t
         , _endpoint(boost::asio::ip::address::from_string(host), port)
         , _socket(ios, boost::asio::ip::udp::v4())
         , _strand(ios)
+        , _queue(_dropped_packets, &_backpressure)
         , _timer(ios) {
+#ifdef HAVE_IO_URING
+    _uring = IoUring::get(ios);
+#endif
 }
 
 UdpFace::UdpFace(boost::asio::io_service &ios, const boost::asio::ip::udp::endpoint &endpoint)
@@ -34,7 +40,11 @@ UdpFace::UdpFace(boost::asio::io_service &ios, const boost::asio::ip::udp::endpo
         , _endpoint(endpoint)
         , _socket(ios, boost::asio::ip::udp::v4())
         , _strand(ios)
+        , _queue(_dropped_packets, &_backpressure)
         , _timer(ios) {
+#ifdef HAVE_IO_URING
+    _uring = IoUring::get(ios);
+#endif
 }
 
 std::string UdpFace::getUnderlyingProtocol() const {
@@ -55,48 +65,91 @@ void UdpFace::open(const InterestCallback &interest_callback, const DataCallback
 }
 
 void UdpFace::close() {
+#ifdef HAVE_IO_URING
+    if (_uring) {
+        // the ring holds its own reference to the socket, closing it does not end the multishot receive
+        _strand.dispatch(boost::bind(&UdpFace::uringCancel, shared_from_this()));
+    }
+#endif
     _socket.close();
 }
 
 void UdpFace::send(const std::string &message) {
-    _strand.dispatch(boost::bind(&UdpFace::sendImpl, shared_from_this(), message));
+    _strand.dispatch(boost::bind(&UdpFace::sendImpl, shared_from_this(), Message(message)));
+}
+
+void UdpFace::send(const ndn::Block &wire) {
+    if (wire.size() > MTU) {
+        _strand.dispatch(boost::bind(&UdpFace::sendFragments, shared_from_this(), wire));
+    } else {
+        _strand.dispatch(boost::bind(&UdpFace::sendImpl, shared_from_this(), Message(wire)));
+    }
 }
 
 void UdpFace::send(const ndn::Interest &interest) {
-    _strand.dispatch(boost::bind(&UdpFace::sendImpl, shared_from_this(), std::string((const char *)interest.wireEncode().wire(), interest.wireEncode().size())));
+    send(interest.wireEncode());
 }
 
 void UdpFace::send(const ndn::Data &data) {
-    _strand.dispatch(boost::bind(&UdpFace::sendImpl, shared_from_this(), std::string((const char *)data.wireEncode().wire(), data.wireEncode().size())));
+    send(data.wireEncode());
 }
 
 void UdpFace::read() {
+#ifdef HAVE_IO_URING
+    if (_uring) {
+        if (!_buffer_ring) {
+            _buffer_ring.reset(new IoUring::BufferRing(*_uring, IoUring::DATAGRAM_BUFFER_COUNT, IoUring::DATAGRAM_BUFFER_SIZE));
+            std::memset(&_recv_header, 0, sizeof(_recv_header));
+            _recv_header.msg_namelen = sizeof(sockaddr_storage);
+        }
+        // without provided buffers (kernel older than 5.19) the receive side stays on asio
+        if (_buffer_ring->isRegistered()) {
+            auto self = shared_from_this();
+            _read_operation = _uring->recvmsgMultishot(_socket.native_handle(), &_recv_header, *_buffer_ring,
+                                                       [self](int result, uint32_t flags) {
+                self->uringReadHandler(result, flags);
+            });
+            if (_read_operation != 0) {
+                return;
+            }
+        }
+    }
+#endif
+#ifdef __linux__
+    // only wait for the socket to be readable, datagrams are then pulled by batch
+    _socket.async_receive(boost::asio::null_buffers(),
+                          boost::bind(&UdpFace::readHandler, shared_from_this(), _1, _2));
+#else
     _socket.async_receive_from(boost::asio::buffer(_buffer, BUFFER_SIZE), _remote_endpoint,
                                boost::bind(&UdpFace::readHandler, shared_from_this(), _1, _2));
+#endif
 }
 
 void UdpFace::readHandler(const boost::system::error_code &err, size_t bytes_transferred) {
     if(!err) {
-        if (_remote_endpoint == _endpoint) {
-            try {
-                switch (_buffer[0]) {
-                    case 0x00:
-                        // special packet, just echoes it
-                        send("0");
-                        break;
-                    case 0x05:
-                        _interest_callback(shared_from_this(), ndn::Interest(ndn::Block((uint8_t *) _buffer, bytes_transferred)));
-                        break;
-                    case 0x06:
-                        _data_callback(shared_from_this(), ndn::Data(ndn::Block((uint8_t *) _buffer, bytes_transferred)));
-                        break;
-                    default:
-                        break;
+#ifdef __linux__
+        // pull up to UdpBatch::BATCH_SIZE datagrams per wakeup so other handlers are not starved by a flood
+        if (_read_batch.receive(_socket.native_handle())) {
+            for (size_t i = 0; i < _read_batch.size(); ++i) {
+                if (!_read_batch.isTruncated(i) && _read_batch.getEndpoint(i) == _endpoint) {
+                    proceedDatagram(_read_batch.getData(i), _read_batch.getSize(i));
                 }
-            } catch (const std::exception &e) {
-                std::cerr << e.what() << std::endl;
             }
+            if (_read_batch.size() == UdpBatch::BATCH_SIZE) {
+                // more datagrams may be waiting, the reactor is edge-triggered and would not wake us up again
+                _strand.post(boost::bind(&UdpFace::readHandler, shared_from_this(), boost::system::error_code(), 0));
+                return;
+            }
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cerr << strerror(errno) << std::endl;
+            _error_callback(shared_from_this());
+            return;
         }
+#else
+        if (_remote_endpoint == _endpoint) {
+            proceedDatagram(_buffer, bytes_transferred);
+        }
+#endif
         read();
     } else {
         std::cerr << err.message() << std::endl;
@@ -104,24 +157,126 @@ void UdpFace::readHandler(const boost::system::error_code &err, size_t bytes_tra
     }
 }
 
-void UdpFace::sendImpl(const std::string &message) {
-    _queue.push_back(message);
-    if (_queue.size() == 1) {
+void UdpFace::proceedDatagram(const char *buffer, size_t size) {
+    if (buffer[0] == 0x00) {
+        // special packet, just echoes it
+        send("0");
+        return;
+    }
+    try {
+        std::vector<InterestView> interests;
+        std::vector<ndn::Data> datas;
+        decodePacket(ndn::Block((uint8_t *) buffer, size), interests, datas);
+        for (const auto &interest : interests) {
+            _interest_callback(shared_from_this(), interest);
+        }
+        for (const auto &data : datas) {
+            _data_callback(shared_from_this(), data);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void UdpFace::sendFragments(const ndn::Block &wire) {
+    try {
+        for (const auto &fragment : fragmentPacket(wire, MTU)) {
+            sendImpl(Message(fragment));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void UdpFace::sendImpl(const Message &message) {
+    // nothing to close on overflow, the packet is only dropped
+    bool idle = _queue.empty();
+    _queue.push(message);
+    if (idle) {
+#ifdef __linux__
+        // let the other sends of this round fill the queue, they will leave with the same system call
+        _strand.post(boost::bind(&UdpFace::write, shared_from_this()));
+#else
         write();
+#endif
     }
 }
 
 void UdpFace::write() {
-    const std::string& message = _queue.front();
-    _socket.async_send_to(boost::asio::buffer(message), _endpoint,
+#ifdef __linux__
+    // with the io_uring backend too, the ring has no batched send and a sendmsg per datagram is slower than sendmmsg
+    while (!_queue.empty()) {
+        for (const auto &message : _queue) {
+            if (!_write_batch.push(message, _endpoint)) {
+                break;
+            }
+        }
+        int sent = _write_batch.send(_socket.native_handle());
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // the socket buffer is full, wait for it to be writable again
+                _socket.async_send(boost::asio::null_buffers(),
+                                   _strand.wrap(boost::bind(&UdpFace::writeHandler, shared_from_this(), _1, _2)));
+                return;
+            }
+            // the first datagram can't be sent, drop it
+            std::cerr << strerror(errno) << std::endl;
+            sent = 1;
+        }
+        for (int i = 0; i < sent; ++i) {
+            _queue.pop();
+        }
+    }
+#else
+    const Message& message = _queue.front();
+    _queue.setInFlight(1);
+    _socket.async_send_to(message.buffer(), _endpoint,
                           _strand.wrap(boost::bind(&UdpFace::writeHandler, shared_from_this(), _1, _2)));
+#endif
 }
 
 void UdpFace::writeHandler(const boost::system::error_code &err, size_t bytesTransferred) {
     if(!err) {
-        _queue.pop_front();
+#ifndef __linux__
+        _queue.pop();
+#endif
         if (!_queue.empty()) {
             write();
         }
     }
-}
\ No newline at end of file
+}
+
+#ifdef HAVE_IO_URING
+void UdpFace::uringReadHandler(int result, uint32_t flags) {
+    if (result < 0 && result != -ENOBUFS) {
+        _read_operation = 0;
+        std::cerr << strerror(-result) << std::endl;
+        _error_callback(shared_from_this());
+        return;
+    }
+
+    if (flags & IORING_CQE_F_BUFFER) {
+        uint16_t buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+        boost::asio::ip::udp::endpoint endpoint;
+        const char *payload;
+        size_t size;
+        // the packet is copied when decoded, the buffer can go back to the kernel right after
+        if (result > 0 && IoUring::getRecvmsgPayload(&_recv_header, _buffer_ring->getBuffer(buffer_id), (size_t)result,
+                                                     endpoint, payload, size) && size > 0 && endpoint == _endpoint) {
+            proceedDatagram(payload, size);
+        }
+        _buffer_ring->recycle(buffer_id);
+    }
+
+    if (!(flags & IORING_CQE_F_MORE)) {
+        // the kernel ended the multishot receive (e.g. it ran out of buffers), arm a new one
+        read();
+    }
+}
+
+void UdpFace::uringCancel() {
+    if (_read_operation) {
+        _uring->cancel(_read_operation);
+    }
+}
+#endif
\ No newline at end of file
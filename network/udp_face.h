@@ -18,26 +18,41 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include "face.h"
+#include "io_uring.h"
+#include "udp_batch.h"
 
 #include <boost/asio.hpp>
 
 #include <iostream>
 #include <string>
-#include <deque>
 #include <vector>
 
 
 class UdpFace : public Face, public std::enable_shared_from_this<UdpFace> {
 public:
     static const size_t BUFFER_SIZE = 1 << 16;
+    // larger packets are sent in NDNLPv2 fragments
+    static const size_t MTU = ndn::MAX_NDN_PACKET_SIZE;
 
 private:
     boost::asio::ip::udp::endpoint _endpoint;
     boost::asio::ip::udp::endpoint _remote_endpoint;
     boost::asio::ip::udp::socket _socket;
     boost::asio::strand _strand;
+#ifdef __linux__
+    UdpBatch _read_batch;
+    UdpBatch _write_batch;
+#else
     char _buffer[BUFFER_SIZE];
-    std::deque<std::string> _queue;
+#endif
+    SendQueue<Message> _queue;
+#ifdef HAVE_IO_URING
+    // nullptr when the asio backend is used
+    IoUring *_uring = nullptr;
+    std::unique_ptr<IoUring::BufferRing> _buffer_ring;
+    msghdr _recv_header;
+    uint64_t _read_operation = 0;
+#endif
 
     boost::asio::deadline_timer _timer;
 
@@ -59,6 +74,8 @@ public:
 
     void send(const std::string &message) override;
 
+    void send(const ndn::Block &wire) override;
+
     void send(const ndn::Interest &interest) override;
 
     void send(const ndn::Data &data) override;
@@ -68,9 +85,19 @@ private:
 
     void readHandler(const boost::system::error_code &err, size_t bytes_transferred);
 
-    void sendImpl(const std::string &message);
+    void proceedDatagram(const char *buffer, size_t size);
+
+    void sendFragments(const ndn::Block &wire);
+
+    void sendImpl(const Message &message);
 
     void write();
 
     void writeHandler(const boost::system::error_code &err, size_t bytesTransferred);
+
+#ifdef HAVE_IO_URING
+    void uringReadHandler(int result, uint32_t flags);
+
+    void uringCancel();
+#endif
 };
\ No newline at end of file
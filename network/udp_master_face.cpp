@@ -19,13 +19,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <boost/bind.hpp>
 
+#include <cerrno>
+#include <cstring>
+
 #include "../log/logger.h"
 
 UdpMasterFace::UdpSubFace::UdpSubFace(UdpMasterFace &master_face, const boost::asio::ip::udp::endpoint &endpoint)
         : Face(master_face.get_io_service())
         , _master_face(master_face)
         , _endpoint(endpoint)
-        , _timer(master_face.get_io_service()) {
+        , _last_activity(master_face._sweeps) {
 
 }
 
@@ -49,8 +52,6 @@ void UdpMasterFace::UdpSubFace::open(const InterestCallback &interest_callback,
     _interest_callback = interest_callback;
     _data_callback = data_callback;
     _error_callback = error_callback;
-    _timer.expires_from_now(boost::posix_time::seconds(3));
-    _timer.async_wait(boost::bind(&UdpSubFace::timerHandler, shared_from_this(), _1, false));
 }
 
 void UdpMasterFace::UdpSubFace::close() {
@@ -58,64 +59,118 @@ void UdpMasterFace::UdpSubFace::close() {
 }
 
 void UdpMasterFace::UdpSubFace::send(const std::string &message) {
-    _timer.expires_from_now(boost::posix_time::seconds(3));
-    _master_face._strand.post(boost::bind(&UdpMasterFace::sendImpl, _master_face.shared_from_this(), message, _endpoint));
+    _master_face._strand.post(boost::bind(&UdpSubFace::sendImpl, shared_from_this(), Message(message)));
+}
+
+void UdpMasterFace::UdpSubFace::send(const ndn::Block &wire) {
+    if (wire.size() > MTU) {
+        _master_face._strand.post(boost::bind(&UdpSubFace::sendFragments, shared_from_this(), wire));
+    } else {
+        _master_face._strand.post(boost::bind(&UdpSubFace::sendImpl, shared_from_this(), Message(wire)));
+    }
 }
 
 void UdpMasterFace::UdpSubFace::send(const ndn::Interest &interest) {
-    _timer.expires_from_now(boost::posix_time::seconds(3));
-    _master_face._strand.post(boost::bind(&UdpMasterFace::sendImpl, _master_face.shared_from_this(), std::string((const char *)interest.wireEncode().wire(), interest.wireEncode().size()), _endpoint));
+    send(interest.wireEncode());
 }
 
 void UdpMasterFace::UdpSubFace::send(const ndn::Data &data) {
-    _timer.expires_from_now(boost::posix_time::seconds(3));
-    _master_face._strand.post(boost::bind(&UdpMasterFace::sendImpl, _master_face.shared_from_this(), std::string((const char *)data.wireEncode().wire(), data.wireEncode().size()), _endpoint));
+    send(data.wireEncode());
+}
+
+void UdpMasterFace::UdpSubFace::sendFragments(const ndn::Block &wire) {
+    try {
+        for (const auto &fragment : fragmentPacket(wire, MTU)) {
+            sendImpl(Message(fragment));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void UdpMasterFace::UdpSubFace::sendImpl(const Message &message) {
+    // only touched from the master face strand, sends may come from any worker
+    _last_activity = _master_face._sweeps;
+    if (_master_face.sendImpl(message, _endpoint) == Queue::OVERFLOWED) {
+        std::stringstream ss;
+        ss << "send queue of udp://" << _endpoint << " is full, face with ID = " << _face_id << " is closed";
+        logger::log(logger::WARNING, ss.str());
+        close();
+    }
 }
 
 void UdpMasterFace::UdpSubFace::proceedPacket(const char *buffer, size_t size) {
-    _timer.expires_from_now(boost::posix_time::seconds(3));
+    _last_activity = _master_face._sweeps;
     try {
-        switch (buffer[0]) {
-            case 0x05:
-                _interest_callback(shared_from_this(), ndn::Interest(ndn::Block((uint8_t *) buffer, size)));
-                break;
-            case 0x06:
-                _data_callback(shared_from_this(), ndn::Data(ndn::Block((uint8_t *) buffer, size)));
-                break;
-            default:
-                break;
+        std::vector<InterestView> interests;
+        std::vector<ndn::Data> datas;
+        decodePacket(ndn::Block((uint8_t *) buffer, size), interests, datas);
+        for (const auto &interest : interests) {
+            _interest_callback(shared_from_this(), interest);
+        }
+        for (const auto &data : datas) {
+            _data_callback(shared_from_this(), data);
         }
     } catch (const std::exception &e) {
         std::cerr << e.what() << std::endl;
     }
 }
 
-void UdpMasterFace::UdpSubFace::timerHandler(const boost::system::error_code &err, bool last_chance) {
-    if (_timer.expires_at() <= boost::asio::deadline_timer::traits_type::now()) {
-        if (!last_chance) {
-            // endpoint must manifest itself in the given time, else the socket will close (icmp or timeout)
-            _master_face._strand.post(boost::bind(&UdpMasterFace::sendImpl, _master_face.shared_from_this(), "0", _endpoint));
-            _timer.expires_from_now(boost::posix_time::seconds(2));
-            _timer.async_wait(boost::bind(&UdpSubFace::timerHandler, shared_from_this(), _1, true));
-        } else {
-            std::stringstream ss;
-            ss << "no activity from/to " << _endpoint << " since 5s" << std::endl;
-            logger::log(logger::INFO, ss.str());
-            _error_callback(shared_from_this());
+bool UdpMasterFace::UdpSubFace::sweep(uint64_t sweeps) {
+    uint64_t idle = sweeps - _last_activity;
+    if (idle < IDLE_TIMEOUT) {
+        _probed = false;
+    } else if (!_probed) {
+        // endpoint must manifest itself in the given time, else the socket will close (icmp or timeout)
+        _master_face.sendImpl(Message("0"), _endpoint);
+        _probed = true;
+    } else if (idle >= IDLE_TIMEOUT + PROBE_TIMEOUT) {
+        std::stringstream ss;
+        ss << "no activity from/to " << _endpoint << " since " << idle * SWEEP_INTERVAL << "s";
+        logger::log(logger::INFO, ss.str());
+        return true;
+    }
+    return false;
+}
+
+size_t UdpMasterFace::EndpointHash::operator()(const boost::asio::ip::udp::endpoint &endpoint) const {
+    size_t hash = endpoint.port();
+    if (endpoint.address().is_v4()) {
+        for (auto byte : endpoint.address().to_v4().to_bytes()) {
+            hash = hash * 131 + byte;
         }
     } else {
-        _timer.async_wait(boost::bind(&UdpSubFace::timerHandler, shared_from_this(), _1, false));
+        for (auto byte : endpoint.address().to_v6().to_bytes()) {
+            hash = hash * 131 + byte;
+        }
     }
+    return hash;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-UdpMasterFace::UdpMasterFace(boost::asio::io_service &ios, size_t max_connection, uint16_t port)
+UdpMasterFace::UdpMasterFace(boost::asio::io_service &ios, size_t max_connection, uint16_t port, bool reuse_port, int cpu)
         : MasterFace(ios, max_connection)
         , _local_endpoint(boost::asio::ip::udp::v4(), port)
-        , _socket(_ios, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), port))
-        , _strand(_ios) {
-
+        , _socket(_ios)
+        , _strand(_ios)
+        , _queue(_dropped_packets)
+        , _sweep_timer(_ios) {
+    _socket.open(_local_endpoint.protocol());
+#ifdef __linux__
+    if (reuse_port) {
+        _socket.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+    }
+#ifdef SO_INCOMING_CPU
+    if (cpu >= 0) {
+        _socket.set_option(boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_INCOMING_CPU>(cpu));
+    }
+#endif
+#endif
+    _socket.bind(_local_endpoint);
+#ifdef HAVE_IO_URING
+    _uring = IoUring::get(_ios);
+#endif
 }
 
 std::string UdpMasterFace::getUnderlyingProtocol() const {
@@ -132,11 +187,22 @@ void UdpMasterFace::listen(const MasterFace::NotificationCallback &notification_
     ss << "master face with ID = " << _master_face_id << " listening on udp://" << _local_endpoint;
     logger::log(logger::INFO, ss.str());
     read();
+    _sweep_timer.expires_from_now(boost::posix_time::seconds(SWEEP_INTERVAL));
+    _sweep_timer.async_wait(_strand.wrap(boost::bind(&UdpMasterFace::sweepHandler, shared_from_this(), _1)));
 }
 
 void UdpMasterFace::close() {
+#ifdef HAVE_IO_URING
+    if (_uring) {
+        // the ring holds its own reference to the socket, closing it does not end the multishot receive
+        _strand.dispatch(boost::bind(&UdpMasterFace::uringCancel, shared_from_this()));
+    }
+#endif
     _socket.close();
-    for(const auto &face : _faces) {
+    _sweep_timer.cancel();
+    // closing a sub-face removes it from _faces
+    auto faces = _faces;
+    for(const auto &face : faces) {
         face.second->close();
     }
 }
@@ -147,64 +213,154 @@ void UdpMasterFace::sendToAllFaces(const std::string &message) {
     }
 }
 
-void UdpMasterFace::sendToAllFaces(const ndn::Interest &interest) {
-    std::string message((const char *)interest.wireEncode().wire(), interest.wireEncode().size());
+void UdpMasterFace::sendToAllFaces(const ndn::Block &wire) {
     for(const auto &face : _faces) {
-        face.second->send(message);
+        face.second->send(wire);
     }
 }
 
+void UdpMasterFace::sendToAllFaces(const ndn::Interest &interest) {
+    sendToAllFaces(interest.wireEncode());
+}
+
 void UdpMasterFace::sendToAllFaces(const ndn::Data &data) {
-    std::string message((const char *)data.wireEncode().wire(), data.wireEncode().size());
-    for(const auto &face : _faces) {
-        face.second->send(message);
-    }
+    sendToAllFaces(data.wireEncode());
 }
 
 void UdpMasterFace::read() {
+    if (_read_gate && !_read_gate->isOpen()) {
+        // the egress face can't keep up, stop reading until it drains
+        auto self = shared_from_this();
+        _read_gate->wait([self]() {
+            self->_strand.post(boost::bind(&UdpMasterFace::read, self));
+        });
+        return;
+    }
+#ifdef HAVE_IO_URING
+    if (_uring) {
+        if (!_buffer_ring) {
+            _buffer_ring.reset(new IoUring::BufferRing(*_uring, IoUring::DATAGRAM_BUFFER_COUNT, IoUring::DATAGRAM_BUFFER_SIZE));
+            std::memset(&_recv_header, 0, sizeof(_recv_header));
+            _recv_header.msg_namelen = sizeof(sockaddr_storage);
+        }
+        // without provided buffers (kernel older than 5.19) the receive side stays on asio
+        if (_buffer_ring->isRegistered()) {
+            auto self = shared_from_this();
+            _read_operation = _uring->recvmsgMultishot(_socket.native_handle(), &_recv_header, *_buffer_ring,
+                                                       [self](int result, uint32_t flags) {
+                self->_strand.dispatch(boost::bind(&UdpMasterFace::uringReadHandler, self, result, flags));
+            });
+            if (_read_operation != 0) {
+                return;
+            }
+        }
+    }
+#endif
+#ifdef __linux__
+    // only wait for the socket to be readable, datagrams are then pulled by batch
+    _socket.async_receive(boost::asio::null_buffers(),
+                          _strand.wrap(boost::bind(&UdpMasterFace::readHandler, shared_from_this(), _1, _2)));
+#else
     _socket.async_receive_from(boost::asio::buffer(_buffer, BUFFER_SIZE), _remote_endpoint,
-                               boost::bind(&UdpMasterFace::readHandler, shared_from_this(), _1, _2));
+                               _strand.wrap(boost::bind(&UdpMasterFace::readHandler, shared_from_this(), _1, _2)));
+#endif
 }
 
 void UdpMasterFace::readHandler(const boost::system::error_code &err, size_t bytes_transferred) {
     if(!err) {
-        std::shared_ptr<UdpSubFace> face;
-        auto it = _faces.find(_remote_endpoint);
-        if (it != _faces.end()) {
-            face = it->second;
-            face->proceedPacket(_buffer, bytes_transferred);
-        } else if (_faces.size() < _max_connection) {
-            std::stringstream ss;
-            ss << "new connection from udp://" << _remote_endpoint;
-            logger::log(logger::INFO, ss.str());
-            face = std::make_shared<UdpSubFace>(*this, _remote_endpoint);
-            face->open(_interest_callback, _data_callback, boost::bind(&UdpMasterFace::onFaceError, shared_from_this(), _1));
-            _notification_callback(shared_from_this(), face);
-            _faces.emplace(_remote_endpoint, face);
-            face->proceedPacket(_buffer, bytes_transferred);
+#ifdef __linux__
+        // pull up to UdpBatch::BATCH_SIZE datagrams per wakeup so other handlers are not starved by a flood
+        if (_read_batch.receive(_socket.native_handle())) {
+            for (size_t i = 0; i < _read_batch.size(); ++i) {
+                if (!_read_batch.isTruncated(i)) {
+                    proceedDatagram(_read_batch.getEndpoint(i), _read_batch.getData(i), _read_batch.getSize(i));
+                }
+            }
+            if (_read_batch.size() == UdpBatch::BATCH_SIZE) {
+                // more datagrams may be waiting, the reactor is edge-triggered and would not wake us up again
+                _strand.post(boost::bind(&UdpMasterFace::readHandler, shared_from_this(), boost::system::error_code(), 0));
+                return;
+            }
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cerr << "[ERROR] " << strerror(errno) << std::endl;
         }
+#else
+        proceedDatagram(_remote_endpoint, _buffer, bytes_transferred);
+#endif
         read();
     } else {
         std::cerr << "[ERROR] " << err.message() << std::endl;
     }
 }
 
-void UdpMasterFace::sendImpl(const std::string &message, const boost::asio::ip::udp::endpoint &endpoint) {
-    _queue.emplace_back(message, endpoint);
-    if (_queue.size() == 1) {
+void UdpMasterFace::proceedDatagram(const boost::asio::ip::udp::endpoint &endpoint, const char *buffer, size_t size) {
+    auto it = _faces.find(endpoint);
+    if (it != _faces.end()) {
+        it->second->proceedPacket(buffer, size);
+    } else if (_faces.size() < _max_connection) {
+        std::stringstream ss;
+        ss << "new connection from udp://" << endpoint;
+        logger::log(logger::INFO, ss.str());
+        auto face = std::make_shared<UdpSubFace>(*this, endpoint);
+        face->open(_interest_callback, _data_callback, boost::bind(&UdpMasterFace::onFaceError, shared_from_this(), _1));
+        _notification_callback(shared_from_this(), face);
+        _faces.emplace(endpoint, face);
+        face->proceedPacket(buffer, size);
+    }
+}
+
+UdpMasterFace::Queue::Result UdpMasterFace::sendImpl(const Message &message, const boost::asio::ip::udp::endpoint &endpoint) {
+    bool idle = _queue.empty();
+    auto result = _queue.push(std::make_pair(message, endpoint));
+    if (idle) {
+#ifdef __linux__
+        // let the other sends of this round fill the queue, they will leave with the same system call
+        _strand.post(boost::bind(&UdpMasterFace::write, shared_from_this()));
+#else
         write();
+#endif
     }
+    return result;
 }
 
 void UdpMasterFace::write() {
+#ifdef __linux__
+    // with the io_uring backend too, the ring has no batched send and a sendmsg per datagram is slower than sendmmsg
+    while (!_queue.empty()) {
+        for (const auto &message : _queue) {
+            if (!_write_batch.push(message.first, message.second)) {
+                break;
+            }
+        }
+        int sent = _write_batch.send(_socket.native_handle());
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // the socket buffer is full, wait for it to be writable again
+                _socket.async_send(boost::asio::null_buffers(),
+                                   _strand.wrap(boost::bind(&UdpMasterFace::writeHandler, shared_from_this(), _1, _2)));
+                return;
+            }
+            // the first datagram can't be sent, drop it
+            std::cerr << strerror(errno) << std::endl;
+            sent = 1;
+        }
+        for (int i = 0; i < sent; ++i) {
+            _queue.pop();
+        }
+    }
+#else
     auto &message = _queue.front();
-    _socket.async_send_to(boost::asio::buffer(message.first), message.second,
+    _queue.setInFlight(1);
+    _socket.async_send_to(message.first.buffer(), message.second,
                           _strand.wrap(boost::bind(&UdpMasterFace::writeHandler, shared_from_this(), _1, _2)));
+#endif
 }
 
 void UdpMasterFace::writeHandler(const boost::system::error_code &err, size_t bytesTransferred) {
     if(!err) {
-        _queue.pop_front();
+#ifndef __linux__
+        _queue.pop();
+#endif
         if (!_queue.empty()) {
             write();
         }
@@ -218,4 +374,72 @@ void UdpMasterFace::onFaceError(const std::shared_ptr<Face> &face) {
     _error_callback(shared_from_this(), face);
 }
 
+void UdpMasterFace::sweep() {
+    ++_sweeps;
+    std::vector<std::shared_ptr<UdpSubFace>> idle_faces;
+    for (const auto &face : _faces) {
+        if (face.second->sweep(_sweeps)) {
+            idle_faces.push_back(face.second);
+        }
+    }
+    // closing a sub-face removes it from _faces
+    for (const auto &face : idle_faces) {
+        face->close();
+    }
+}
 
+void UdpMasterFace::sweepHandler(const boost::system::error_code &err) {
+    if (!err) {
+        sweep();
+        _sweep_timer.expires_from_now(boost::posix_time::seconds(SWEEP_INTERVAL));
+        _sweep_timer.async_wait(_strand.wrap(boost::bind(&UdpMasterFace::sweepHandler, shared_from_this(), _1)));
+    }
+}
+
+
+
+
+#ifdef HAVE_IO_URING
+void UdpMasterFace::uringReadHandler(int result, uint32_t flags) {
+    if (result == -ECANCELED && _read_paused) {
+        _read_paused = false;
+        read();
+        return;
+    }
+    if (result < 0 && result != -ENOBUFS) {
+        _read_operation = 0;
+        std::cerr << "[ERROR] " << strerror(-result) << std::endl;
+        return;
+    }
+
+    if (flags & IORING_CQE_F_BUFFER) {
+        uint16_t buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+        boost::asio::ip::udp::endpoint endpoint;
+        const char *payload;
+        size_t size;
+        // the packet is copied when decoded, the buffer can go back to the kernel right after
+        if (result > 0 && IoUring::getRecvmsgPayload(&_recv_header, _buffer_ring->getBuffer(buffer_id), (size_t)result,
+                                                     endpoint, payload, size) && size > 0) {
+            proceedDatagram(endpoint, payload, size);
+        }
+        _buffer_ring->recycle(buffer_id);
+    }
+
+    if (!(flags & IORING_CQE_F_MORE)) {
+        // the kernel ended the multishot receive (e.g. it ran out of buffers), arm a new one
+        _read_paused = false;
+        read();
+    } else if (_read_gate && !_read_gate->isOpen() && !_read_paused) {
+        // a multishot receive can't be paused, it is ended and read() waits for the gate to arm a new one
+        _read_paused = true;
+        _uring->cancel(_read_operation);
+    }
+}
+
+void UdpMasterFace::uringCancel() {
+    _read_paused = false;
+    if (_read_operation) {
+        _uring->cancel(_read_operation);
+    }
+}
+#endif
\ No newline at end of file
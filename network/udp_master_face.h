@@ -17,24 +17,43 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
-#include <map>
-#include <deque>
+#include <unordered_map>
 
 #include "master_face.h"
 #include "face.h"
+#include "io_uring.h"
+#include "udp_batch.h"
 
 class UdpSubFace;
 
 class UdpMasterFace : public MasterFace, public std::enable_shared_from_this<UdpMasterFace> {
 public:
+    // shared by the sub-faces, the datagrams leave by the same socket
+    using Queue = SendQueue<std::pair<Message, boost::asio::ip::udp::endpoint>>;
+
     static const size_t BUFFER_SIZE = 1 << 16;
+    // larger packets are sent in NDNLPv2 fragments
+    static const size_t MTU = ndn::MAX_NDN_PACKET_SIZE;
+    // seconds between two checks of the idle sub-faces, a packet only records the current check
+    static const long SWEEP_INTERVAL = 1;
+
+    struct EndpointHash {
+        size_t operator()(const boost::asio::ip::udp::endpoint &endpoint) const;
+    };
 
     class UdpSubFace : public Face, public std::enable_shared_from_this<UdpSubFace> {
+    public:
+        // in sweeps, an idle endpoint is probed, then closed if it does not answer
+        static const uint64_t IDLE_TIMEOUT = 3;
+        static const uint64_t PROBE_TIMEOUT = 2;
+
     private:
         UdpMasterFace &_master_face;
 
         boost::asio::ip::udp::endpoint _endpoint;
-        boost::asio::deadline_timer _timer;
+        // sweep of the last packet from/to the endpoint
+        uint64_t _last_activity;
+        bool _probed = false;
 
     public:
         UdpSubFace(UdpMasterFace &master_face, const boost::asio::ip::udp::endpoint &endpoint);
@@ -53,14 +72,21 @@ public:
 
         void send(const std::string &message) override;
 
+        void send(const ndn::Block &wire) override;
+
         void send(const ndn::Interest &interest) override;
 
         void send(const ndn::Data &data) override;
 
         void proceedPacket(const char* buffer, size_t size);
 
+        // true if the endpoint was idle for too long, it is first probed
+        bool sweep(uint64_t sweeps);
+
     private:
-        void timerHandler(const boost::system::error_code &err, bool last_chance);
+        void sendFragments(const ndn::Block &wire);
+
+        void sendImpl(const Message &message);
     };
 
 private:
@@ -68,13 +94,30 @@ private:
     boost::asio::ip::udp::endpoint _remote_endpoint;
     boost::asio::ip::udp::socket _socket;
     boost::asio::strand _strand;
+#ifdef __linux__
+    UdpBatch _read_batch;
+    UdpBatch _write_batch;
+#else
     char _buffer[BUFFER_SIZE];
-    std::map<boost::asio::ip::udp::endpoint, std::shared_ptr<UdpSubFace>> _faces;
-    bool _queue_in_use = false;
-    std::deque<std::pair<const std::string, const boost::asio::ip::udp::endpoint>> _queue;
+#endif
+    std::unordered_map<boost::asio::ip::udp::endpoint, std::shared_ptr<UdpSubFace>, EndpointHash> _faces;
+    Queue _queue;
+    boost::asio::deadline_timer _sweep_timer;
+    uint64_t _sweeps = 0;
+#ifdef HAVE_IO_URING
+    // nullptr when the asio backend is used
+    IoUring *_uring = nullptr;
+    std::unique_ptr<IoUring::BufferRing> _buffer_ring;
+    msghdr _recv_header;
+    uint64_t _read_operation = 0;
+    // the multishot receive was cancelled to stop reading, it is armed again once the read gate opens
+    bool _read_paused = false;
+#endif
 
 public:
-    UdpMasterFace(boost::asio::io_service &ios, size_t max_connection, uint16_t port);
+    // with reuse_port several master faces (one per worker) can listen on the same port, the kernel spreads the
+    // endpoints over them, cpu (if not -1) asks the kernel to deliver to this socket the datagrams handled by this cpu
+    UdpMasterFace(boost::asio::io_service &ios, size_t max_connection, uint16_t port, bool reuse_port = false, int cpu = -1);
 
     ~UdpMasterFace() override = default;
 
@@ -87,6 +130,8 @@ public:
 
     void sendToAllFaces(const std::string &message) override;
 
+    void sendToAllFaces(const ndn::Block &wire) override;
+
     void sendToAllFaces(const ndn::Interest &interest) override;
 
     void sendToAllFaces(const ndn::Data &data) override;
@@ -96,11 +141,23 @@ private:
 
     void readHandler(const boost::system::error_code &err, size_t bytes_transferred);
 
-    void sendImpl(const std::string &message, const boost::asio::ip::udp::endpoint &endpoint);
+    void proceedDatagram(const boost::asio::ip::udp::endpoint &endpoint, const char *buffer, size_t size);
+
+    Queue::Result sendImpl(const Message &message, const boost::asio::ip::udp::endpoint &endpoint);
 
     void write();
 
     void writeHandler(const boost::system::error_code &err, size_t bytesTransferred);
 
     void onFaceError(const std::shared_ptr<Face> &face);
+
+    void sweep();
+
+    void sweepHandler(const boost::system::error_code &err);
+
+#ifdef HAVE_IO_URING
+    void uringReadHandler(int result, uint32_t flags);
+
+    void uringCancel();
+#endif
 };
\ No newline at end of file
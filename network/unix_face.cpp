@@ -0,0 +1,31 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "unix_face.h"
+
+UnixFace::UnixFace(boost::asio::io_service &ios, const std::string &path)
+        : StreamFace(ios, boost::asio::local::stream_protocol::endpoint(path)) {
+}
+
+UnixFace::UnixFace(boost::asio::local::stream_protocol::socket &&socket)
+        : StreamFace(std::move(socket)) {
+
+}
+
+std::string UnixFace::getUnderlyingProtocol() const {
+    return "UNIX";
+}
\ No newline at end of file
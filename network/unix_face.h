@@ -0,0 +1,39 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "stream_face.h"
+
+#include <boost/asio.hpp>
+
+#include <string>
+
+
+// face over a Unix stream socket, e.g. to a NFD running on the same host
+class UnixFace : public StreamFace<boost::asio::local::stream_protocol> {
+public:
+    // use this when creating a face yourself
+    UnixFace(boost::asio::io_service &ios, const std::string &path);
+
+    // specific constructor for MasterFace, not recommended to use it yourself
+    explicit UnixFace(boost::asio::local::stream_protocol::socket &&socket);
+
+    ~UnixFace() override = default;
+
+    std::string getUnderlyingProtocol() const override;
+};
@@ -0,0 +1,82 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "unix_master_face.h"
+
+#include <boost/system/system_error.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+UnixMasterFace::UnixMasterFace(IoServicePool &pool, size_t max_connection, const std::string &path)
+        : StreamMasterFace(pool, max_connection, boost::asio::local::stream_protocol::endpoint(unlinkPath(path)))
+        , _path(path) {
+
+}
+
+UnixMasterFace::~UnixMasterFace() {
+    ::unlink(_path.c_str());
+}
+
+std::string UnixMasterFace::getUnderlyingProtocol() const {
+    return "UNIX";
+}
+
+static void throwError(int error, const std::string &what) {
+    throw boost::system::system_error(error, boost::system::system_category(), what);
+}
+
+const std::string& UnixMasterFace::unlinkPath(const std::string &path) {
+    struct stat st;
+    if (::lstat(path.c_str(), &st) < 0) {
+        // nothing to remove, the bind reports any other problem
+        return path;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        throwError(EEXIST, path + " exists and is not a socket");
+    }
+
+    // a socket file left by a previous run would make the bind fail, but it is only stale if nobody listens on it
+    sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throwError(ENAMETOOLONG, path);
+    }
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throwError(errno, "socket");
+    }
+    int error = ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ? errno : 0;
+    ::close(fd);
+
+    if (error == 0) {
+        throwError(EADDRINUSE, "another process is listening on " + path);
+    }
+    if (error != ECONNREFUSED) {
+        throwError(error, "cannot check whether " + path + " is stale");
+    }
+    ::unlink(path.c_str());
+    return path;
+}
\ No newline at end of file
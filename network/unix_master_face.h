@@ -0,0 +1,37 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "stream_master_face.h"
+#include "unix_face.h"
+
+// local consumers connect through a Unix socket file, which is only replaced if it is a stale socket
+class UnixMasterFace : public StreamMasterFace<boost::asio::local::stream_protocol, UnixFace> {
+private:
+    std::string _path;
+
+public:
+    UnixMasterFace(IoServicePool &pool, size_t max_connection, const std::string &path);
+
+    ~UnixMasterFace() override;
+
+    std::string getUnderlyingProtocol() const override;
+
+private:
+    static const std::string& unlinkPath(const std::string &path);
+};
\ No newline at end of file
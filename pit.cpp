@@ -17,9 +17,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "pit.h"
 
+#include <cstring>
+
 const ndn::time::milliseconds Pit::MINIMAL_INTEREST_LIFETIME {5};
 
-Pit::Pit(size_t size) : _max_size(size) {
+Pit::Pit(size_t size, size_t rtt_depth) : _max_size(size), _rtt(rtt_depth) {
 
 }
 
@@ -31,40 +33,141 @@ void Pit::setSize(size_t size) {
     _max_size = size;
 }
 
-bool Pit::insert(const ndn::Interest &interest, const std::shared_ptr<Face> &face) {
+Pit::InsertResult Pit::insert(const InterestView &interest, const std::string &uri, const std::shared_ptr<Face> &face) {
     if (interest.getInterestLifetime() < MINIMAL_INTEREST_LIFETIME) {
-        return false;
+        return IGNORED;
     }
 
-    if (auto entry = _tree.find(interest.getName())) {
-        _list.splice(_list.begin(), _list, _list_index.at(interest.getName().toUri()));
-        return entry->addFace(interest, face);
+    const uint8_t *key = interest.getNameValue();
+    size_t size = interest.getNameValueSize();
+    uint64_t key_hash = hash(HASH_SEED, key, size);
+    // each part holds its share of the entries
+    size_t max_size = (_max_size + SHARDS - 1) / SHARDS;
+    Shard &shard = getShard(key_hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto record = find(shard, key_hash, key, size);
+    if (record != shard.list.end()) {
+        shard.list.splice(shard.list.begin(), shard.list, record);
+        return record->entry->addFace(interest, face, getSuppressionTime(record->prefix)) ? FORWARD : AGGREGATED;
     } else {
-        _tree.insert(interest.getName(), std::make_shared<PitEntry>(interest, face));
-        _list_index[interest.getName().toUri()] = _list.emplace(_list.begin(), interest.getName());
-        if (_list.size() > _max_size) {
-            _tree.remove(*_list.rbegin());
-            _list_index.erase(_list.rbegin()->toUri());
-            _list.erase(--_list.end());
+        if (!shard.list.empty() && shard.list.size() >= max_size) {
+            // the least recently used entry is only given up once it is no longer useful, the Data of a pending
+            // Interest would be lost, the new Interest is refused instead
+            const auto &oldest = shard.list.back().entry;
+            if (oldest->isValid() && oldest->isPending()) {
+                return FULL;
+            }
+            erase(shard, std::prev(shard.list.end()));
         }
-        //std::cout << _tree.getPopulatedNodes() << "/" << _max_size << " (" << _tree.size() << " total nodes)" << std::endl;
-        return true;
+        // the name and the RTT prefix are only computed for a new entry
+        auto entry = std::make_shared<PitEntry>(interest, face);
+        shard.list.push_front({key_hash, std::string((const char *)key, size), interest.getName(), _rtt.getPrefix(uri), entry});
+        shard.index.emplace(key_hash, shard.list.begin());
+        shard.names.emplace(shard.list.front().name, entry);
+        return FORWARD;
     }
 }
 
-std::set<std::shared_ptr<Face>> Pit::get(const ndn::Data &data) {
-    std::set<std::shared_ptr<Face>> faces;
-    auto list = _tree.findAllUntil(data.getName());
-    for (auto it = list.rbegin(); it != list.rend(); ++it) {
-        auto&& entry_faces = it->second->getAndResetFaces();
+bool Pit::isPending(const InterestView &interest) const {
+    const uint8_t *key = interest.getNameValue();
+    size_t size = interest.getNameValueSize();
+    uint64_t key_hash = hash(HASH_SEED, key, size);
+    Shard &shard = getShard(key_hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto record = find(shard, key_hash, key, size);
+    return record != shard.list.end() && record->entry->isValid() && record->entry->isPending();
+}
+
+std::map<std::shared_ptr<Face>, std::string> Pit::get(const ndn::Data &data) {
+    std::map<std::shared_ptr<Face>, std::string> faces;
+    const ndn::Name &name = data.getName();
+    // the components of each prefix are the beginning of those of the name
+    const ndn::Block &wire = name.wireEncode();
+    const uint8_t *key = wire.value();
+    size_t size = 0;
+    // the entries of the prefixes of the name are in the parts given by the hashes of the prefixes
+    std::vector<std::pair<std::string, ndn::time::nanoseconds>> samples;
+    uint64_t prefix_hash = HASH_SEED;
+    for (const auto &component : name) {
+        prefix_hash = hash(prefix_hash, key + size, component.size());
+        size += component.size();
+        Shard &shard = getShard(prefix_hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto record = find(shard, prefix_hash, key, size);
+        if (record == shard.list.end()) {
+            continue;
+        }
+        ndn::time::nanoseconds rtt;
+        if (record->entry->getRtt(rtt)) {
+            samples.emplace_back(record->prefix, rtt);
+        }
+        auto&& entry_faces = record->entry->getAndResetFaces();
         faces.insert(std::make_move_iterator(entry_faces.begin()), std::make_move_iterator(entry_faces.end()));
-        //_tree.remove(it->first);
+    }
+    if (!samples.empty()) {
+        boost::unique_lock<boost::shared_mutex> lock(_rtt_mutex);
+        for (const auto &sample : samples) {
+            _rtt.addSample(sample.first, sample.second);
+        }
     }
     return faces;
 }
 
-std::string Pit::toJSON() const {
-    std::stringstream ss;
-    ss << R"({"type": "pit", "tree":)" << _tree.toJSON() << "}";
-    return ss.str();
+std::map<std::shared_ptr<Face>, std::string> Pit::remove(const InterestView &interest) {
+    const uint8_t *key = interest.getNameValue();
+    size_t size = interest.getNameValueSize();
+    uint64_t key_hash = hash(HASH_SEED, key, size);
+    Shard &shard = getShard(key_hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto record = find(shard, key_hash, key, size);
+    if (record == shard.list.end()) {
+        return {};
+    }
+    auto faces = record->entry->getAndResetFaces();
+    erase(shard, record);
+    return faces;
+}
+
+void Pit::writeRttSummary(RttEstimator::Writer &writer) const {
+    boost::shared_lock<boost::shared_mutex> lock(_rtt_mutex);
+    _rtt.writeSummary(writer);
+}
+
+uint64_t Pit::hash(uint64_t hash, const uint8_t *begin, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ begin[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+Pit::Shard& Pit::getShard(uint64_t hash) const {
+    return _shards[hash % SHARDS];
+}
+
+std::list<Pit::Record>::iterator Pit::find(Shard &shard, uint64_t hash, const uint8_t *key, size_t size) {
+    auto range = shard.index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const std::string &record_key = it->second->key;
+        if (record_key.size() == size && std::memcmp(record_key.data(), key, size) == 0) {
+            return it->second;
+        }
+    }
+    return shard.list.end();
+}
+
+void Pit::erase(Shard &shard, std::list<Record>::iterator record) {
+    auto range = shard.index.equal_range(record->hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == record) {
+            shard.index.erase(it);
+            break;
+        }
+    }
+    shard.names.erase(record->name);
+    shard.list.erase(record);
+}
+
+ndn::time::nanoseconds Pit::getSuppressionTime(const std::string &prefix) const {
+    boost::shared_lock<boost::shared_mutex> lock(_rtt_mutex);
+    return _rtt.getSuppressionTime(prefix);
 }
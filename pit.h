@@ -20,27 +20,78 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <ndn-cxx/interest.hpp>
 #include <ndn-cxx/data.hpp>
 
+#include <boost/thread/shared_mutex.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <list>
 #include <unordered_map>
-#include <set>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
-#include "tree/named_tree.h"
+#include "tlv/interest_view.h"
 #include "pit_entry.h"
+#include "rtt_estimator.h"
 #include "network/face.h"
 
 class Pit {
+public:
+    // outcome of an insertion, only FORWARD asks for the Interest to be sent upstream
+    enum InsertResult {
+        FORWARD,
+        AGGREGATED,
+        IGNORED,
+        FULL,
+    };
+
+    // independent parts of the PIT, each with its own lock, a name goes to the one given by the hash of its components
+    // so that the workers only contend for the same names
+    static const size_t SHARDS = 16;
+    // names taken from each part for one page of a dump
+    static const size_t MAX_DUMP_ENTRIES = 256;
+
 private:
     static const ndn::time::milliseconds MINIMAL_INTEREST_LIFETIME;
 
-    size_t _max_size;
-
-    NamedTree<PitEntry> _tree;
-    std::list<ndn::Name> _list;
-    std::unordered_map<std::string, std::list<ndn::Name>::iterator> _list_index;
+    struct Record {
+        // of the components on the wire, indexes the record in its part
+        uint64_t hash;
+        // the components as they are on the wire, compared on a hash collision
+        std::string key;
+        // only decoded when the entry is created, for the dumps
+        ndn::Name name;
+        // the measured prefix of the name in the RTT estimator
+        std::string prefix;
+        std::shared_ptr<PitEntry> entry;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // least recently used last
+        std::list<Record> list;
+        std::unordered_multimap<uint64_t, std::list<Record>::iterator> index;
+        // in name order for the dumps
+        std::map<ndn::Name, std::shared_ptr<PitEntry>> names;
+    };
+
+    // shared by the parts
+    std::atomic<size_t> _max_size;
+
+    mutable std::array<Shard, SHARDS> _shards;
+
+    // measured on the Data satisfying the entries, sets how long retransmissions are suppressed
+    // read on every aggregated Interest, written on the Data out of the locks of the parts
+    mutable boost::shared_mutex _rtt_mutex;
+    RttEstimator _rtt;
 
 public:
-    explicit Pit(size_t size);
+    // RTTs are measured on the first rtt_depth components of the names
+    Pit(size_t size, size_t rtt_depth);
 
     ~Pit() = default;
 
@@ -48,9 +99,80 @@ public:
 
     void setSize(size_t size);
 
-    bool insert(const ndn::Interest &interest, const std::shared_ptr<Face> &face);
+    // uri is the one of the Interest name, computed by the caller, only used when a new entry is created
+    InsertResult insert(const InterestView &interest, const std::string &uri, const std::shared_ptr<Face> &face);
+
+    // true while faces wait for the Data of this Interest
+    bool isPending(const InterestView &interest) const;
+
+    // faces waiting for the Data with their PitToken
+    std::map<std::shared_ptr<Face>, std::string> get(const ndn::Data &data);
+
+    // the entry of an Interest that can't be forwarded, the faces waiting for it with their PitToken
+    std::map<std::shared_ptr<Face>, std::string> remove(const InterestView &interest);
+
+    // the entries under prefix after the cursor, in name order, until f(name, entry) refuses one, true if some are left
+    // the names are first taken from every part, then each entry is written under the lock of its part only, a large
+    // PIT is dumped without blocking the workers
+    template <class F>
+    bool dump(const ndn::Name &prefix, const ndn::Name &after, F f) const {
+        std::vector<ndn::Name> names;
+        // the names beyond the last one taken from a part that has more are not known yet
+        bool cut = false;
+        ndn::Name cutoff;
+        for (auto &shard : _shards) {
+            size_t taken = 0;
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = after.empty() || after < prefix ? shard.names.lower_bound(prefix) : shard.names.upper_bound(after);
+            for (; it != shard.names.end() && prefix.isPrefixOf(it->first) && taken < MAX_DUMP_ENTRIES; ++it) {
+                names.push_back(it->first);
+                ++taken;
+            }
+            bool left = it != shard.names.end() && prefix.isPrefixOf(it->first);
+            if (left && (!cut || names.back() < cutoff)) {
+                cut = true;
+                cutoff = names.back();
+            }
+        }
+        std::sort(names.begin(), names.end());
+        for (const auto &name : names) {
+            if (cut && cutoff < name) {
+                return true;
+            }
+            const ndn::Block &wire = name.wireEncode();
+            Shard &shard = getShard(hash(HASH_SEED, wire.value(), wire.value_size()));
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            // an entry removed meanwhile is skipped
+            auto it = shard.names.find(name);
+            if (it != shard.names.end() && !f(name, *it->second)) {
+                return true;
+            }
+        }
+        return cut;
+    }
+
+    void writeRttSummary(RttEstimator::Writer &writer) const;
+
+    // the RTTs of the prefixes after the cursor until f(prefix, write_entry) refuses one, true if some are left
+    template <class F>
+    bool dumpRtt(const std::string &after, F f) const {
+        boost::shared_lock<boost::shared_mutex> lock(_rtt_mutex);
+        return _rtt.forEachFrom(after, f);
+    }
+
+private:
+    static const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+    // FNV-1a of the wire of the components, extended one component at a time so that the prefixes of a name are
+    // hashed along with it
+    static uint64_t hash(uint64_t hash, const uint8_t *begin, size_t size);
+
+    Shard& getShard(uint64_t hash) const;
+
+    // the record of the name whose components are key on the wire, shard.list.end() if none
+    static std::list<Record>::iterator find(Shard &shard, uint64_t hash, const uint8_t *key, size_t size);
 
-    std::set<std::shared_ptr<Face>> get(const ndn::Data &data);
+    static void erase(Shard &shard, std::list<Record>::iterator record);
 
-    std::string toJSON() const;
-};
\ No newline at end of file
+    ndn::time::nanoseconds getSuppressionTime(const std::string &prefix) const;
+};
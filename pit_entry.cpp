@@ -17,58 +17,72 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "pit_entry.h"
 
-const ndn::time::milliseconds PitEntry::RETRANSMISSION_TIME {250};
-
-PitEntry::PitEntry(const ndn::Interest &interest, const std::shared_ptr<Face> &face)
+PitEntry::PitEntry(const InterestView &interest, const std::shared_ptr<Face> &face)
         : _keep_until(ndn::time::steady_clock::now() + interest.getInterestLifetime())
-        , _last_update(ndn::time::steady_clock::now()) {
-    _faces.emplace(face);
+        , _last_update(ndn::time::steady_clock::now())
+        , _forwarded_at(_last_update) {
+    _faces.emplace(face, interest.getPitToken());
     //_nonces.emplace(interest.getNonce());
 }
 
-const std::set<std::shared_ptr<Face>> PitEntry::getAndResetFaces() {
-    std::set<std::shared_ptr<Face>> faces;
+const std::map<std::shared_ptr<Face>, std::string> PitEntry::getAndResetFaces() {
+    std::map<std::shared_ptr<Face>, std::string> faces;
     for (auto& face : _faces) {
-        if (auto f = face.lock()) {
-            faces.emplace(f);
+        if (auto f = face.first.lock()) {
+            faces.emplace(f, face.second);
         }
     }
     _faces.clear();
     return faces;
 }
 
-bool PitEntry::addFace(const ndn::Interest &interest, const std::shared_ptr<Face> &face) {
-    _faces.emplace(face);
+bool PitEntry::addFace(const InterestView &interest, const std::shared_ptr<Face> &face,
+                       const ndn::time::nanoseconds &suppression_time) {
+    bool pending = isPending();
+    _faces[face] = interest.getPitToken();
     //_nonces.emplace(interest.getNonce());
     auto time_point = ndn::time::steady_clock::now();
     _keep_until = time_point + interest.getInterestLifetime();
-    bool need_retransmission = _last_update + RETRANSMISSION_TIME < time_point;
+    // the Data of a satisfied entry went back to its faces, nothing upstream will answer the new one
+    bool need_retransmission = !pending || _last_update + suppression_time < time_point;
     _last_update = time_point;
+    if (need_retransmission) {
+        // a new measurement once the previous Data was received
+        _retransmitted = pending;
+        _forwarded_at = time_point;
+    }
     return need_retransmission;
 }
 
+bool PitEntry::getRtt(ndn::time::nanoseconds &rtt) const {
+    if (!isPending() || _retransmitted) {
+        return false;
+    }
+    rtt = ndn::time::steady_clock::now() - _forwarded_at;
+    return true;
+}
+
 bool PitEntry::isValid() const {
     return _keep_until > ndn::time::steady_clock::now();
 }
 
-std::string PitEntry::toJSON() {
-    std::stringstream ss;
-    ss << R"({"faces": [)";
-    bool first_face = true;
+bool PitEntry::isPending() const {
+    return !_faces.empty();
+}
+
+void PitEntry::writeJSON(rapidjson::Writer<rapidjson::StringBuffer> &writer) {
+    writer.Key("faces");
+    writer.StartArray();
     auto it = _faces.cbegin();
     while (it != _faces.cend()) {
-        if (auto face = it->lock()) {
-            if (first_face) {
-                first_face = false;
-            } else {
-                ss << ", ";
-            }
-            ss << face->getFaceId();
+        if (auto face = it->first.lock()) {
+            writer.Uint64(face->getFaceId());
             ++it;
         } else {
             it = _faces.erase(it);
         }
     }
-    ss << R"(], "valid_for":)" << ndn::time::duration_cast<ndn::time::milliseconds>(_keep_until - ndn::time::steady_clock::now()).count() << "}";
-    return ss.str();
-}
\ No newline at end of file
+    writer.EndArray();
+    writer.Key("valid_for");
+    writer.Int64(ndn::time::duration_cast<ndn::time::milliseconds>(_keep_until - ndn::time::steady_clock::now()).count());
+}
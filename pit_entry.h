@@ -19,30 +19,46 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ndn-cxx/interest.hpp>
 
+#include <map>
 #include <memory>
-#include <set>
+#include <string>
 
 #include "network/face.h"
+#include "rapidjson/include/rapidjson/stringbuffer.h"
+#include "rapidjson/include/rapidjson/writer.h"
+#include "tlv/interest_view.h"
 
 class PitEntry {
 private:
-    static const ndn::time::milliseconds RETRANSMISSION_TIME;
-
-    std::set<std::weak_ptr<Face>, std::owner_less<std::weak_ptr<Face>>> _faces;
+    // faces waiting for the Data with the PitToken of their last Interest (empty if none)
+    std::map<std::weak_ptr<Face>, std::string, std::owner_less<std::weak_ptr<Face>>> _faces;
     //std::set<uint32_t > _nonces;
     ndn::time::steady_clock::time_point _keep_until;
     ndn::time::steady_clock::time_point _last_update;
+    ndn::time::steady_clock::time_point _forwarded_at;
+    // the Data can't tell which forwarding it answers (Karn's algorithm), its RTT is not measured
+    bool _retransmitted = false;
 
 public:
-    PitEntry(const ndn::Interest &interest, const std::shared_ptr<Face> &face);
+    PitEntry(const InterestView &interest, const std::shared_ptr<Face> &face);
 
     ~PitEntry() = default;
 
-    const std::set<std::shared_ptr<Face>> getAndResetFaces();
+    const std::map<std::shared_ptr<Face>, std::string> getAndResetFaces();
+
+    // true if the Interest has to be forwarded again, the entry being satisfied or its previous Interest older than
+    // suppression_time
+    bool addFace(const InterestView &interest, const std::shared_ptr<Face> &face,
+                 const ndn::time::nanoseconds &suppression_time);
 
-    bool addFace(const ndn::Interest &interest, const std::shared_ptr<Face> &face);
+    // false if not pending or forwarded more than once, must be called before getAndResetFaces()
+    bool getRtt(ndn::time::nanoseconds &rtt) const;
 
     bool isValid() const;
 
-    std::string toJSON();
+    // false once the Data was received
+    bool isPending() const;
+
+    // "faces" and "valid_for" in the object being written
+    void writeJSON(rapidjson::Writer<rapidjson::StringBuffer> &writer);
 };
\ No newline at end of file
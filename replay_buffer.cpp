@@ -0,0 +1,41 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replay_buffer.h"
+
+void ReplayBuffer::push(const ndn::Block &wire, const ndn::time::milliseconds &lifetime) {
+    auto now = ndn::time::steady_clock::now();
+    std::lock_guard<std::mutex> lock(_mutex);
+    // lifetimes differ, an expired Interest may stay behind a longer one until take() skips it
+    while (!_entries.empty() && (_entries.front().expiry <= now || _entries.size() >= MAX_INTERESTS)) {
+        _entries.pop_front();
+    }
+    _entries.push_back({wire, now + lifetime});
+}
+
+std::vector<ndn::Block> ReplayBuffer::take() {
+    std::vector<ndn::Block> wires;
+    auto now = ndn::time::steady_clock::now();
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &entry : _entries) {
+        if (entry.expiry > now) {
+            wires.push_back(entry.wire);
+        }
+    }
+    _entries.clear();
+    return wires;
+}
@@ -0,0 +1,52 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// the Interests forwarded to an upstream until their lifetime expires, those still pending in the PIT are sent again
+// when the upstream face reconnects, the PIT would otherwise suppress the retransmissions of the consumers
+class ReplayBuffer {
+public:
+    // the oldest Interests are forgotten past this size
+    static const size_t MAX_INTERESTS = 1 << 16;
+
+private:
+    struct Entry {
+        ndn::Block wire;
+        ndn::time::steady_clock::time_point expiry;
+    };
+
+    std::mutex _mutex;
+    std::deque<Entry> _entries;
+
+public:
+    ReplayBuffer() = default;
+
+    ~ReplayBuffer() = default;
+
+    void push(const ndn::Block &wire, const ndn::time::milliseconds &lifetime);
+
+    // the Interests not expired yet, oldest first, the buffer is emptied
+    std::vector<ndn::Block> take();
+};
@@ -0,0 +1,354 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replication.h"
+
+#include <boost/bind.hpp>
+
+#include <cstring>
+#include <sstream>
+
+#include "rapidjson/include/rapidjson/document.h"
+#include "log/logger.h"
+
+static const char *TYPE_NAMES[] = {"mode", "append-accept", "append-drop", "delete-accept", "delete-drop"};
+
+const char* RuleChange::toString(Type type) {
+    return TYPE_NAMES[type];
+}
+
+bool RuleChange::fromString(const char *name, size_t length, Type &type) {
+    for (size_t i = 0; i < sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]); ++i) {
+        if (strlen(TYPE_NAMES[i]) == length && strncmp(TYPE_NAMES[i], name, length) == 0) {
+            type = (Type)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void replication::appendString(std::string &json, const std::string &value) {
+    static const char *HEX = "0123456789abcdef";
+    json.push_back('"');
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            json.push_back('\\');
+            json.push_back(c);
+        } else if ((unsigned char)c < 0x20) {
+            json += "\\u00";
+            json.push_back(HEX[(c >> 4) & 0xf]);
+            json.push_back(HEX[c & 0xf]);
+        } else {
+            json.push_back(c);
+        }
+    }
+    json.push_back('"');
+}
+
+std::string replication::encode(uint64_t generation, bool reset, const std::vector<RuleChange> &changes) {
+    std::string json = R"({"generation":)" + std::to_string(generation) + R"(, "reset":)" +
+                       (reset ? "true" : "false") + R"(, "changes":[)";
+    for (size_t i = 0; i < changes.size(); ++i) {
+        json += i == 0 ? "[" : ", [";
+        appendString(json, RuleChange::toString(changes[i].type));
+        json += ", ";
+        appendString(json, changes[i].value);
+        json.push_back(']');
+    }
+    json += "]}\n";
+    return json;
+}
+
+bool replication::decode(const std::string &line, uint64_t &generation, bool &reset,
+                         std::vector<RuleChange> &changes) {
+    rapidjson::Document document;
+    document.Parse(line.c_str(), line.size());
+    if (document.HasParseError() || !document.IsObject() || !document.HasMember("generation") ||
+        !document["generation"].IsUint64() || !document.HasMember("reset") || !document["reset"].IsBool() ||
+        !document.HasMember("changes") || !document["changes"].IsArray()) {
+        return false;
+    }
+    generation = document["generation"].GetUint64();
+    reset = document["reset"].GetBool();
+    changes.clear();
+    for (const auto &value : document["changes"].GetArray()) {
+        if (!value.IsArray() || value.Size() != 2) {
+            return false;
+        }
+        // [type, value]
+        auto pair = value.GetArray().begin();
+        if (!pair[0].IsString() || !pair[1].IsString()) {
+            return false;
+        }
+        RuleChange::Type type;
+        if (!RuleChange::fromString(pair[0].GetString(), pair[0].GetStringLength(), type)) {
+            return false;
+        }
+        changes.push_back({type, pair[1].GetString()});
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+ReplicationServer::Peer::Peer(ReplicationServer &server, boost::asio::ip::tcp::socket &&socket)
+        : _server(server)
+        , _socket(std::move(socket)) {
+    boost::system::error_code err;
+    std::stringstream ss;
+    ss << _socket.remote_endpoint(err);
+    _endpoint = ss.str();
+}
+
+const std::string& ReplicationServer::Peer::getEndpoint() const {
+    return _endpoint;
+}
+
+void ReplicationServer::Peer::open(const std::shared_ptr<const std::string> &snapshot) {
+    read();
+    send(snapshot);
+}
+
+void ReplicationServer::Peer::send(const std::shared_ptr<const std::string> &message) {
+    if (_closed) {
+        return;
+    }
+    if (_queue.size() >= MAX_PENDING_MESSAGES) {
+        std::stringstream ss;
+        ss << "replica tcp://" << _endpoint << " can't keep up, it is disconnected";
+        logger::log(logger::WARNING, ss.str());
+        close();
+        return;
+    }
+    bool idle = _queue.empty();
+    _queue.push_back(message);
+    if (idle) {
+        write();
+    }
+}
+
+void ReplicationServer::Peer::close() {
+    if (_closed) {
+        return;
+    }
+    _closed = true;
+    boost::system::error_code err;
+    _socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, err);
+    _socket.close(err);
+    _queue.clear();
+    _server.onPeerClosed(shared_from_this());
+}
+
+void ReplicationServer::Peer::read() {
+    _socket.async_read_some(boost::asio::buffer(_buffer, sizeof(_buffer)),
+                            boost::bind(&Peer::readHandler, shared_from_this(), _1));
+}
+
+void ReplicationServer::Peer::readHandler(const boost::system::error_code &err) {
+    if (!err) {
+        read();
+    } else if (!_closed) {
+        std::stringstream ss;
+        ss << "replica tcp://" << _endpoint << " left";
+        logger::log(logger::INFO, ss.str());
+        close();
+    }
+}
+
+void ReplicationServer::Peer::write() {
+    boost::asio::async_write(_socket, boost::asio::buffer(*_queue.front()),
+                             boost::bind(&Peer::writeHandler, shared_from_this(), _1));
+}
+
+void ReplicationServer::Peer::writeHandler(const boost::system::error_code &err) {
+    if (_closed) {
+        return;
+    }
+    if (!err) {
+        _queue.pop_front();
+        if (!_queue.empty()) {
+            write();
+        }
+    } else {
+        std::cerr << err.message() << std::endl;
+        close();
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+ReplicationServer::ReplicationServer(boost::asio::io_service &ios, const std::string &address, uint16_t port)
+        : _ios(ios)
+        , _acceptor(ios, boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(address), port))
+        , _socket(ios) {
+
+}
+
+void ReplicationServer::open(const SnapshotCallback &snapshot_callback) {
+    _snapshot_callback = snapshot_callback;
+    _acceptor.listen(16);
+    std::stringstream ss;
+    ss << "replicating the rules on tcp://" << _acceptor.local_endpoint();
+    logger::log(logger::INFO, ss.str());
+    accept();
+}
+
+void ReplicationServer::publish(const std::vector<RuleChange> &changes) {
+    ++_generation;
+    auto message = std::make_shared<const std::string>(replication::encode(_generation, false, changes));
+    // a closed peer leaves the set
+    auto peers = _peers;
+    for (const auto &peer : peers) {
+        peer->send(message);
+    }
+}
+
+uint64_t ReplicationServer::getGeneration() const {
+    return _generation;
+}
+
+size_t ReplicationServer::getPeers() const {
+    return _peers.size();
+}
+
+void ReplicationServer::accept() {
+    _acceptor.async_accept(_socket, boost::bind(&ReplicationServer::acceptHandler, this, _1));
+}
+
+void ReplicationServer::acceptHandler(const boost::system::error_code &err) {
+    if (!err) {
+        auto peer = std::make_shared<Peer>(*this, std::move(_socket));
+        _socket = boost::asio::ip::tcp::socket(_ios);
+        std::stringstream ss;
+        ss << "new replica from tcp://" << peer->getEndpoint() << ", sending the rules of generation " << _generation;
+        logger::log(logger::INFO, ss.str());
+        _peers.insert(peer);
+        // the handlers of the online commands run on the same io_service, the rules can't change meanwhile
+        peer->open(std::make_shared<const std::string>(replication::encode(_generation, true, _snapshot_callback())));
+        accept();
+    } else if (err != boost::asio::error::operation_aborted) {
+        std::cerr << err.message() << std::endl;
+        accept();
+    }
+}
+
+void ReplicationServer::onPeerClosed(const std::shared_ptr<Peer> &peer) {
+    _peers.erase(peer);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const boost::posix_time::seconds ReplicationClient::RECONNECT_INTERVAL = boost::posix_time::seconds(1);
+
+ReplicationClient::ReplicationClient(boost::asio::io_service &ios, const std::string &address, uint16_t port)
+        : _ios(ios)
+        , _endpoint(boost::asio::ip::address::from_string(address), port)
+        , _socket(ios)
+        , _timer(ios) {
+
+}
+
+void ReplicationClient::open(const ChangeCallback &change_callback) {
+    _change_callback = change_callback;
+    connect();
+}
+
+std::string ReplicationClient::getSource() const {
+    std::stringstream ss;
+    ss << "tcp://" << _endpoint;
+    return ss.str();
+}
+
+bool ReplicationClient::isConnected() const {
+    return _connected;
+}
+
+uint64_t ReplicationClient::getGeneration() const {
+    return _generation;
+}
+
+void ReplicationClient::connect() {
+    _socket.async_connect(_endpoint, boost::bind(&ReplicationClient::connectHandler, this, _1));
+}
+
+void ReplicationClient::connectHandler(const boost::system::error_code &err) {
+    if (!err) {
+        _connected = true;
+        _synchronized = false;
+        std::stringstream ss;
+        ss << "following the rules of " << getSource();
+        logger::log(logger::INFO, ss.str());
+        read();
+    } else {
+        reconnect();
+    }
+}
+
+void ReplicationClient::read() {
+    boost::asio::async_read_until(_socket, _buffer, '\n',
+                                  boost::bind(&ReplicationClient::readHandler, this, _1, _2));
+}
+
+void ReplicationClient::readHandler(const boost::system::error_code &err, size_t bytes_transferred) {
+    if (err) {
+        std::stringstream ss;
+        ss << "lost the rules of " << getSource() << " (" << err.message() << ")";
+        logger::log(logger::WARNING, ss.str());
+        reconnect();
+        return;
+    }
+    std::string line(boost::asio::buffers_begin(_buffer.data()),
+                     boost::asio::buffers_begin(_buffer.data()) + bytes_transferred);
+    _buffer.consume(bytes_transferred);
+    uint64_t generation;
+    bool reset;
+    std::vector<RuleChange> changes;
+    if (!replication::decode(line, generation, reset, changes)) {
+        std::stringstream ss;
+        ss << "invalid message from " << getSource() << ", the rules are asked again";
+        logger::log(logger::WARNING, ss.str());
+        reconnect();
+        return;
+    }
+    if (!reset && (!_synchronized || generation != _generation + 1)) {
+        std::stringstream ss;
+        ss << "generation " << generation << " from " << getSource() << " after " << _generation
+           << ", the rules are asked again";
+        logger::log(logger::WARNING, ss.str());
+        reconnect();
+        return;
+    }
+    _generation = generation;
+    _synchronized = true;
+    _change_callback(generation, reset, changes);
+    read();
+}
+
+void ReplicationClient::reconnect() {
+    _connected = false;
+    boost::system::error_code err;
+    _socket.close(err);
+    _buffer.consume(_buffer.size());
+    _timer.expires_from_now(RECONNECT_INTERVAL);
+    _timer.async_wait(boost::bind(&ReplicationClient::timerHandler, this, _1));
+}
+
+void ReplicationClient::timerHandler(const boost::system::error_code &err) {
+    if (!err) {
+        connect();
+    }
+}
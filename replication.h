@@ -0,0 +1,178 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// a change of the rules, as applied by the instance receiving the online commands
+struct RuleChange {
+    enum Type {
+        MODE,
+        APPEND_ACCEPT,
+        APPEND_DROP,
+        DELETE_ACCEPT,
+        DELETE_DROP
+    };
+
+    Type type;
+    // the mode or the name prefix
+    std::string value;
+
+    // as in the 'post' method of the online command (e.g., append-accept)
+    static const char* toString(Type type);
+
+    static bool fromString(const char *name, size_t length, Type &type);
+};
+
+// the rules of an instance are streamed to its replicas over TCP, one JSON document per line
+// {"generation":N, "reset":false, "changes":[["append-accept","/a"], ["mode","drop"], ...]}
+// the generation is incremented by each online command changing the rules, a replica joining (or coming back) first
+// receives all the rules with "reset":true and the current generation
+namespace replication {
+    std::string encode(uint64_t generation, bool reset, const std::vector<RuleChange> &changes);
+
+    // false if the line is not a replication message
+    bool decode(const std::string &line, uint64_t &generation, bool &reset, std::vector<RuleChange> &changes);
+
+    // value as a JSON string, quotes included
+    void appendString(std::string &json, const std::string &value);
+};
+
+// the replicas connected to the instance receiving the online commands
+class ReplicationServer {
+public:
+    // all the rules, with the mode first
+    using SnapshotCallback = std::function<std::vector<RuleChange>()>;
+
+    // a replica that can't keep up is disconnected, it is sent all the rules again when it comes back
+    static const size_t MAX_PENDING_MESSAGES = 1024;
+
+private:
+    class Peer : public std::enable_shared_from_this<Peer> {
+    private:
+        ReplicationServer &_server;
+        boost::asio::ip::tcp::socket _socket;
+        std::string _endpoint;
+        std::deque<std::shared_ptr<const std::string>> _queue;
+        // nothing is expected from a replica, a read only tells when it leaves
+        char _buffer[64];
+        bool _closed = false;
+
+    public:
+        Peer(ReplicationServer &server, boost::asio::ip::tcp::socket &&socket);
+
+        const std::string& getEndpoint() const;
+
+        void open(const std::shared_ptr<const std::string> &snapshot);
+
+        void send(const std::shared_ptr<const std::string> &message);
+
+        void close();
+
+    private:
+        void read();
+
+        void readHandler(const boost::system::error_code &err);
+
+        void write();
+
+        void writeHandler(const boost::system::error_code &err);
+    };
+
+    boost::asio::io_service &_ios;
+    boost::asio::ip::tcp::acceptor _acceptor;
+    boost::asio::ip::tcp::socket _socket;
+    SnapshotCallback _snapshot_callback;
+    std::unordered_set<std::shared_ptr<Peer>> _peers;
+    uint64_t _generation = 0;
+
+public:
+    // the handlers run on ios, it must be the one of the online commands so that no lock is needed
+    ReplicationServer(boost::asio::io_service &ios, const std::string &address, uint16_t port);
+
+    ~ReplicationServer() = default;
+
+    void open(const SnapshotCallback &snapshot_callback);
+
+    // the changes of one online command, in the order they were applied
+    void publish(const std::vector<RuleChange> &changes);
+
+    uint64_t getGeneration() const;
+
+    size_t getPeers() const;
+
+private:
+    void accept();
+
+    void acceptHandler(const boost::system::error_code &err);
+
+    void onPeerClosed(const std::shared_ptr<Peer> &peer);
+};
+
+// follows the rules of another instance, reconnects and resynchronizes when the connection is lost
+class ReplicationClient {
+public:
+    using ChangeCallback = std::function<void(uint64_t generation, bool reset, const std::vector<RuleChange> &changes)>;
+
+    static const boost::posix_time::seconds RECONNECT_INTERVAL;
+
+private:
+    boost::asio::io_service &_ios;
+    boost::asio::ip::tcp::endpoint _endpoint;
+    boost::asio::ip::tcp::socket _socket;
+    boost::asio::streambuf _buffer;
+    boost::asio::deadline_timer _timer;
+    ChangeCallback _change_callback;
+    bool _connected = false;
+    // the generation of the last message, a gap means a lost message and the rules are asked again
+    uint64_t _generation = 0;
+    bool _synchronized = false;
+
+public:
+    ReplicationClient(boost::asio::io_service &ios, const std::string &address, uint16_t port);
+
+    ~ReplicationClient() = default;
+
+    void open(const ChangeCallback &change_callback);
+
+    std::string getSource() const;
+
+    bool isConnected() const;
+
+    uint64_t getGeneration() const;
+
+private:
+    void connect();
+
+    void connectHandler(const boost::system::error_code &err);
+
+    void read();
+
+    void readHandler(const boost::system::error_code &err, size_t bytes_transferred);
+
+    void reconnect();
+
+    void timerHandler(const boost::system::error_code &err);
+};
@@ -0,0 +1,99 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rtt_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+const ndn::time::nanoseconds RttEstimator::INITIAL_SUPPRESSION_TIME = ndn::time::milliseconds(250);
+const ndn::time::nanoseconds RttEstimator::MIN_SUPPRESSION_TIME = ndn::time::milliseconds(1);
+const ndn::time::nanoseconds RttEstimator::MAX_SUPPRESSION_TIME = ndn::time::seconds(4);
+
+void RttEstimator::Stats::add(double rtt) {
+    if (samples++ == 0) {
+        srtt = rtt;
+        rttvar = rtt / 2;
+    } else {
+        // alpha = 1/8 and beta = 1/4
+        rttvar += (std::abs(srtt - rtt) - rttvar) / 4;
+        srtt += (rtt - srtt) / 8;
+    }
+}
+
+ndn::time::nanoseconds RttEstimator::Stats::getSuppressionTime() const {
+    ndn::time::nanoseconds time((int64_t)(srtt + 4 * rttvar));
+    return std::min(std::max(time, MIN_SUPPRESSION_TIME), MAX_SUPPRESSION_TIME);
+}
+
+void RttEstimator::Stats::writeJSON(Writer &writer) const {
+    writer.Key("srtt_ms");
+    writer.Double(srtt / 1e6);
+    writer.Key("rttvar_ms");
+    writer.Double(rttvar / 1e6);
+    writer.Key("suppression_ms");
+    writer.Double(getSuppressionTime().count() / 1e6);
+    writer.Key("samples");
+    writer.Uint64(samples);
+}
+
+RttEstimator::RttEstimator(size_t depth) : _depth(depth) {
+
+}
+
+std::string RttEstimator::getPrefix(const std::string &uri, size_t components) const {
+    // a '/' inside a component is escaped in the URI
+    size_t depth = std::min(_depth, components);
+    if (depth == 0) {
+        return "/";
+    }
+    size_t end = 0;
+    for (size_t i = 0; i < depth && end != std::string::npos; ++i) {
+        end = uri.find('/', end + 1);
+    }
+    return end == std::string::npos ? uri : uri.substr(0, end);
+}
+
+void RttEstimator::addSample(const std::string &prefix, const ndn::time::nanoseconds &rtt) {
+    double sample = (double)rtt.count();
+    _all.add(sample);
+    auto it = _stats.find(prefix);
+    if (it != _stats.end()) {
+        it->second.add(sample);
+    } else if (_stats.size() < MAX_PREFIXES) {
+        _stats[prefix].add(sample);
+    }
+}
+
+ndn::time::nanoseconds RttEstimator::getSuppressionTime(const std::string &prefix) const {
+    auto it = _stats.find(prefix);
+    if (it != _stats.end()) {
+        return it->second.getSuppressionTime();
+    }
+    return _all.samples > 0 ? _all.getSuppressionTime() : INITIAL_SUPPRESSION_TIME;
+}
+
+void RttEstimator::writeSummary(Writer &writer) const {
+    writer.StartObject();
+    writer.Key("depth");
+    writer.Uint64(_depth);
+    writer.Key("all");
+    writer.StartObject();
+    _all.writeJSON(writer);
+    writer.EndObject();
+    writer.EndObject();
+}
@@ -0,0 +1,99 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/name.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <map>
+#include <string>
+
+#include "rapidjson/include/rapidjson/stringbuffer.h"
+#include "rapidjson/include/rapidjson/writer.h"
+
+// Interest to Data round-trip times measured per name prefix (the first components of the names) with the smoothed
+// RTT and RTT variation of TCP (RFC 6298), a retransmission arriving sooner than the RTT allows is suppressed
+// the prefixes are given as URIs so that they are computed by the caller, out of its locks
+class RttEstimator {
+public:
+    using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
+
+    // until the first Data of a prefix, if no other prefix measured anything either
+    static const ndn::time::nanoseconds INITIAL_SUPPRESSION_TIME;
+    static const ndn::time::nanoseconds MIN_SUPPRESSION_TIME;
+    static const ndn::time::nanoseconds MAX_SUPPRESSION_TIME;
+    // the other prefixes share the statistics of all the prefixes
+    static const size_t MAX_PREFIXES = 1 << 16;
+
+private:
+    struct Stats {
+        // in nanoseconds
+        double srtt = 0;
+        double rttvar = 0;
+        uint64_t samples = 0;
+
+        void add(double rtt);
+
+        ndn::time::nanoseconds getSuppressionTime() const;
+
+        // in the object being written
+        void writeJSON(Writer &writer) const;
+    };
+
+    size_t _depth;
+    // by prefix URI, ordered to be dumped a page at a time
+    std::map<std::string, Stats> _stats;
+    Stats _all;
+
+public:
+    // names are measured on their first depth components
+    explicit RttEstimator(size_t depth);
+
+    ~RttEstimator() = default;
+
+    // the measured prefix of a name given by its URI, limited to its first components
+    std::string getPrefix(const std::string &uri, size_t components = std::string::npos) const;
+
+    void addSample(const std::string &prefix, const ndn::time::nanoseconds &rtt);
+
+    // a retransmission of the Interest received sooner is not forwarded
+    ndn::time::nanoseconds getSuppressionTime(const std::string &prefix) const;
+
+    // {"depth":..., "all":{...}}
+    void writeSummary(Writer &writer) const;
+
+    // the prefixes after the cursor (from the first one if empty) in order until f(prefix, write_entry) refuses
+    // one, write_entry writing it with the writer it's given, returns true if some are left
+    template <class F>
+    bool forEachFrom(const std::string &after, F f) const {
+        for (auto it = after.empty() ? _stats.begin() : _stats.upper_bound(after); it != _stats.end(); ++it) {
+            const std::string &prefix = it->first;
+            const Stats &stats = it->second;
+            if (!f(prefix, [&prefix, &stats](Writer &writer) {
+                writer.StartObject();
+                writer.Key("prefix");
+                writer.String(prefix.c_str(), static_cast<rapidjson::SizeType>(prefix.size()));
+                stats.writeJSON(writer);
+                writer.EndObject();
+            })) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
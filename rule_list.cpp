@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rule_list.h"
+
+RuleList::const_iterator::const_iterator(const RuleList *rules, size_t index,
+                                         std::set<std::string>::const_iterator added)
+        : _rules(rules)
+        , _index(index)
+        , _added(added) {
+    settle();
+}
+
+RuleList::const_iterator& RuleList::const_iterator::operator++() {
+    if (_from_snapshot) {
+        ++_index;
+    } else {
+        ++_added;
+    }
+    settle();
+    return *this;
+}
+
+void RuleList::const_iterator::settle() {
+    while (_index < _rules->_snapshot_size && _rules->_erased[_index]) {
+        ++_index;
+    }
+    _from_snapshot = false;
+    if (_index < _rules->_snapshot_size) {
+        size_t length;
+        const char *name = _rules->_snapshot->getName(_rules->_list, _index, length);
+        // same order as std::string, the snapshot was written from one
+        if (_added == _rules->_added.end() || _added->compare(0, _added->size(), name, length) > 0) {
+            _name.assign(name, length);
+            _from_snapshot = true;
+            return;
+        }
+    }
+    if (_added != _rules->_added.end()) {
+        _name = *_added;
+    } else {
+        _name.clear();
+    }
+}
+
+size_t RuleList::size() const {
+    return _snapshot_size - _erased_size + _added.size();
+}
+
+bool RuleList::contains(const std::string &name) const {
+    size_t index = findInSnapshot(name, false);
+    if (isInSnapshot(index, name)) {
+        return !_erased[index];
+    }
+    return _added.find(name) != _added.end();
+}
+
+bool RuleList::insert(const std::string &name) {
+    size_t index = findInSnapshot(name, false);
+    if (isInSnapshot(index, name)) {
+        if (!_erased[index]) {
+            return false;
+        }
+        _erased[index] = false;
+        --_erased_size;
+        return true;
+    }
+    return _added.insert(name).second;
+}
+
+size_t RuleList::erase(const std::string &name) {
+    size_t index = findInSnapshot(name, false);
+    if (isInSnapshot(index, name)) {
+        if (_erased[index]) {
+            return 0;
+        }
+        _erased[index] = true;
+        ++_erased_size;
+        return 1;
+    }
+    return _added.erase(name);
+}
+
+RuleList::const_iterator RuleList::begin() const {
+    return const_iterator(this, 0, _added.begin());
+}
+
+RuleList::const_iterator RuleList::end() const {
+    return const_iterator(this, _snapshot_size, _added.end());
+}
+
+RuleList::const_iterator RuleList::lower_bound(const std::string &name) const {
+    return const_iterator(this, findInSnapshot(name, false), _added.lower_bound(name));
+}
+
+RuleList::const_iterator RuleList::upper_bound(const std::string &name) const {
+    return const_iterator(this, findInSnapshot(name, true), _added.upper_bound(name));
+}
+
+size_t RuleList::findInSnapshot(const std::string &name, bool upper) const {
+    size_t first = 0;
+    size_t count = _snapshot_size;
+    while (count > 0) {
+        size_t half = count / 2;
+        size_t length;
+        const char *middle = _snapshot->getName(_list, first + half, length);
+        int order = name.compare(0, name.size(), middle, length);
+        if (order > 0 || (upper && order == 0)) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return first;
+}
+
+bool RuleList::isInSnapshot(size_t index, const std::string &name) const {
+    if (index >= _snapshot_size) {
+        return false;
+    }
+    size_t length;
+    const char *rule = _snapshot->getName(_list, index, length);
+    return name.compare(0, name.size(), rule, length) == 0;
+}
@@ -0,0 +1,128 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <iterator>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rule_snapshot.h"
+
+// the name prefixes of a list of rules in name order, those of the snapshot loaded at launch are read from its mapping
+// instead of being copied one by one into a set, only the rules changed since are kept aside
+class RuleList {
+public:
+    class const_iterator : public std::iterator<std::forward_iterator_tag, const std::string> {
+    private:
+        const RuleList *_rules;
+        // the next rules of the snapshot and of those appended since, the smallest one is the current rule
+        size_t _index;
+        std::set<std::string>::const_iterator _added;
+        bool _from_snapshot = false;
+        std::string _name;
+
+    public:
+        const_iterator(const RuleList *rules, size_t index, std::set<std::string>::const_iterator added);
+
+        const std::string& operator*() const {
+            return _name;
+        }
+
+        const std::string* operator->() const {
+            return &_name;
+        }
+
+        const_iterator& operator++();
+
+        bool operator==(const const_iterator &other) const {
+            return _index == other._index && _added == other._added;
+        }
+
+        bool operator!=(const const_iterator &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        // skips the deleted rules of the snapshot and reads the current one
+        void settle();
+    };
+
+private:
+    std::shared_ptr<const RuleSnapshot> _snapshot;
+    RuleSnapshot::List _list = RuleSnapshot::WHITELIST;
+    size_t _snapshot_size = 0;
+    // the rules of the snapshot deleted since, or not loaded
+    std::vector<bool> _erased;
+    size_t _erased_size = 0;
+    // the rules appended since, never in the snapshot
+    std::set<std::string> _added;
+
+public:
+    RuleList() = default;
+
+    ~RuleList() = default;
+
+    // the rules become those of the list of the snapshot for which keep(name, length, hash) is true, the snapshot
+    // stays mapped as long as they are used
+    template <class F>
+    void assign(const std::shared_ptr<const RuleSnapshot> &snapshot, RuleSnapshot::List list, F keep) {
+        _snapshot = snapshot;
+        _list = list;
+        _snapshot_size = snapshot->size(list);
+        _erased.assign(_snapshot_size, false);
+        _erased_size = 0;
+        _added.clear();
+        size_t index = 0;
+        snapshot->forEach(list, [this, &index, &keep](const char *name, size_t length, size_t hash) {
+            if (!keep(name, length, hash)) {
+                _erased[index] = true;
+                ++_erased_size;
+            }
+            ++index;
+        });
+    }
+
+    size_t size() const;
+
+    bool contains(const std::string &name) const;
+
+    // false if the rule was already there
+    bool insert(const std::string &name);
+
+    // the number of rules erased, 0 or 1
+    size_t erase(const std::string &name);
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+    // the first rule not before name
+    const_iterator lower_bound(const std::string &name) const;
+
+    // the first rule after name
+    const_iterator upper_bound(const std::string &name) const;
+
+private:
+    // the position of the first rule of the snapshot not before name (after name if upper)
+    size_t findInSnapshot(const std::string &name, bool upper) const;
+
+    // true if the index-th rule of the snapshot is name
+    bool isInSnapshot(size_t index, const std::string &name) const;
+};
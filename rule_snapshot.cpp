@@ -0,0 +1,217 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "rule_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/system/system_error.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+
+#include "rule_list.h"
+
+static const char MAGIC[8] = {'N', 'D', 'N', 'F', 'W', 'R', 'S', 'S'};
+
+static uint64_t align(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+RuleSnapshot::RuleSnapshot(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw boost::system::system_error(errno, boost::system::system_category(), path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int error = errno;
+        close(fd);
+        throw boost::system::system_error(error, boost::system::system_category(), path);
+    }
+    _size = (size_t)st.st_size;
+    if (_size < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error(path + " is not a rule snapshot");
+    }
+    _memory = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    close(fd);
+    if (_memory == MAP_FAILED) {
+        throw boost::system::system_error(error, boost::system::system_category(), path);
+    }
+    madvise(_memory, _size, MADV_SEQUENTIAL);
+    _header = static_cast<const Header*>(_memory);
+
+    std::string reason;
+    if (memcmp(_header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        reason = " is not a rule snapshot";
+    } else if (_header->version != VERSION) {
+        reason = " is a rule snapshot of version " + std::to_string(_header->version) + ", not " +
+                 std::to_string(VERSION);
+    } else if (_header->size != _size) {
+        reason = " is truncated";
+    }
+    for (size_t i = 0; i < 2 && reason.empty(); ++i) {
+        // the sizes are checked before any of them is used as an offset
+        const ListHeader &list = _header->lists[i];
+        if (list.rules > _size / sizeof(uint64_t) || list.depths > _size / sizeof(uint32_t) ||
+            list.depths_offset % 8 != 0 || list.hashes_offset % 8 != 0 ||
+            list.depths_offset > _size || list.depths * sizeof(uint32_t) > _size - list.depths_offset ||
+            list.hashes_offset > _size || (list.rules * 2 + 1) * sizeof(uint64_t) > _size - list.hashes_offset ||
+            list.names_offset > _size || list.names_size > _size - list.names_offset) {
+            reason = " is corrupted";
+            break;
+        }
+        const uint64_t *offsets = reinterpret_cast<const uint64_t*>(static_cast<const char*>(_memory) +
+                                                                    list.hashes_offset) + list.rules;
+        for (uint64_t j = 0; j < list.rules; ++j) {
+            if (offsets[j] > offsets[j + 1]) {
+                reason = " is corrupted";
+                break;
+            }
+        }
+        if (reason.empty() && offsets[list.rules] != list.names_size) {
+            reason = " is corrupted";
+        }
+    }
+    if (!reason.empty()) {
+        munmap(_memory, _size);
+        throw std::runtime_error(path + reason);
+    }
+}
+
+RuleSnapshot::~RuleSnapshot() {
+    munmap(_memory, _size);
+}
+
+bool RuleSnapshot::isDropMode() const {
+    return _header->drop != 0;
+}
+
+bool RuleSnapshot::hasSameHash() const {
+    return _header->hash_check == hashCheck();
+}
+
+size_t RuleSnapshot::size(List list) const {
+    return (size_t)_header->lists[list].rules;
+}
+
+std::vector<std::pair<uint16_t, uint16_t>> RuleSnapshot::getDepths(List list) const {
+    const ListHeader &header = _header->lists[list];
+    const uint16_t *depths = reinterpret_cast<const uint16_t*>(static_cast<const char*>(_memory) +
+                                                               header.depths_offset);
+    std::vector<std::pair<uint16_t, uint16_t>> pairs;
+    for (uint64_t i = 0; i < header.depths; ++i) {
+        pairs.emplace_back(depths[i * 2], depths[i * 2 + 1]);
+    }
+    return pairs;
+}
+
+const char* RuleSnapshot::getName(List list, size_t index, size_t &length) const {
+    const ListHeader &header = _header->lists[list];
+    const char *base = static_cast<const char*>(_memory);
+    const uint64_t *offsets = reinterpret_cast<const uint64_t*>(base + header.hashes_offset) + header.rules;
+    length = (size_t)(offsets[index + 1] - offsets[index]);
+    return base + header.names_offset + offsets[index];
+}
+
+void RuleSnapshot::write(const std::string &path, bool drop, const RuleList &whitelist,
+                         const std::vector<std::pair<uint16_t, uint16_t>> &whitelistDepths,
+                         const RuleList &blacklist,
+                         const std::vector<std::pair<uint16_t, uint16_t>> &blacklistDepths) {
+    const RuleList *lists[2] = {&whitelist, &blacklist};
+    const std::vector<std::pair<uint16_t, uint16_t>> *depths[2] = {&whitelistDepths, &blacklistDepths};
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.drop = drop ? 1 : 0;
+    header.hash_check = hashCheck();
+    uint64_t offset = align(sizeof(Header));
+    for (size_t i = 0; i < 2; ++i) {
+        ListHeader &list = header.lists[i];
+        list.rules = lists[i]->size();
+        list.depths = depths[i]->size();
+        list.depths_offset = offset;
+        list.hashes_offset = align(list.depths_offset + list.depths * sizeof(uint32_t));
+        list.names_offset = list.hashes_offset + (list.rules * 2 + 1) * sizeof(uint64_t);
+        for (const auto &name : *lists[i]) {
+            list.names_size += name.size();
+        }
+        offset = align(list.names_offset + list.names_size);
+    }
+    header.size = offset;
+
+    std::string tmp = path + ".tmp";
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("can't open " + tmp);
+    }
+    static const char padding[8] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t position = sizeof(header);
+    for (size_t i = 0; i < 2; ++i) {
+        const ListHeader &list = header.lists[i];
+        file.write(padding, list.depths_offset - position);
+        for (const auto &depth : *depths[i]) {
+            file.write(reinterpret_cast<const char*>(&depth.first), sizeof(uint16_t));
+            file.write(reinterpret_cast<const char*>(&depth.second), sizeof(uint16_t));
+        }
+        position = list.depths_offset + list.depths * sizeof(uint32_t);
+        file.write(padding, list.hashes_offset - position);
+        for (const auto &name : *lists[i]) {
+            uint64_t hash = std::hash<std::string>()(name);
+            file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+        }
+        uint64_t nameOffset = 0;
+        file.write(reinterpret_cast<const char*>(&nameOffset), sizeof(nameOffset));
+        for (const auto &name : *lists[i]) {
+            nameOffset += name.size();
+            file.write(reinterpret_cast<const char*>(&nameOffset), sizeof(nameOffset));
+        }
+        for (const auto &name : *lists[i]) {
+            file.write(name.data(), name.size());
+        }
+        position = list.names_offset + list.names_size;
+        uint64_t next = i == 0 ? header.lists[1].depths_offset : header.size;
+        file.write(padding, next - position);
+        position = next;
+    }
+    file.close();
+    if (!file) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("can't write " + tmp);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        int error = errno;
+        std::remove(tmp.c_str());
+        throw boost::system::system_error(error, boost::system::system_category(), path);
+    }
+}
+
+uint64_t RuleSnapshot::hashCheck() {
+    return std::hash<std::string>()("/ndn-firewall/rule-snapshot");
+}
@@ -0,0 +1,107 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+class RuleList;
+
+// the rules of the firewall in a binary file mapped at launch, no JSON has to be parsed nor name hashed again
+// header, then for each list its depth counters, the hash of each rule (the key of the filters), the offsets of the
+// names and the names, sorted as in the lists
+class RuleSnapshot {
+public:
+    enum List {
+        WHITELIST = 0,
+        BLACKLIST = 1
+    };
+
+    // changed with the layout of the file
+    static const uint32_t VERSION = 1;
+
+private:
+    struct ListHeader {
+        uint64_t rules;
+        uint64_t depths;
+        uint64_t depths_offset;
+        uint64_t hashes_offset;
+        uint64_t names_offset;
+        uint64_t names_size;
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t drop;
+        // std::hash of a known name, the hashes are computed again by a build hashing differently
+        uint64_t hash_check;
+        uint64_t size;
+        ListHeader lists[2];
+    };
+
+    void *_memory;
+    size_t _size;
+    const Header *_header;
+
+public:
+    // maps the file, throws if it can't be read or is not a snapshot of this version
+    explicit RuleSnapshot(const std::string &path);
+
+    ~RuleSnapshot();
+
+    RuleSnapshot(const RuleSnapshot&) = delete;
+
+    RuleSnapshot& operator=(const RuleSnapshot&) = delete;
+
+    bool isDropMode() const;
+
+    // false if the hashes were computed by another std::hash
+    bool hasSameHash() const;
+
+    size_t size(List list) const;
+
+    std::vector<std::pair<uint16_t, uint16_t>> getDepths(List list) const;
+
+    // the name of the index-th rule in order, not terminated
+    const char* getName(List list, size_t index, size_t &length) const;
+
+    // for each rule in order, f(name, length, hash)
+    template <class Function>
+    void forEach(List list, const Function &f) const {
+        const ListHeader &header = _header->lists[list];
+        const char *base = static_cast<const char*>(_memory);
+        const uint64_t *hashes = reinterpret_cast<const uint64_t*>(base + header.hashes_offset);
+        // rules + 1 offsets, then the names
+        const uint64_t *offsets = hashes + header.rules;
+        const char *names = base + header.names_offset;
+        for (uint64_t i = 0; i < header.rules; ++i) {
+            f(names + offsets[i], (size_t)(offsets[i + 1] - offsets[i]), (size_t)hashes[i]);
+        }
+    }
+
+    // written to path.tmp then renamed, a snapshot being written is never loaded, throws on error
+    static void write(const std::string &path, bool drop, const RuleList &whitelist,
+                      const std::vector<std::pair<uint16_t, uint16_t>> &whitelistDepths,
+                      const RuleList &blacklist,
+                      const std::vector<std::pair<uint16_t, uint16_t>> &blacklistDepths);
+
+    static uint64_t hashCheck();
+};
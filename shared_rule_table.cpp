@@ -0,0 +1,379 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "shared_rule_table.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/system/system_error.hpp>
+
+#include <cerrno>
+#include <stdexcept>
+#include <vector>
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "the slots are shared as plain 64-bit words");
+
+static void throwError(int fd, const std::string &what) {
+    int error = errno;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    throw boost::system::system_error(error, boost::system::system_category(), what);
+}
+
+SharedRuleTable::SharedRuleTable(const std::string &name, void *memory, size_t size)
+        : _name(name)
+        , _memory(memory)
+        , _size(size)
+        , _header(static_cast<Header*>(memory)) {
+    static_assert(sizeof(Header) <= HEADER_SIZE, "header larger than its place in the segment");
+    static_assert(sizeof(RegionHeader) <= REGION_HEADER_SIZE, "region header larger than its place in the segment");
+    size_t region_size = regionSizeFor(_header->capacity[WHITELIST], _header->capacity[BLACKLIST]);
+    for (size_t i = 0; i < 2; ++i) {
+        char *base = static_cast<char*>(memory) + HEADER_SIZE + i * region_size;
+        Region &region = _regions[i];
+        region.header = reinterpret_cast<RegionHeader*>(base);
+        region.slots[WHITELIST] = reinterpret_cast<std::atomic<uint64_t>*>(base + REGION_HEADER_SIZE);
+        region.slots[BLACKLIST] = region.slots[WHITELIST] + _header->capacity[WHITELIST];
+        region.live[WHITELIST] = region.live[BLACKLIST] = 0;
+        region.used[WHITELIST] = region.used[BLACKLIST] = 0;
+    }
+}
+
+SharedRuleTable::~SharedRuleTable() {
+    // the segment stays for the other processes, a restarted control process reuses it
+    munmap(_memory, _size);
+}
+
+std::unique_ptr<SharedRuleTable> SharedRuleTable::create(const std::string &name, size_t whitelist_items,
+                                                         size_t blacklist_items) {
+    uint64_t capacity[2] = {capacityFor(whitelist_items), capacityFor(blacklist_items)};
+    size_t size = sizeFor(capacity[WHITELIST], capacity[BLACKLIST]);
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        throwError(fd, name);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        throwError(fd, name);
+    }
+    bool existing = st.st_size != 0;
+    if (existing && (size_t)st.st_size != size) {
+        ::close(fd);
+        throw std::runtime_error(name + " already exists with another size, remove it or keep the same -w and -b");
+    }
+    if (!existing && ftruncate(fd, size) < 0) {
+        throwError(fd, name);
+    }
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        throwError(fd, name);
+    }
+    ::close(fd);
+
+    auto header = static_cast<Header*>(memory);
+    if (existing && (header->magic.load(std::memory_order_acquire) != MAGIC ||
+                     header->capacity[WHITELIST] != capacity[WHITELIST] ||
+                     header->capacity[BLACKLIST] != capacity[BLACKLIST])) {
+        munmap(memory, size);
+        throw std::runtime_error(name + " already exists and is not a rule table of the same size, remove it");
+    }
+    if (!existing) {
+        // ftruncate() gave zeroed pages, the table is empty, the workers accept it once the magic is there
+        header->capacity[WHITELIST] = capacity[WHITELIST];
+        header->capacity[BLACKLIST] = capacity[BLACKLIST];
+    }
+    std::unique_ptr<SharedRuleTable> table(new SharedRuleTable(name, memory, size));
+    if (existing) {
+        // the rules of the previous control process are gone with it, the workers still attached follow the new ones
+        table->beginUpdate();
+        Region &region = table->getWriteRegion();
+        table->clear(region, WHITELIST);
+        table->clear(region, BLACKLIST);
+        table->_copy = true;
+        table->setDepth(WHITELIST, 0);
+        table->setDepth(BLACKLIST, 0);
+        table->endUpdate();
+    } else {
+        header->magic.store(MAGIC, std::memory_order_release);
+    }
+    return table;
+}
+
+std::unique_ptr<SharedRuleTable> SharedRuleTable::attach(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throwError(fd, name);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        throwError(fd, name);
+    }
+    size_t size = (size_t)st.st_size;
+    if (size < HEADER_SIZE) {
+        ::close(fd);
+        throw std::runtime_error(name + " is not a rule table, start the control process first");
+    }
+    void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        throwError(fd, name);
+    }
+    ::close(fd);
+    auto header = static_cast<Header*>(memory);
+    if (header->magic.load(std::memory_order_acquire) != MAGIC ||
+        sizeFor(header->capacity[WHITELIST], header->capacity[BLACKLIST]) != size) {
+        munmap(memory, size);
+        throw std::runtime_error(name + " is not a rule table, start the control process first");
+    }
+    return std::unique_ptr<SharedRuleTable>(new SharedRuleTable(name, memory, size));
+}
+
+const std::string& SharedRuleTable::getName() const {
+    return _name;
+}
+
+uint64_t SharedRuleTable::getVersion() const {
+    return _header->version.load(std::memory_order_acquire);
+}
+
+void SharedRuleTable::beginUpdate() {
+    _changes.clear();
+    _copy = false;
+}
+
+void SharedRuleTable::endUpdate() {
+    // the readers switch to the region just written
+    _header->version.fetch_add(1, std::memory_order_release);
+    // the switch is visible before the former region changes
+    std::atomic_thread_fence(std::memory_order_release);
+    Region &former = getWriteRegion();
+    if (_copy) {
+        copy(_regions[_header->version.load(std::memory_order_relaxed) & 1], former);
+    } else {
+        for (const auto &change : _changes) {
+            apply(former, change);
+        }
+    }
+    _changes.clear();
+}
+
+bool SharedRuleTable::add(List list, size_t hash) {
+    Change change = {Change::ADD, list, toKey(hash)};
+    log(change);
+    return add(getWriteRegion(), list, change.value);
+}
+
+void SharedRuleTable::remove(List list, size_t hash) {
+    Change change = {Change::REMOVE, list, toKey(hash)};
+    log(change);
+    remove(getWriteRegion(), list, change.value);
+}
+
+void SharedRuleTable::setDepth(List list, uint16_t depth) {
+    Change change = {Change::DEPTH, list, depth};
+    log(change);
+    apply(getWriteRegion(), change);
+}
+
+void SharedRuleTable::setDropMode(bool drop) {
+    Change change = {Change::DROP, WHITELIST, drop ? 1u : 0u};
+    log(change);
+    apply(getWriteRegion(), change);
+}
+
+uint64_t SharedRuleTable::readBegin() const {
+    // the region of this version was complete before the version was published
+    return _header->version.load(std::memory_order_acquire);
+}
+
+bool SharedRuleTable::readRetry(uint64_t version) const {
+    // the lookups are done before the version is read again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return _header->version.load(std::memory_order_relaxed) != version;
+}
+
+bool SharedRuleTable::contains(uint64_t version, List list, size_t hash) const {
+    const Region &region = _regions[version & 1];
+    uint64_t capacity = _header->capacity[list];
+    uint64_t key = toKey(hash);
+    uint64_t mask = capacity - 1;
+    for (uint64_t i = 0, pos = key & mask; i < capacity; ++i, pos = (pos + 1) & mask) {
+        uint64_t slot = region.slots[list][pos].load(std::memory_order_relaxed);
+        if (slot == key) {
+            return true;
+        } else if (slot == EMPTY) {
+            return false;
+        }
+    }
+    return false;
+}
+
+uint16_t SharedRuleTable::getDepth(uint64_t version, List list) const {
+    return _regions[version & 1].header->depth[list].load(std::memory_order_relaxed);
+}
+
+bool SharedRuleTable::isDropMode(uint64_t version) const {
+    return _regions[version & 1].header->drop.load(std::memory_order_relaxed) != 0;
+}
+
+uint64_t SharedRuleTable::capacityFor(size_t items) {
+    // at most half full, the probes stay short
+    uint64_t capacity = 16;
+    while (capacity < (uint64_t)items * 2) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+size_t SharedRuleTable::regionSizeFor(uint64_t whitelist_capacity, uint64_t blacklist_capacity) {
+    return REGION_HEADER_SIZE + (size_t)(whitelist_capacity + blacklist_capacity) * sizeof(uint64_t);
+}
+
+size_t SharedRuleTable::sizeFor(uint64_t whitelist_capacity, uint64_t blacklist_capacity) {
+    return HEADER_SIZE + 2 * regionSizeFor(whitelist_capacity, blacklist_capacity);
+}
+
+uint64_t SharedRuleTable::toKey(size_t hash) {
+    // EMPTY and DELETED are not keys, the rare hashes colliding with them share a key with another one
+    return hash > DELETED ? (uint64_t)hash : (uint64_t)hash + 2;
+}
+
+SharedRuleTable::Region& SharedRuleTable::getWriteRegion() {
+    return _regions[(_header->version.load(std::memory_order_relaxed) + 1) & 1];
+}
+
+void SharedRuleTable::log(const Change &change) {
+    if (_copy) {
+        return;
+    }
+    if (_changes.size() == MAX_LOGGED_CHANGES) {
+        // a large update (e.g., a load) is cheaper to copy than to apply twice
+        _changes.clear();
+        _copy = true;
+        return;
+    }
+    _changes.push_back(change);
+}
+
+void SharedRuleTable::apply(Region &region, const Change &change) {
+    switch (change.type) {
+        case Change::ADD:
+            add(region, change.list, change.value);
+            break;
+        case Change::REMOVE:
+            remove(region, change.list, change.value);
+            break;
+        case Change::DEPTH:
+            region.header->depth[change.list].store((uint16_t)change.value, std::memory_order_relaxed);
+            break;
+        case Change::DROP:
+            region.header->drop.store((uint8_t)change.value, std::memory_order_relaxed);
+            break;
+    }
+}
+
+bool SharedRuleTable::add(Region &region, List list, uint64_t key) {
+    uint64_t capacity = _header->capacity[list];
+    if ((region.used[list] + 1) * 4 > capacity * 3) {
+        rehash(region, list);
+    }
+    uint64_t mask = capacity - 1;
+    uint64_t free = capacity;
+    for (uint64_t i = 0, pos = key & mask; i < capacity; ++i, pos = (pos + 1) & mask) {
+        uint64_t slot = region.slots[list][pos].load(std::memory_order_relaxed);
+        if (slot == key) {
+            return true;
+        } else if (slot == DELETED) {
+            if (free == capacity) {
+                free = pos;
+            }
+        } else if (slot == EMPTY) {
+            if (free == capacity) {
+                free = pos;
+                ++region.used[list];
+            }
+            break;
+        }
+    }
+    if (free == capacity) {
+        return false;
+    }
+    region.slots[list][free].store(key, std::memory_order_relaxed);
+    ++region.live[list];
+    return true;
+}
+
+void SharedRuleTable::remove(Region &region, List list, uint64_t key) {
+    uint64_t capacity = _header->capacity[list];
+    uint64_t mask = capacity - 1;
+    for (uint64_t i = 0, pos = key & mask; i < capacity; ++i, pos = (pos + 1) & mask) {
+        uint64_t slot = region.slots[list][pos].load(std::memory_order_relaxed);
+        if (slot == key) {
+            // the following keys of the probe sequence must stay reachable
+            region.slots[list][pos].store(DELETED, std::memory_order_relaxed);
+            --region.live[list];
+            return;
+        } else if (slot == EMPTY) {
+            return;
+        }
+    }
+}
+
+void SharedRuleTable::clear(Region &region, List list) {
+    for (uint64_t pos = 0; pos < _header->capacity[list]; ++pos) {
+        region.slots[list][pos].store(EMPTY, std::memory_order_relaxed);
+    }
+    region.live[list] = 0;
+    region.used[list] = 0;
+}
+
+void SharedRuleTable::rehash(Region &region, List list) {
+    std::vector<uint64_t> keys;
+    keys.reserve(region.live[list]);
+    for (uint64_t pos = 0; pos < _header->capacity[list]; ++pos) {
+        uint64_t slot = region.slots[list][pos].load(std::memory_order_relaxed);
+        if (slot != EMPTY && slot != DELETED) {
+            keys.push_back(slot);
+        }
+    }
+    clear(region, list);
+    uint64_t mask = _header->capacity[list] - 1;
+    for (auto key : keys) {
+        uint64_t pos = key & mask;
+        while (region.slots[list][pos].load(std::memory_order_relaxed) != EMPTY) {
+            pos = (pos + 1) & mask;
+        }
+        region.slots[list][pos].store(key, std::memory_order_relaxed);
+    }
+    region.live[list] = keys.size();
+    region.used[list] = keys.size();
+}
+
+void SharedRuleTable::copy(const Region &from, Region &to) {
+    for (size_t list = 0; list < 2; ++list) {
+        for (uint64_t pos = 0; pos < _header->capacity[list]; ++pos) {
+            to.slots[list][pos].store(from.slots[list][pos].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        to.header->depth[list].store(from.header->depth[list].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.live[list] = from.live[list];
+        to.used[list] = from.used[list];
+    }
+    to.header->drop.store(from.header->drop.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
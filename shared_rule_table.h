@@ -0,0 +1,161 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// the whitelist and blacklist hashes in a POSIX shared memory segment, written by the control process and read
+// lock-free by the worker processes, a multi-process firewall then keeps a single copy of the rules
+// the segment holds two copies (regions) of the rules, each list being an open addressing table of 64-bit hashes, the
+// readers only use the region given by the version of the header while the writer changes the other one, ending an
+// update switches the regions then applies the same changes to the former one, so a reader never sees a partial table
+// and only checks a name again if the regions were switched meanwhile (seqlock)
+class SharedRuleTable {
+public:
+    enum List {
+        WHITELIST = 0,
+        BLACKLIST = 1
+    };
+
+    // checks of a name before the reader gives up, then the name must be dropped (fail closed)
+    static const size_t MAX_READ_RETRIES = 16;
+
+private:
+    // changed with the layout of the segment
+    static const uint64_t MAGIC = 0x6e646e66772d7232;
+    static const uint64_t EMPTY = 0;
+    static const uint64_t DELETED = 1;
+    static const size_t HEADER_SIZE = 64;
+    static const size_t REGION_HEADER_SIZE = 64;
+    // past that many changes in one update, the former region is copied instead of changed again
+    static const size_t MAX_LOGGED_CHANGES = 1 << 16;
+
+    struct Header {
+        std::atomic<uint64_t> magic;
+        // slots of each list, powers of two
+        uint64_t capacity[2];
+        // the readers use the region version & 1
+        std::atomic<uint64_t> version;
+    };
+
+    struct RegionHeader {
+        // most slashes in a rule of each list, 0 if the list is empty
+        std::atomic<uint16_t> depth[2];
+        std::atomic<uint8_t> drop;
+    };
+
+    struct Region {
+        RegionHeader *header;
+        std::atomic<uint64_t> *slots[2];
+        // live and deleted slots of each list, only kept by the writer
+        size_t live[2];
+        size_t used[2];
+    };
+
+    struct Change {
+        enum Type {
+            ADD,
+            REMOVE,
+            DEPTH,
+            DROP
+        } type;
+        List list;
+        uint64_t value;
+    };
+
+    std::string _name;
+    void *_memory;
+    size_t _size;
+    Header *_header;
+    Region _regions[2];
+    // changes of the current update, to apply to the former region once the regions are switched
+    std::vector<Change> _changes;
+    bool _copy = false;
+
+    SharedRuleTable(const std::string &name, void *memory, size_t size);
+
+public:
+    ~SharedRuleTable();
+
+    // by the control process, a segment left by a previous run is reused if it has the same size and emptied
+    static std::unique_ptr<SharedRuleTable> create(const std::string &name, size_t whitelist_items,
+                                                   size_t blacklist_items);
+
+    // by the workers, read-only, the control process must have created the segment
+    static std::unique_ptr<SharedRuleTable> attach(const std::string &name);
+
+    const std::string& getName() const;
+
+    uint64_t getVersion() const;
+
+    // the rules are only changed between these calls, the changes are seen at once by the readers
+    void beginUpdate();
+
+    void endUpdate();
+
+    // false if the list is full
+    bool add(List list, size_t hash);
+
+    void remove(List list, size_t hash);
+
+    void setDepth(List list, uint16_t depth);
+
+    void setDropMode(bool drop);
+
+    // the lookups given the version returned by readBegin() see one version of the rules, unless readRetry() is true
+    uint64_t readBegin() const;
+
+    bool readRetry(uint64_t version) const;
+
+    bool contains(uint64_t version, List list, size_t hash) const;
+
+    uint16_t getDepth(uint64_t version, List list) const;
+
+    bool isDropMode(uint64_t version) const;
+
+private:
+    static uint64_t capacityFor(size_t items);
+
+    static size_t regionSizeFor(uint64_t whitelist_capacity, uint64_t blacklist_capacity);
+
+    static size_t sizeFor(uint64_t whitelist_capacity, uint64_t blacklist_capacity);
+
+    static uint64_t toKey(size_t hash);
+
+    // the region changed by the writer, not used by the readers
+    Region& getWriteRegion();
+
+    // keep the change for the former region
+    void log(const Change &change);
+
+    void apply(Region &region, const Change &change);
+
+    bool add(Region &region, List list, uint64_t key);
+
+    void remove(Region &region, List list, uint64_t key);
+
+    void clear(Region &region, List list);
+
+    // drops the deleted slots, they would make the probes longer and longer
+    void rehash(Region &region, List list);
+
+    void copy(const Region &from, Region &to);
+};
\ No newline at end of file
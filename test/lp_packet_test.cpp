@@ -0,0 +1,202 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// LpPacket: encoding and parsing of the header fields, rejection of malformed packets and fragmentation
+
+#define BOOST_TEST_MODULE lp_packet_test
+#include <boost/test/included/unit_test.hpp>
+
+#include "../tlv/lp_packet.h"
+#include "../tlv/tlv.h"
+
+#include <string>
+#include <vector>
+
+static const uint8_t CONTENT = 0x15;
+
+// Data of the given size, its value only holds a content
+static ndn::Block makeData(size_t size) {
+    std::vector<uint8_t> content(size - 8, 0);
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = (uint8_t)(i * 7);
+    }
+    std::vector<uint8_t> value;
+    tlv::writeVarNumber(value, CONTENT);
+    tlv::writeVarNumber(value, content.size());
+    value.insert(value.end(), content.begin(), content.end());
+    std::vector<uint8_t> wire;
+    tlv::writeVarNumber(wire, tlv::DATA);
+    tlv::writeVarNumber(wire, value.size());
+    wire.insert(wire.end(), value.begin(), value.end());
+    return ndn::Block(wire.data(), wire.size());
+}
+
+static ndn::Block makeLpPacket(const std::vector<uint8_t> &fields) {
+    std::vector<uint8_t> wire;
+    tlv::writeVarNumber(wire, tlv::LP_PACKET);
+    tlv::writeVarNumber(wire, fields.size());
+    wire.insert(wire.end(), fields.begin(), fields.end());
+    return ndn::Block(wire.data(), wire.size());
+}
+
+static void writeElement(std::vector<uint8_t> &buffer, uint64_t type, const std::vector<uint8_t> &value) {
+    tlv::writeVarNumber(buffer, type);
+    tlv::writeVarNumber(buffer, value.size());
+    buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+static std::string toString(const uint8_t *data, size_t size) {
+    return std::string((const char *)data, size);
+}
+
+BOOST_AUTO_TEST_CASE(encode_and_parse) {
+    ndn::Block data = makeData(100);
+    LpHeaders headers;
+    headers.pit_token = "token";
+    headers.congestion_mark = 1;
+    LpPacket packet(LpPacket::encode(data, headers));
+
+    BOOST_CHECK(packet.hasFragment());
+    BOOST_CHECK(!packet.hasSequence());
+    BOOST_CHECK_EQUAL(packet.getFragIndex(), 0);
+    BOOST_CHECK_EQUAL(packet.getFragCount(), 1);
+    BOOST_CHECK_EQUAL(packet.getHeaders().pit_token, "token");
+    BOOST_CHECK(!packet.getHeaders().nack);
+    BOOST_CHECK_EQUAL(packet.getHeaders().congestion_mark, 1);
+    BOOST_CHECK_EQUAL(packet.getFragment().type(), tlv::DATA);
+    BOOST_CHECK_EQUAL(toString(packet.getFragmentData(), packet.getFragmentSize()), toString(data.wire(), data.size()));
+}
+
+BOOST_AUTO_TEST_CASE(encode_without_headers) {
+    ndn::Block data = makeData(100);
+    LpPacket packet(LpPacket::encode(data, LpHeaders()));
+
+    BOOST_CHECK(packet.getHeaders().empty());
+    BOOST_CHECK_EQUAL(packet.getFragmentSize(), data.size());
+}
+
+BOOST_AUTO_TEST_CASE(encode_nack) {
+    ndn::Block interest = makeData(40);
+    LpPacket packet(LpPacket::encodeNack(interest, LpPacket::NACK_NO_ROUTE, "t"));
+
+    BOOST_CHECK(packet.getHeaders().nack);
+    BOOST_CHECK_EQUAL(packet.getHeaders().nack_reason, LpPacket::NACK_NO_ROUTE);
+    BOOST_CHECK_EQUAL(packet.getHeaders().pit_token, "t");
+    BOOST_CHECK_EQUAL(packet.getFragmentSize(), interest.size());
+}
+
+BOOST_AUTO_TEST_CASE(idle_packet) {
+    LpPacket packet(makeLpPacket({}));
+
+    BOOST_CHECK(!packet.hasFragment());
+    BOOST_CHECK_EQUAL(packet.getFragmentSize(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ignorable_field_skipped) {
+    std::vector<uint8_t> fields;
+    // in the range 800-959 with both low bits cleared
+    writeElement(fields, 0x0324, {1, 2, 3});
+    writeElement(fields, tlv::LP_FRAGMENT, {0x05, 0x00});
+    LpPacket packet(makeLpPacket(fields));
+
+    BOOST_CHECK(packet.hasFragment());
+    BOOST_CHECK_EQUAL(packet.getFragmentSize(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_packets) {
+    std::vector<uint8_t> fields;
+
+    // not an LpPacket
+    BOOST_CHECK_THROW(LpPacket{makeData(100)}, LpPacket::Error);
+
+    // a field longer than what is left
+    fields = {tlv::LP_FRAGMENT, 10, 0x05, 0x00};
+    BOOST_CHECK_THROW(LpPacket{makeLpPacket(fields)}, LpPacket::Error);
+
+    // a field after the Fragment
+    fields.clear();
+    writeElement(fields, tlv::LP_FRAGMENT, {0x05, 0x00});
+    writeElement(fields, tlv::LP_PIT_TOKEN, {1});
+    BOOST_CHECK_THROW(LpPacket{makeLpPacket(fields)}, LpPacket::Error);
+
+    // a PitToken empty or too large
+    fields.clear();
+    writeElement(fields, tlv::LP_PIT_TOKEN, {});
+    BOOST_CHECK_THROW(LpPacket{makeLpPacket(fields)}, LpPacket::Error);
+    fields.clear();
+    writeElement(fields, tlv::LP_PIT_TOKEN, std::vector<uint8_t>(LpPacket::MAX_PIT_TOKEN_SIZE + 1, 1));
+    BOOST_CHECK_THROW(LpPacket{makeLpPacket(fields)}, LpPacket::Error);
+
+    // an unknown field that can't be ignored
+    fields.clear();
+    writeElement(fields, 0x0325, {1});
+    BOOST_CHECK_THROW(LpPacket{makeLpPacket(fields)}, LpPacket::Error);
+
+    // an integer of 3 bytes
+    fields.clear();
+    writeElement(fields, tlv::LP_CONGESTION_MARK, {1, 2, 3});
+    BOOST_CHECK_THROW(LpPacket{makeLpPacket(fields)}, LpPacket::Error);
+
+    // a FragIndex not below FragCount, a FragCount of 0
+    fields.clear();
+    tlv::writeNonNegativeInteger(fields, tlv::LP_SEQUENCE, 1);
+    tlv::writeNonNegativeInteger(fields, tlv::LP_FRAG_INDEX, 2);
+    tlv::writeNonNegativeInteger(fields, tlv::LP_FRAG_COUNT, 2);
+    BOOST_CHECK_THROW(LpPacket{makeLpPacket(fields)}, LpPacket::Error);
+    fields.clear();
+    tlv::writeNonNegativeInteger(fields, tlv::LP_FRAG_COUNT, 0);
+    BOOST_CHECK_THROW(LpPacket{makeLpPacket(fields)}, LpPacket::Error);
+
+    // fragments without Sequence
+    fields.clear();
+    tlv::writeNonNegativeInteger(fields, tlv::LP_FRAG_INDEX, 0);
+    tlv::writeNonNegativeInteger(fields, tlv::LP_FRAG_COUNT, 2);
+    BOOST_CHECK_THROW(LpPacket{makeLpPacket(fields)}, LpPacket::Error);
+}
+
+BOOST_AUTO_TEST_CASE(fragment_packet) {
+    ndn::Block data = makeData(8000);
+    LpHeaders headers;
+    headers.pit_token = "token";
+    uint64_t sequence = 1000;
+    auto fragments = LpPacket::fragment(LpPacket::encode(data, headers), 1500, sequence);
+
+    BOOST_REQUIRE_GT(fragments.size(), 5);
+    BOOST_CHECK_EQUAL(sequence, 1000 + fragments.size());
+    std::string reassembled;
+    for (size_t i = 0; i < fragments.size(); ++i) {
+        BOOST_CHECK_LE(fragments[i].size(), 1500);
+        LpPacket fragment(fragments[i]);
+        BOOST_CHECK_EQUAL(fragment.getSequence(), 1000 + i);
+        BOOST_CHECK_EQUAL(fragment.getFragIndex(), i);
+        BOOST_CHECK_EQUAL(fragment.getFragCount(), fragments.size());
+        // the headers only go with the first fragment
+        BOOST_CHECK_EQUAL(fragment.getHeaders().pit_token, i == 0 ? "token" : "");
+        reassembled += toString(fragment.getFragmentData(), fragment.getFragmentSize());
+    }
+    BOOST_CHECK(reassembled == toString(data.wire(), data.size()));
+}
+
+BOOST_AUTO_TEST_CASE(fragment_errors) {
+    uint64_t sequence = 0;
+    BOOST_CHECK_THROW(LpPacket::fragment(makeData(8000), 40, sequence), LpPacket::Error);
+
+    auto fragments = LpPacket::fragment(makeData(8000), 1500, sequence);
+    BOOST_CHECK_THROW(LpPacket::fragment(fragments[0], 1500, sequence), LpPacket::Error);
+    BOOST_CHECK_THROW(LpPacket::fragment(makeLpPacket({}), 1500, sequence), LpPacket::Error);
+}
@@ -0,0 +1,225 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// LpReassembler: fragments in and out of order, duplicates, a Sequence wrapping around and the bounds on the packets
+// being rebuilt
+
+#define BOOST_TEST_MODULE lp_reassembler_test
+#include <boost/test/included/unit_test.hpp>
+
+#include "../tlv/lp_reassembler.h"
+#include "../tlv/tlv.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint8_t CONTENT = 0x15;
+
+static ndn::Block makeData(size_t size, uint8_t seed) {
+    std::vector<uint8_t> value;
+    tlv::writeVarNumber(value, CONTENT);
+    tlv::writeVarNumber(value, size - 8);
+    for (size_t i = 0; i < size - 8; ++i) {
+        value.push_back((uint8_t)(i * 7 + seed));
+    }
+    std::vector<uint8_t> wire;
+    tlv::writeVarNumber(wire, tlv::DATA);
+    tlv::writeVarNumber(wire, value.size());
+    wire.insert(wire.end(), value.begin(), value.end());
+    return ndn::Block(wire.data(), wire.size());
+}
+
+static std::vector<ndn::Block> makeFragments(const ndn::Block &data, uint64_t &sequence, const std::string &pit_token = "") {
+    LpHeaders headers;
+    headers.pit_token = pit_token;
+    return LpPacket::fragment(LpPacket::encode(data, headers), 1500, sequence);
+}
+
+static bool isSame(const ndn::Block &a, const ndn::Block &b) {
+    return a.size() == b.size() && std::equal(a.wire(), a.wire() + a.size(), b.wire());
+}
+
+// feed the fragments in the given order, return the number of packets completed
+static size_t receive(LpReassembler &reassembler, const std::vector<ndn::Block> &fragments, ndn::Block &packet,
+                      LpHeaders &headers) {
+    size_t completed = 0;
+    for (const auto &fragment : fragments) {
+        if (reassembler.receive(LpPacket(fragment), packet, headers)) {
+            ++completed;
+        }
+    }
+    return completed;
+}
+
+BOOST_AUTO_TEST_CASE(in_order) {
+    ndn::Block data = makeData(8000, 1);
+    uint64_t sequence = 0;
+    auto fragments = makeFragments(data, sequence, "token");
+    LpReassembler reassembler;
+    ndn::Block packet;
+    LpHeaders headers;
+
+    BOOST_CHECK_EQUAL(receive(reassembler, fragments, packet, headers), 1);
+    BOOST_CHECK(isSame(packet, data));
+    BOOST_CHECK_EQUAL(headers.pit_token, "token");
+    BOOST_CHECK_EQUAL(reassembler.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(out_of_order) {
+    ndn::Block data = makeData(8000, 2);
+    uint64_t sequence = 500;
+    auto fragments = makeFragments(data, sequence, "token");
+    std::mt19937 random(42);
+    LpReassembler reassembler;
+    ndn::Block packet;
+    LpHeaders headers;
+
+    std::reverse(fragments.begin(), fragments.end());
+    BOOST_CHECK_EQUAL(receive(reassembler, fragments, packet, headers), 1);
+    BOOST_CHECK(isSame(packet, data));
+    // the headers of the first fragment, received last
+    BOOST_CHECK_EQUAL(headers.pit_token, "token");
+
+    std::shuffle(fragments.begin(), fragments.end(), random);
+    BOOST_CHECK_EQUAL(receive(reassembler, fragments, packet, headers), 1);
+    BOOST_CHECK(isSame(packet, data));
+    BOOST_CHECK_EQUAL(reassembler.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(interleaved_packets) {
+    ndn::Block first = makeData(5000, 3);
+    ndn::Block second = makeData(4000, 4);
+    uint64_t sequence = 0;
+    auto first_fragments = makeFragments(first, sequence);
+    auto second_fragments = makeFragments(second, sequence);
+    LpReassembler reassembler;
+    ndn::Block packet;
+    LpHeaders headers;
+
+    // all the fragments but the last of the first packet, then those of the second packet
+    BOOST_CHECK_EQUAL(receive(reassembler, std::vector<ndn::Block>(first_fragments.begin(), first_fragments.end() - 1),
+                              packet, headers), 0);
+    BOOST_CHECK_EQUAL(receive(reassembler, second_fragments, packet, headers), 1);
+    BOOST_CHECK(isSame(packet, second));
+    BOOST_CHECK_EQUAL(receive(reassembler, {first_fragments.back()}, packet, headers), 1);
+    BOOST_CHECK(isSame(packet, first));
+}
+
+BOOST_AUTO_TEST_CASE(duplicate_fragments) {
+    ndn::Block data = makeData(5000, 5);
+    uint64_t sequence = 0;
+    auto fragments = makeFragments(data, sequence);
+    LpReassembler reassembler;
+    ndn::Block packet;
+    LpHeaders headers;
+
+    std::vector<ndn::Block> duplicated;
+    for (const auto &fragment : fragments) {
+        duplicated.push_back(fragment);
+        duplicated.push_back(fragment);
+    }
+    duplicated.pop_back();
+    BOOST_CHECK_EQUAL(receive(reassembler, duplicated, packet, headers), 1);
+    BOOST_CHECK(isSame(packet, data));
+}
+
+BOOST_AUTO_TEST_CASE(sequence_wrap) {
+    ndn::Block data = makeData(8000, 6);
+    // the Sequence goes past its maximum in the middle of the packet
+    uint64_t sequence = std::numeric_limits<uint64_t>::max() - 2;
+    auto fragments = makeFragments(data, sequence);
+    LpReassembler reassembler;
+    ndn::Block packet;
+    LpHeaders headers;
+
+    BOOST_REQUIRE_GT(fragments.size(), 3);
+    BOOST_CHECK_EQUAL(LpPacket(fragments.back()).getSequence(), fragments.size() - 4);
+    std::reverse(fragments.begin(), fragments.end());
+    BOOST_CHECK_EQUAL(receive(reassembler, fragments, packet, headers), 1);
+    BOOST_CHECK(isSame(packet, data));
+}
+
+BOOST_AUTO_TEST_CASE(frag_count_mismatch) {
+    uint64_t sequence = 0;
+    auto fragments = makeFragments(makeData(5000, 7), sequence);
+    // another packet whose fragments claim the same first Sequence
+    sequence = 0;
+    auto other = makeFragments(makeData(8000, 7), sequence);
+    LpReassembler reassembler;
+    ndn::Block packet;
+    LpHeaders headers;
+
+    BOOST_CHECK(!reassembler.receive(LpPacket(fragments[0]), packet, headers));
+    BOOST_CHECK_THROW(reassembler.receive(LpPacket(other[1]), packet, headers), LpPacket::Error);
+    BOOST_CHECK_EQUAL(reassembler.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(too_many_fragments) {
+    uint64_t sequence = 0;
+    // about 80 fragments of 100 bytes
+    auto fragments = LpPacket::fragment(makeData(8000, 8), 150, sequence);
+    LpReassembler reassembler;
+    ndn::Block packet;
+    LpHeaders headers;
+
+    BOOST_REQUIRE_GT(fragments.size(), (size_t)LpReassembler::MAX_FRAGMENTS);
+    BOOST_CHECK_THROW(reassembler.receive(LpPacket(fragments[0]), packet, headers), LpPacket::Error);
+    BOOST_CHECK_EQUAL(reassembler.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(partial_packets_bounded) {
+    uint64_t sequence = 0;
+    std::vector<std::vector<ndn::Block>> packets;
+    for (size_t i = 0; i <= LpReassembler::MAX_PARTIAL_PACKETS; ++i) {
+        packets.push_back(makeFragments(makeData(3000, (uint8_t)i), sequence));
+    }
+    LpReassembler reassembler;
+    ndn::Block packet;
+    LpHeaders headers;
+
+    for (const auto &fragments : packets) {
+        reassembler.receive(LpPacket(fragments[0]), packet, headers);
+        BOOST_CHECK_LE(reassembler.size(), (size_t)LpReassembler::MAX_PARTIAL_PACKETS);
+    }
+    // the first packet was given up to make room for the last one
+    auto &first = packets.front();
+    BOOST_CHECK_EQUAL(receive(reassembler, std::vector<ndn::Block>(first.begin() + 1, first.end()), packet, headers), 0);
+    auto &last = packets.back();
+    BOOST_CHECK_EQUAL(receive(reassembler, std::vector<ndn::Block>(last.begin() + 1, last.end()), packet, headers), 1);
+}
+
+BOOST_AUTO_TEST_CASE(reassembly_timeout) {
+    uint64_t sequence = 0;
+    auto fragments = makeFragments(makeData(5000, 9), sequence);
+    LpReassembler reassembler;
+    ndn::Block packet;
+    LpHeaders headers;
+
+    BOOST_CHECK_EQUAL(receive(reassembler, std::vector<ndn::Block>(fragments.begin(), fragments.end() - 1), packet,
+                              headers), 0);
+    BOOST_CHECK_EQUAL(reassembler.size(), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(LpReassembler::REASSEMBLY_TIMEOUT.count() + 50));
+    // the late fragment starts a new packet, the expired one is gone
+    BOOST_CHECK_EQUAL(receive(reassembler, {fragments.back()}, packet, headers), 0);
+    BOOST_CHECK_EQUAL(reassembler.size(), 1);
+}
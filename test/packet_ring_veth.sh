@@ -0,0 +1,15 @@
+#!/bin/sh
+# runs packet_ring_veth_test between the two ends of a veth pair created for it, as root (or with CAP_NET_ADMIN and
+# CAP_NET_RAW), from the root of the repository once the test is built: make packet_ring_veth_test
+set -e
+
+TEST=${1:-bin/packet_ring_veth_test}
+IF0=ndnfwveth0
+IF1=ndnfwveth1
+
+ip link add "$IF0" type veth peer name "$IF1"
+trap 'ip link del "$IF0"' EXIT
+ip link set "$IF0" up
+ip link set "$IF1" up
+
+"$TEST" "$IF0" "$IF1"
@@ -0,0 +1,163 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// PacketRing between the two ends of a veth pair (see packet_ring_veth.sh): frames of any size sent through the tx ring
+// of one end are all received once on the other end and never looped back, and the frames received by rings sharing a
+// fanout group are spread by source address, each address always reaching the same ring
+// usage: packet_ring_veth_test <interface> <peer interface>
+
+#include "../network/packet_ring.h"
+
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+static const uint16_t ETHERTYPE_NDN = 0x8624;
+static const size_t FRAMES = 1000;
+static const size_t SOURCES = 16;
+static const size_t FRAMES_PER_SOURCE = 20;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+    std::cout << (condition ? "[ OK ] " : "[FAIL] ") << what << std::endl;
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// hand every frame received within timeout ms to the callback
+static void drain(PacketRing &ring, const PacketRing::FrameCallback &callback, int timeout) {
+    for (int i = 0; i < timeout / 10; ++i) {
+        pollfd fd = {ring.getFd(), POLLIN, 0};
+        poll(&fd, 1, 10);
+        while (ring.receive(callback, PacketRing::RX_BLOCK_COUNT)) {
+        }
+    }
+}
+
+static void testTransfer(const std::string &interface, const std::string &peer) {
+    PacketRing sender(interface, ETHERTYPE_NDN);
+    PacketRing receiver(peer, ETHERTYPE_NDN);
+    std::vector<uint8_t> small = {0x05, 0x03, 0x07, 0x01, 0x08};
+    std::vector<uint8_t> large(sender.getMtu(), 0x06);
+
+    size_t sent_bytes = 0;
+    for (size_t i = 0; i < FRAMES;) {
+        const std::vector<uint8_t> &payload = i % 2 ? small : large;
+        if (!sender.push(receiver.getAddress(), payload.data(), payload.size())) {
+            // the tx ring is full, wait for the kernel to release frames
+            sender.send();
+            pollfd fd = {sender.getFd(), POLLOUT, 0};
+            poll(&fd, 1, 1000);
+            continue;
+        }
+        sent_bytes += payload.size();
+        if (++i % 64 == 0) {
+            sender.send();
+        }
+    }
+    sender.send();
+
+    size_t frames = 0;
+    size_t bytes = 0;
+    drain(receiver, [&](const PacketRing::MacAddress &source, const uint8_t *payload, size_t size) {
+        ++frames;
+        // the small frames are padded to the minimum size
+        bytes += size == PacketRing::MIN_FRAME_SIZE - ETH_HLEN ? small.size() : size;
+    }, 500);
+    check(frames == FRAMES, "all the frames are received (" + std::to_string(frames) + "/" + std::to_string(FRAMES) + ")");
+    check(bytes == sent_bytes, "with their payload");
+
+    size_t echoes = 0;
+    drain(sender, [&](const PacketRing::MacAddress&, const uint8_t*, size_t) { ++echoes; }, 50);
+    check(echoes == 0, "none is looped back to the sender");
+}
+
+static void testFanout(const std::string &interface, const std::string &peer) {
+    int group = getpid() & 0xffff;
+    PacketRing first(peer, ETHERTYPE_NDN, group);
+    PacketRing second(peer, ETHERTYPE_NDN, group);
+
+    // the frames come from several addresses, a plain packet socket is needed to forge them
+    int fd = socket(AF_PACKET, SOCK_RAW, htons(ETHERTYPE_NDN));
+    sockaddr_ll address;
+    std::memset(&address, 0, sizeof(address));
+    address.sll_family = AF_PACKET;
+    address.sll_protocol = htons(ETHERTYPE_NDN);
+    address.sll_ifindex = if_nametoindex(interface.c_str());
+    check(fd >= 0 && bind(fd, (sockaddr *)&address, sizeof(address)) == 0, "raw socket bound to " + interface);
+
+    for (size_t n = 0; n < FRAMES_PER_SOURCE; ++n) {
+        for (size_t i = 0; i < SOURCES; ++i) {
+            uint8_t frame[PacketRing::MIN_FRAME_SIZE] = {};
+            auto ethernet = (ethhdr *)frame;
+            std::copy(first.getAddress().begin(), first.getAddress().end(), ethernet->h_dest);
+            // locally administered unicast addresses
+            uint8_t source[ETH_ALEN] = {0x02, 0x00, 0x00, 0x00, (uint8_t)(i * 37), (uint8_t)i};
+            std::copy(source, source + ETH_ALEN, ethernet->h_source);
+            ethernet->h_proto = htons(ETHERTYPE_NDN);
+            frame[ETH_HLEN] = 0x05;
+            send(fd, frame, sizeof(frame), 0);
+        }
+    }
+    ::close(fd);
+
+    std::map<PacketRing::MacAddress, size_t> rings[2];
+    drain(first, [&](const PacketRing::MacAddress &source, const uint8_t*, size_t) { ++rings[0][source]; }, 300);
+    drain(second, [&](const PacketRing::MacAddress &source, const uint8_t*, size_t) { ++rings[1][source]; }, 50);
+
+    size_t frames = 0;
+    bool split = false;
+    for (const auto &ring : rings) {
+        for (const auto &source : ring) {
+            frames += source.second;
+            split |= source.second != FRAMES_PER_SOURCE;
+        }
+    }
+    check(frames == SOURCES * FRAMES_PER_SOURCE, "all the frames are received once by the group (" +
+          std::to_string(frames) + "/" + std::to_string(SOURCES * FRAMES_PER_SOURCE) + ")");
+    check(!split, "the frames of an address all reach the same ring");
+    check(!rings[0].empty() && !rings[1].empty(), "both rings receive frames (" + std::to_string(rings[0].size()) +
+          " and " + std::to_string(rings[1].size()) + " addresses)");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <interface> <peer interface>" << std::endl;
+        return 1;
+    }
+    try {
+        testTransfer(argv[1], argv[2]);
+        testFanout(argv[1], argv[2]);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+/*
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// SendQueue: limits in packets and in bytes, the overflow policies, and the hysteresis of the ReadGate it closes
+
+#define BOOST_TEST_MODULE send_queue_test
+#include <boost/test/included/unit_test.hpp>
+
+#include "../network/send_queue.h"
+
+#include <string>
+
+static const size_t MAX_PACKETS = 8;
+static const size_t MAX_BYTES = 1000;
+
+static Message makeMessage(size_t size, char tag = 'x') {
+    return Message(std::string(size, tag));
+}
+
+// the limits are global, every test sets its own
+struct Limits {
+    explicit Limits(SendQueueLimits::Policy policy) {
+        SendQueueLimits::set(MAX_PACKETS, MAX_BYTES, policy);
+    }
+
+    ~Limits() {
+        SendQueueLimits::set(SendQueueLimits::DEFAULT_MAX_PACKETS, SendQueueLimits::DEFAULT_MAX_BYTES,
+                             SendQueueLimits::DROP_TAIL);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(drop_tail) {
+    Limits limits(SendQueueLimits::DROP_TAIL);
+    std::atomic<uint64_t> dropped(0);
+    SendQueue<Message> queue(dropped);
+
+    for (size_t i = 0; i < MAX_PACKETS; ++i) {
+        BOOST_CHECK_EQUAL(queue.push(makeMessage(10, 'a' + i)), SendQueue<Message>::QUEUED);
+    }
+    BOOST_CHECK_EQUAL(queue.push(makeMessage(10, 'z')), SendQueue<Message>::DROPPED);
+    BOOST_CHECK_EQUAL(queue.size(), MAX_PACKETS);
+    BOOST_CHECK_EQUAL(dropped, 1);
+    // the oldest packets are kept
+    BOOST_CHECK_EQUAL(queue.front().data()[0], 'a');
+}
+
+BOOST_AUTO_TEST_CASE(byte_limit) {
+    Limits limits(SendQueueLimits::DROP_TAIL);
+    std::atomic<uint64_t> dropped(0);
+    SendQueue<Message> queue(dropped);
+
+    BOOST_CHECK_EQUAL(queue.push(makeMessage(600)), SendQueue<Message>::QUEUED);
+    BOOST_CHECK_EQUAL(queue.push(makeMessage(400)), SendQueue<Message>::QUEUED);
+    BOOST_CHECK_EQUAL(queue.push(makeMessage(1)), SendQueue<Message>::DROPPED);
+    BOOST_CHECK_EQUAL(queue.bytes(), MAX_BYTES);
+    queue.pop();
+    BOOST_CHECK_EQUAL(queue.bytes(), 400);
+
+    // a packet larger than the limit still goes through an empty queue
+    SendQueue<Message> empty(dropped);
+    BOOST_CHECK_EQUAL(empty.push(makeMessage(MAX_BYTES * 2)), SendQueue<Message>::QUEUED);
+}
+
+BOOST_AUTO_TEST_CASE(drop_oldest) {
+    Limits limits(SendQueueLimits::DROP_OLDEST);
+    std::atomic<uint64_t> dropped(0);
+    SendQueue<Message> queue(dropped);
+
+    for (size_t i = 0; i < MAX_PACKETS; ++i) {
+        queue.push(makeMessage(10, 'a' + i));
+    }
+    // the first two packets are being written, the third one is dropped to make room
+    queue.setInFlight(2);
+    BOOST_CHECK_EQUAL(queue.push(makeMessage(10, 'z')), SendQueue<Message>::DROPPED);
+    BOOST_CHECK_EQUAL(queue.size(), MAX_PACKETS);
+    BOOST_CHECK_EQUAL(dropped, 1);
+    std::string order;
+    for (const auto &message : queue) {
+        order += (char)message.data()[0];
+    }
+    BOOST_CHECK_EQUAL(order, "abdefghz");
+
+    // all the packets are being written, the new one is dropped
+    queue.setInFlight(MAX_PACKETS);
+    BOOST_CHECK_EQUAL(queue.push(makeMessage(10, 'y')), SendQueue<Message>::DROPPED);
+    BOOST_CHECK_EQUAL(queue.size(), MAX_PACKETS);
+    BOOST_CHECK_EQUAL(dropped, 2);
+    BOOST_CHECK_EQUAL((char)(queue.begin() + MAX_PACKETS - 1)->data()[0], 'z');
+}
+
+BOOST_AUTO_TEST_CASE(close_policy) {
+    Limits limits(SendQueueLimits::CLOSE);
+    std::atomic<uint64_t> dropped(0);
+    SendQueue<Message> queue(dropped);
+
+    for (size_t i = 0; i < MAX_PACKETS; ++i) {
+        queue.push(makeMessage(10));
+    }
+    BOOST_CHECK_EQUAL(queue.push(makeMessage(10)), SendQueue<Message>::OVERFLOWED);
+    BOOST_CHECK_EQUAL(queue.size(), MAX_PACKETS);
+    BOOST_CHECK_EQUAL(dropped, 1);
+}
+
+BOOST_AUTO_TEST_CASE(gate_hysteresis) {
+    Limits limits(SendQueueLimits::DROP_TAIL);
+    std::atomic<uint64_t> dropped(0);
+    Backpressure backpressure;
+    backpressure.gate = std::make_shared<ReadGate>();
+    backpressure.high_packets = 4;
+    backpressure.high_bytes = MAX_BYTES;
+    SendQueue<Message> queue(dropped, &backpressure);
+
+    for (size_t i = 0; i < 3; ++i) {
+        queue.push(makeMessage(10));
+    }
+    BOOST_CHECK(backpressure.gate->isOpen());
+    queue.push(makeMessage(10));
+    BOOST_CHECK(!backpressure.gate->isOpen());
+
+    size_t resumed = 0;
+    backpressure.gate->wait([&resumed]() { ++resumed; });
+    BOOST_CHECK_EQUAL(resumed, 0);
+
+    // stays closed until the queue is below a quarter of the high mark
+    queue.pop();
+    queue.pop();
+    queue.pop();
+    BOOST_CHECK(!backpressure.gate->isOpen());
+    queue.push(makeMessage(10));
+    queue.pop();
+    BOOST_CHECK(!backpressure.gate->isOpen());
+    queue.pop();
+    BOOST_CHECK(backpressure.gate->isOpen());
+    BOOST_CHECK_EQUAL(resumed, 1);
+
+    // closed again by the bytes alone
+    queue.push(makeMessage(MAX_BYTES));
+    BOOST_CHECK(!backpressure.gate->isOpen());
+    queue.pop();
+    BOOST_CHECK(backpressure.gate->isOpen());
+}
+
+BOOST_AUTO_TEST_CASE(gate_wait) {
+    ReadGate gate;
+    size_t resumed = 0;
+    gate.wait([&resumed]() { ++resumed; });
+    BOOST_CHECK_EQUAL(resumed, 1);
+
+    gate.close();
+    gate.wait([&resumed]() { ++resumed; });
+    gate.wait([&resumed]() { ++resumed; });
+    BOOST_CHECK_EQUAL(resumed, 1);
+    gate.open();
+    BOOST_CHECK_EQUAL(resumed, 3);
+    // the handlers only run once
+    gate.close();
+    gate.open();
+    BOOST_CHECK_EQUAL(resumed, 3);
+}
@@ -0,0 +1,161 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "interest_view.h"
+
+#include <cstring>
+
+#include "tlv.h"
+
+// read the type and the length of the next element, pos is moved to its value
+static void readHeader(const uint8_t *&pos, const uint8_t *end, uint64_t &type, uint64_t &length) {
+    if (!tlv::readVarNumber(pos, end, type) || !tlv::readVarNumber(pos, end, length) || length > (uint64_t)(end - pos)) {
+        throw InterestView::Error("truncated element in Interest");
+    }
+}
+
+InterestView::InterestView(const ndn::Block &wire)
+        : _wire(wire)
+        , _interest_lifetime(ndn::DEFAULT_INTEREST_LIFETIME) {
+    if (_wire.type() != tlv::INTEREST) {
+        throw Error("not an Interest");
+    }
+
+    const uint8_t *begin = _wire.wire();
+    const uint8_t *pos = _wire.value();
+    const uint8_t *end = pos + _wire.value_size();
+    uint64_t type;
+    uint64_t length;
+
+    // the Name must be the first element
+    const uint8_t *name_begin = pos;
+    readHeader(pos, end, type, length);
+    if (type != tlv::NAME) {
+        throw Error("Interest does not start with a Name");
+    }
+    if (length > MAX_NAME_LENGTH) {
+        throw Error("Interest name is too long");
+    }
+    const uint8_t *name_end = pos + length;
+    _name_offset = name_begin - begin;
+    _name_size = name_end - name_begin;
+    _name_value_offset = pos - begin;
+
+    while (pos < name_end) {
+        readHeader(pos, name_end, type, length);
+        if (_components.size() == MAX_NAME_COMPONENTS) {
+            throw Error("Interest name has too many components");
+        }
+        _components.emplace_back(pos - begin, length);
+        if (type != tlv::GENERIC_NAME_COMPONENT || length == 0) {
+            _plain_uri = false;
+        }
+        bool only_periods = true;
+        for (const uint8_t *c = pos; c < pos + length; ++c) {
+            // the only characters left unescaped by every ndn-cxx release
+            if (!(*c >= '0' && *c <= '9') && !(*c >= 'A' && *c <= 'Z') && !(*c >= 'a' && *c <= 'z') &&
+                *c != '-' && *c != '.' && *c != '_') {
+                _plain_uri = false;
+            }
+            only_periods &= *c == '.';
+        }
+        if (only_periods) {
+            _plain_uri = false;
+        }
+        pos += length;
+    }
+
+    // only look for the nonce and the lifetime in the other elements
+    while (pos < end) {
+        readHeader(pos, end, type, length);
+        if (type == tlv::NONCE) {
+            if (length != 4) {
+                throw Error("invalid Nonce length");
+            }
+            std::memcpy(&_nonce, pos, sizeof(_nonce));
+            _has_nonce = true;
+        } else if (type == tlv::INTEREST_LIFETIME) {
+            if (length != 1 && length != 2 && length != 4 && length != 8) {
+                throw Error("invalid InterestLifetime length");
+            }
+            uint64_t lifetime = 0;
+            for (const uint8_t *c = pos; c < pos + length; ++c) {
+                lifetime <<= 8;
+                lifetime += *c;
+            }
+            _interest_lifetime = ndn::time::milliseconds(lifetime);
+        }
+        pos += length;
+    }
+}
+
+const ndn::Block& InterestView::wireEncode() const {
+    return _wire;
+}
+
+size_t InterestView::getNameSize() const {
+    return _components.size();
+}
+
+ndn::Name InterestView::getName() const {
+    return ndn::Name(ndn::Block(_wire, _wire.begin() + _name_offset, _wire.begin() + _name_offset + _name_size));
+}
+
+std::string InterestView::getNameUri() const {
+    if (!_plain_uri) {
+        return getName().toUri();
+    }
+    if (_components.empty()) {
+        return "/";
+    }
+    std::string uri;
+    uri.reserve(_name_size);
+    const char *begin = (const char *)_wire.wire();
+    for (const auto &component : _components) {
+        uri.push_back('/');
+        uri.append(begin + component.first, component.second);
+    }
+    return uri;
+}
+
+const uint8_t* InterestView::getNameValue() const {
+    return _wire.wire() + _name_value_offset;
+}
+
+size_t InterestView::getNameValueSize() const {
+    return _name_offset + _name_size - _name_value_offset;
+}
+
+bool InterestView::hasNonce() const {
+    return _has_nonce;
+}
+
+uint32_t InterestView::getNonce() const {
+    return _nonce;
+}
+
+ndn::time::milliseconds InterestView::getInterestLifetime() const {
+    return _interest_lifetime;
+}
+
+const std::string& InterestView::getPitToken() const {
+    return _pit_token;
+}
+
+void InterestView::setPitToken(const std::string &pit_token) {
+    _pit_token = pit_token;
+}
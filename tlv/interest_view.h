@@ -0,0 +1,85 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/interest.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// read-only view over the wire of an Interest, only the name component offsets, the nonce and the lifetime are
+// extracted so the firewall can filter and aggregate without decoding the whole packet, the wire is kept untouched
+class InterestView {
+public:
+    class Error : public std::runtime_error {
+    public:
+        explicit Error(const std::string &what) : std::runtime_error(what) {
+
+        }
+    };
+
+    // hard limits, any Interest exceeding them is rejected before reaching the firewall
+    static const size_t MAX_NAME_COMPONENTS = 64;
+    static const size_t MAX_NAME_LENGTH = 2048;
+
+private:
+    ndn::Block _wire;
+    // offset (from the beginning of the wire) and size of the Name TLV
+    size_t _name_offset;
+    size_t _name_size;
+    // offset of the first component, the components follow each other until the end of the Name TLV
+    size_t _name_value_offset;
+    // offset and size of each name component value
+    std::vector<std::pair<size_t, size_t>> _components;
+    // true if the uri can be built from the raw components without escaping
+    bool _plain_uri = true;
+    bool _has_nonce = false;
+    uint32_t _nonce = 0;
+    ndn::time::milliseconds _interest_lifetime;
+    // NDNLPv2 PitToken the Interest came with, empty if none
+    std::string _pit_token;
+
+public:
+    explicit InterestView(const ndn::Block &wire);
+
+    ~InterestView() = default;
+
+    const ndn::Block& wireEncode() const;
+
+    size_t getNameSize() const;
+
+    ndn::Name getName() const;
+
+    std::string getNameUri() const;
+
+    // the components of the name as they are on the wire, without the header of the Name TLV
+    const uint8_t* getNameValue() const;
+
+    size_t getNameValueSize() const;
+
+    bool hasNonce() const;
+
+    uint32_t getNonce() const;
+
+    ndn::time::milliseconds getInterestLifetime() const;
+
+    const std::string& getPitToken() const;
+
+    void setPitToken(const std::string &pit_token);
+};
@@ -0,0 +1,275 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "lp_packet.h"
+
+#include <algorithm>
+
+#include "tlv.h"
+
+// read the type and the length of the next element, pos is moved to its value
+static void readHeader(const uint8_t *&pos, const uint8_t *end, uint64_t &type, uint64_t &length) {
+    if (!tlv::readVarNumber(pos, end, type) || !tlv::readVarNumber(pos, end, length) || length > (uint64_t)(end - pos)) {
+        throw LpPacket::Error("truncated element in LpPacket");
+    }
+}
+
+static uint64_t readInteger(const uint8_t *pos, uint64_t length, const char *field) {
+    uint64_t number;
+    if (!tlv::readNonNegativeInteger(pos, length, number)) {
+        throw LpPacket::Error(std::string("invalid ") + field + " length");
+    }
+    return number;
+}
+
+// header fields written before the Fragment, their size is known in advance to split the packet
+static size_t sizeOfHeaders(const LpHeaders &headers) {
+    size_t size = 0;
+    if (!headers.pit_token.empty()) {
+        size += 1 + tlv::sizeOfVarNumber(headers.pit_token.size()) + headers.pit_token.size();
+    }
+    if (headers.nack) {
+        size += tlv::sizeOfVarNumber(tlv::LP_NACK) + 1;
+        if (headers.nack_reason != 0) {
+            size += tlv::sizeOfVarNumber(tlv::LP_NACK_REASON) + 1 + 8;
+        }
+    }
+    if (headers.congestion_mark != 0) {
+        size += tlv::sizeOfVarNumber(tlv::LP_CONGESTION_MARK) + 1 + 8;
+    }
+    return size;
+}
+
+static void writeHeaders(std::vector<uint8_t> &buffer, const LpHeaders &headers) {
+    if (!headers.pit_token.empty()) {
+        tlv::writeVarNumber(buffer, tlv::LP_PIT_TOKEN);
+        tlv::writeVarNumber(buffer, headers.pit_token.size());
+        buffer.insert(buffer.end(), headers.pit_token.begin(), headers.pit_token.end());
+    }
+    if (headers.nack) {
+        std::vector<uint8_t> nack;
+        if (headers.nack_reason != 0) {
+            tlv::writeNonNegativeInteger(nack, tlv::LP_NACK_REASON, headers.nack_reason);
+        }
+        tlv::writeVarNumber(buffer, tlv::LP_NACK);
+        tlv::writeVarNumber(buffer, nack.size());
+        buffer.insert(buffer.end(), nack.begin(), nack.end());
+    }
+    if (headers.congestion_mark != 0) {
+        tlv::writeNonNegativeInteger(buffer, tlv::LP_CONGESTION_MARK, headers.congestion_mark);
+    }
+}
+
+static void writeFragment(std::vector<uint8_t> &buffer, const uint8_t *data, size_t size) {
+    tlv::writeVarNumber(buffer, tlv::LP_FRAGMENT);
+    tlv::writeVarNumber(buffer, size);
+    buffer.insert(buffer.end(), data, data + size);
+}
+
+// the LpPacket type and length are only known once the fields are written, they are put in front of them
+static ndn::Block finalize(const std::vector<uint8_t> &fields) {
+    auto buffer = std::make_shared<ndn::Buffer>();
+    buffer->reserve(1 + tlv::sizeOfVarNumber(fields.size()) + fields.size());
+    tlv::writeVarNumber(*buffer, tlv::LP_PACKET);
+    tlv::writeVarNumber(*buffer, fields.size());
+    buffer->insert(buffer->end(), fields.begin(), fields.end());
+    return ndn::Block(buffer);
+}
+
+LpPacket::LpPacket(const ndn::Block &wire) : _wire(wire) {
+    if (_wire.type() != tlv::LP_PACKET) {
+        throw Error("not an LpPacket");
+    }
+
+    const uint8_t *begin = _wire.wire();
+    const uint8_t *pos = _wire.value();
+    const uint8_t *end = pos + _wire.value_size();
+    uint64_t type;
+    uint64_t length;
+    bool has_frag_index = false;
+
+    while (pos < end) {
+        readHeader(pos, end, type, length);
+        if (_has_fragment) {
+            throw Error("Fragment must be the last field of an LpPacket");
+        }
+        switch (type) {
+            case tlv::LP_FRAGMENT:
+                _fragment_offset = pos - begin;
+                _fragment_size = length;
+                _has_fragment = true;
+                break;
+            case tlv::LP_SEQUENCE:
+                _sequence = readInteger(pos, length, "Sequence");
+                _has_sequence = true;
+                break;
+            case tlv::LP_FRAG_INDEX:
+                _frag_index = readInteger(pos, length, "FragIndex");
+                has_frag_index = true;
+                break;
+            case tlv::LP_FRAG_COUNT:
+                _frag_count = readInteger(pos, length, "FragCount");
+                break;
+            case tlv::LP_PIT_TOKEN:
+                if (length == 0 || length > MAX_PIT_TOKEN_SIZE) {
+                    throw Error("invalid PitToken length");
+                }
+                _headers.pit_token.assign((const char *)pos, length);
+                break;
+            case tlv::LP_NACK: {
+                // in the ignorable range, but a Nack must not be taken for the Interest it carries
+                _headers.nack = true;
+                const uint8_t *nack_pos = pos;
+                const uint8_t *nack_end = pos + length;
+                uint64_t nack_type;
+                uint64_t nack_length;
+                while (nack_pos < nack_end) {
+                    readHeader(nack_pos, nack_end, nack_type, nack_length);
+                    if (nack_type == tlv::LP_NACK_REASON) {
+                        _headers.nack_reason = readInteger(nack_pos, nack_length, "NackReason");
+                    }
+                    nack_pos += nack_length;
+                }
+                break;
+            }
+            case tlv::LP_CONGESTION_MARK:
+                _headers.congestion_mark = readInteger(pos, length, "CongestionMark");
+                break;
+            default:
+                if (!tlv::isIgnorableLpField(type)) {
+                    throw Error("unknown field " + std::to_string(type) + " in LpPacket");
+                }
+                break;
+        }
+        pos += length;
+    }
+
+    if (_frag_count == 0 || _frag_index >= _frag_count) {
+        throw Error("invalid FragIndex or FragCount");
+    }
+    if (_frag_count > 1 && !_has_sequence) {
+        throw Error("fragmented LpPacket without Sequence");
+    }
+    if (has_frag_index && _frag_count == 1 && _frag_index != 0) {
+        throw Error("invalid FragIndex");
+    }
+}
+
+const ndn::Block& LpPacket::wireEncode() const {
+    return _wire;
+}
+
+bool LpPacket::hasFragment() const {
+    return _has_fragment;
+}
+
+ndn::Block LpPacket::getFragment() const {
+    auto begin = _wire.begin() + _fragment_offset;
+    return ndn::Block(_wire, begin, begin + _fragment_size);
+}
+
+const uint8_t* LpPacket::getFragmentData() const {
+    return _wire.wire() + _fragment_offset;
+}
+
+size_t LpPacket::getFragmentSize() const {
+    return _fragment_size;
+}
+
+bool LpPacket::hasSequence() const {
+    return _has_sequence;
+}
+
+uint64_t LpPacket::getSequence() const {
+    return _sequence;
+}
+
+uint64_t LpPacket::getFragIndex() const {
+    return _frag_index;
+}
+
+uint64_t LpPacket::getFragCount() const {
+    return _frag_count;
+}
+
+const LpHeaders& LpPacket::getHeaders() const {
+    return _headers;
+}
+
+ndn::Block LpPacket::encode(const ndn::Block &packet, const LpHeaders &headers) {
+    std::vector<uint8_t> fields;
+    fields.reserve(sizeOfHeaders(headers) + 1 + tlv::sizeOfVarNumber(packet.size()) + packet.size());
+    writeHeaders(fields, headers);
+    writeFragment(fields, packet.wire(), packet.size());
+    return finalize(fields);
+}
+
+ndn::Block LpPacket::encodeNack(const ndn::Block &interest, NackReason reason, const std::string &pit_token) {
+    LpHeaders headers;
+    headers.pit_token = pit_token;
+    headers.nack = true;
+    headers.nack_reason = reason;
+    return encode(interest, headers);
+}
+
+std::vector<ndn::Block> LpPacket::fragment(const ndn::Block &wire, size_t mtu, uint64_t &sequence) {
+    const uint8_t *data = wire.wire();
+    size_t size = wire.size();
+    LpHeaders headers;
+    if (wire.type() == tlv::LP_PACKET) {
+        LpPacket packet(wire);
+        if (!packet.hasFragment() || packet.getFragCount() > 1) {
+            throw Error("only an LpPacket holding a whole packet can be fragmented");
+        }
+        data = packet.getFragmentData();
+        size = packet.getFragmentSize();
+        headers = packet.getHeaders();
+    }
+
+    // worst case overhead of a fragment: LpPacket type and length, Sequence, FragIndex and FragCount, the headers and
+    // the Fragment type and length
+    size_t overhead = 1 + 5 + 3 * (1 + 1 + 8) + sizeOfHeaders(headers) + 1 + 5;
+    if (mtu <= overhead) {
+        throw Error("MTU too small to fragment");
+    }
+    size_t chunk = mtu - overhead;
+    size_t count = (size + chunk - 1) / chunk;
+
+    std::vector<ndn::Block> fragments;
+    fragments.reserve(count);
+    std::vector<uint8_t> fields;
+    fields.reserve(mtu);
+    for (size_t i = 0; i < count; ++i) {
+        fields.clear();
+        // the Sequence is a fixed-width integer
+        tlv::writeVarNumber(fields, tlv::LP_SEQUENCE);
+        tlv::writeVarNumber(fields, 8);
+        for (size_t j = 8; j > 0; --j) {
+            fields.push_back((uint8_t)(sequence >> (8 * (j - 1))));
+        }
+        ++sequence;
+        tlv::writeNonNegativeInteger(fields, tlv::LP_FRAG_INDEX, i);
+        tlv::writeNonNegativeInteger(fields, tlv::LP_FRAG_COUNT, count);
+        if (i == 0) {
+            writeHeaders(fields, headers);
+        }
+        size_t offset = i * chunk;
+        writeFragment(fields, data + offset, std::min(chunk, size - offset));
+        fragments.push_back(finalize(fields));
+    }
+    return fragments;
+}
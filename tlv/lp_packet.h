@@ -0,0 +1,108 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/encoding/block.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// NDNLPv2 header fields the firewall carries from one face to another
+struct LpHeaders {
+    // opaque, given back with the Data answering the Interest
+    std::string pit_token;
+    // the fragment is an Interest that could not be satisfied
+    bool nack = false;
+    uint64_t nack_reason = 0;
+    uint64_t congestion_mark = 0;
+
+    bool empty() const {
+        return pit_token.empty() && !nack && congestion_mark == 0;
+    }
+};
+
+// read-only view over the wire of an NDNLPv2 LpPacket, the fragment is not copied, known fields are checked and
+// unknown fields are ignored when the specification allows it
+class LpPacket {
+public:
+    class Error : public std::runtime_error {
+    public:
+        explicit Error(const std::string &what) : std::runtime_error(what) {
+
+        }
+    };
+
+    static const size_t MAX_PIT_TOKEN_SIZE = 32;
+
+    enum NackReason : uint64_t {
+        NACK_NONE = 0,
+        NACK_CONGESTION = 50,
+        NACK_DUPLICATE = 100,
+        NACK_NO_ROUTE = 150,
+    };
+
+private:
+    ndn::Block _wire;
+    // offset (from the beginning of the wire) and size of the Fragment value
+    size_t _fragment_offset = 0;
+    size_t _fragment_size = 0;
+    bool _has_fragment = false;
+    bool _has_sequence = false;
+    uint64_t _sequence = 0;
+    uint64_t _frag_index = 0;
+    uint64_t _frag_count = 1;
+    LpHeaders _headers;
+
+public:
+    explicit LpPacket(const ndn::Block &wire);
+
+    ~LpPacket() = default;
+
+    const ndn::Block& wireEncode() const;
+
+    // an LpPacket without fragment is an idle packet
+    bool hasFragment() const;
+
+    // the whole network packet, only valid when getFragCount() == 1
+    ndn::Block getFragment() const;
+
+    const uint8_t* getFragmentData() const;
+
+    size_t getFragmentSize() const;
+
+    bool hasSequence() const;
+
+    uint64_t getSequence() const;
+
+    uint64_t getFragIndex() const;
+
+    uint64_t getFragCount() const;
+
+    const LpHeaders& getHeaders() const;
+
+    // wrap a network packet with the given headers in a single LpPacket
+    static ndn::Block encode(const ndn::Block &packet, const LpHeaders &headers);
+
+    // answer an Interest with a Nack, the PitToken of the Interest (if any) is given back
+    static ndn::Block encodeNack(const ndn::Block &interest, NackReason reason, const std::string &pit_token);
+
+    // split a network packet or an LpPacket holding a whole one in LpPackets no larger than mtu, headers only go
+    // with the first fragment, sequence is the sequence number of the first fragment and is moved after the last one
+    static std::vector<ndn::Block> fragment(const ndn::Block &wire, size_t mtu, uint64_t &sequence);
+};
@@ -0,0 +1,95 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "lp_reassembler.h"
+
+#include <cstring>
+
+const ndn::time::milliseconds LpReassembler::REASSEMBLY_TIMEOUT {500};
+
+size_t LpReassembler::size() const {
+    return _partial_packets.size();
+}
+
+bool LpReassembler::receive(const LpPacket &fragment, ndn::Block &packet, LpHeaders &headers) {
+    uint64_t count = fragment.getFragCount();
+    uint64_t index = fragment.getFragIndex();
+    if (count > MAX_FRAGMENTS) {
+        throw LpPacket::Error("too many fragments");
+    }
+
+    auto now = ndn::time::steady_clock::now();
+    purge(now);
+
+    uint64_t key = fragment.getSequence() - index;
+    auto it = _partial_packets.find(key);
+    if (it == _partial_packets.end()) {
+        if (_partial_packets.size() == MAX_PARTIAL_PACKETS) {
+            // make room by giving up the packet that has waited the longest
+            auto oldest = _partial_packets.begin();
+            for (auto p = _partial_packets.begin(); p != _partial_packets.end(); ++p) {
+                if (p->second.expire_at < oldest->second.expire_at) {
+                    oldest = p;
+                }
+            }
+            _partial_packets.erase(oldest);
+        }
+        it = _partial_packets.emplace(key, PartialPacket()).first;
+        it->second.fragments.resize(count);
+        it->second.expire_at = now + REASSEMBLY_TIMEOUT;
+    }
+
+    PartialPacket &partial = it->second;
+    if (partial.fragments.size() != count) {
+        _partial_packets.erase(it);
+        throw LpPacket::Error("FragCount differs between fragments");
+    }
+    if (partial.fragments[index]) {
+        // duplicate
+        return false;
+    }
+    partial.size += fragment.getFragmentSize();
+    if (partial.size > ndn::MAX_NDN_PACKET_SIZE) {
+        _partial_packets.erase(it);
+        throw LpPacket::Error("reassembled packet is too large");
+    }
+    partial.fragments[index].reset(new LpPacket(fragment));
+    if (++partial.received < count) {
+        return false;
+    }
+
+    auto buffer = std::make_shared<ndn::Buffer>(partial.size);
+    size_t offset = 0;
+    for (const auto &f : partial.fragments) {
+        std::memcpy(buffer->data() + offset, f->getFragmentData(), f->getFragmentSize());
+        offset += f->getFragmentSize();
+    }
+    headers = partial.fragments[0]->getHeaders();
+    _partial_packets.erase(it);
+    packet = ndn::Block(buffer);
+    return true;
+}
+
+void LpReassembler::purge(const ndn::time::steady_clock::time_point &now) {
+    for (auto it = _partial_packets.begin(); it != _partial_packets.end();) {
+        if (it->second.expire_at <= now) {
+            it = _partial_packets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,60 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "lp_packet.h"
+
+// rebuild network packets from NDNLPv2 fragments received on one face, the number of packets being rebuilt and their
+// lifetime are bounded so a peer can't exhaust the memory with fragments that never complete
+class LpReassembler {
+public:
+    static const size_t MAX_PARTIAL_PACKETS = 16;
+    static const size_t MAX_FRAGMENTS = 64;
+    static const ndn::time::milliseconds REASSEMBLY_TIMEOUT;
+
+private:
+    struct PartialPacket {
+        std::vector<std::unique_ptr<LpPacket>> fragments;
+        size_t received = 0;
+        size_t size = 0;
+        ndn::time::steady_clock::time_point expire_at;
+    };
+
+    // indexed by the sequence of the first fragment
+    std::map<uint64_t, PartialPacket> _partial_packets;
+
+public:
+    LpReassembler() = default;
+
+    ~LpReassembler() = default;
+
+    size_t size() const;
+
+    // return true when the fragment completes a packet, packet and headers are then set
+    bool receive(const LpPacket &fragment, ndn::Block &packet, LpHeaders &headers);
+
+private:
+    void purge(const ndn::time::steady_clock::time_point &now);
+};
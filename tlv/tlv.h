@@ -0,0 +1,132 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace tlv {
+    enum Type : uint8_t {
+        INTEREST = 0x05,
+        DATA = 0x06,
+        NAME = 0x07,
+        GENERIC_NAME_COMPONENT = 0x08,
+        NONCE = 0x0A,
+        INTEREST_LIFETIME = 0x0C,
+        LP_PACKET = 0x64,
+    };
+
+    // NDNLPv2 fields
+    enum LpType : uint16_t {
+        LP_FRAGMENT = 0x50,
+        LP_SEQUENCE = 0x51,
+        LP_FRAG_INDEX = 0x52,
+        LP_FRAG_COUNT = 0x53,
+        LP_PIT_TOKEN = 0x62,
+        LP_NACK = 0x0320,
+        LP_NACK_REASON = 0x0321,
+        LP_CONGESTION_MARK = 0x0340,
+    };
+
+    // unknown NDNLPv2 header fields in [800, 959] with the two lowest bits set to 0 can be ignored
+    inline bool isIgnorableLpField(uint64_t type) {
+        return type >= 800 && type <= 959 && (type & 0x03) == 0;
+    }
+
+    // read a var-number (1, 3, 5 or 9 bytes) starting at pos, pos is moved after it
+    // return false if there is not enough bytes between pos and end
+    inline bool readVarNumber(const uint8_t *&pos, const uint8_t *end, uint64_t &number) {
+        if (pos >= end) {
+            return false;
+        }
+        size_t length;
+        switch (*pos) {
+            default:
+                number = *pos++;
+                return true;
+            case 0xFD:
+                length = 2;
+                break;
+            case 0xFE:
+                length = 4;
+                break;
+            case 0xFF:
+                length = 8;
+                break;
+        }
+        if (end - pos < (ptrdiff_t)length + 1) {
+            return false;
+        }
+        ++pos;
+        number = 0;
+        for (size_t i = 0; i < length; ++i) {
+            number <<= 8;
+            number += *pos++;
+        }
+        return true;
+    }
+
+    // read a non-negative integer (1, 2, 4 or 8 bytes) of the given length starting at pos
+    // return false if the length is not valid
+    inline bool readNonNegativeInteger(const uint8_t *pos, uint64_t length, uint64_t &number) {
+        if (length != 1 && length != 2 && length != 4 && length != 8) {
+            return false;
+        }
+        number = 0;
+        for (uint64_t i = 0; i < length; ++i) {
+            number <<= 8;
+            number += pos[i];
+        }
+        return true;
+    }
+
+    inline size_t sizeOfVarNumber(uint64_t number) {
+        return number < 0xFD ? 1 : number <= 0xFFFF ? 3 : number <= 0xFFFFFFFF ? 5 : 9;
+    }
+
+    inline void writeVarNumber(std::vector<uint8_t> &buffer, uint64_t number) {
+        size_t length;
+        if (number < 0xFD) {
+            buffer.push_back((uint8_t)number);
+            return;
+        } else if (number <= 0xFFFF) {
+            buffer.push_back(0xFD);
+            length = 2;
+        } else if (number <= 0xFFFFFFFF) {
+            buffer.push_back(0xFE);
+            length = 4;
+        } else {
+            buffer.push_back(0xFF);
+            length = 8;
+        }
+        for (size_t i = length; i > 0; --i) {
+            buffer.push_back((uint8_t)(number >> (8 * (i - 1))));
+        }
+    }
+
+    // write a whole element holding a non-negative integer on the smallest valid length
+    inline void writeNonNegativeInteger(std::vector<uint8_t> &buffer, uint64_t type, uint64_t number) {
+        size_t length = number <= 0xFF ? 1 : number <= 0xFFFF ? 2 : number <= 0xFFFFFFFF ? 4 : 8;
+        writeVarNumber(buffer, type);
+        writeVarNumber(buffer, length);
+        for (size_t i = length; i > 0; --i) {
+            buffer.push_back((uint8_t)(number >> (8 * (i - 1))));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tlv_framer.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "tlv.h"
+
+TlvFramer::TlvFramer()
+        : _chunk(std::make_shared<ndn::Buffer>(CHUNK_SIZE)) {
+
+}
+
+boost::asio::mutable_buffers_1 TlvFramer::prepare() {
+    if (_begin == _end && _chunk.use_count() == 1) {
+        _begin = _end = 0;
+    }
+    if (CHUNK_SIZE - _end < ndn::MAX_NDN_PACKET_SIZE) {
+        if (_chunk.use_count() > 1) {
+            // some blocks still point to this chunk, move the incomplete packet to a fresh one
+            auto chunk = std::make_shared<ndn::Buffer>(CHUNK_SIZE);
+            std::memcpy(chunk->data(), _chunk->data() + _begin, _end - _begin);
+            _chunk = chunk;
+        } else {
+            // no one else uses this chunk, only the incomplete packet is moved (never more than one packet)
+            std::memmove(_chunk->data(), _chunk->data() + _begin, _end - _begin);
+        }
+        _end -= _begin;
+        _begin = 0;
+    }
+    return boost::asio::buffer(_chunk->data() + _end, CHUNK_SIZE - _end);
+}
+
+void TlvFramer::commit(size_t bytes_transferred) {
+    _end += bytes_transferred;
+}
+
+void TlvFramer::extractBlocks(std::vector<ndn::Block> &blocks) {
+    const uint8_t *data = _chunk->data();
+    while (_begin < _end) {
+        // packet start with a known type (for ndn 0x05, 0x06 or 0x64) so we skip any starting byte that is not one
+        auto type = data[_begin];
+        if (type != tlv::INTEREST && type != tlv::DATA && type != tlv::LP_PACKET) {
+            ++_begin;
+            continue;
+        }
+
+        // read the length of the value according to tlv format, wait for more data if the header is incomplete
+        const uint8_t *pos = data + _begin + 1;
+        uint64_t length;
+        if (!tlv::readVarNumber(pos, data + _end, length)) {
+            break;
+        }
+        uint64_t header_size = pos - (data + _begin);
+
+        if (length > ndn::MAX_NDN_PACKET_SIZE - header_size) {
+            ++_begin;
+        } else if (header_size + length <= _end - _begin) {
+            // try to build the block over the chunk, if fail skip the first byte in order to find the next delimiter
+            size_t size = header_size + length;
+            try {
+                blocks.emplace_back(_chunk, _chunk->cbegin() + _begin, _chunk->cbegin() + _begin + size);
+                _begin += size;
+            } catch (const std::exception &e) {
+                std::cerr << e.what() << std::endl;
+                ++_begin;
+            }
+        } else {
+            break;
+        }
+    }
+}
@@ -0,0 +1,50 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/encoding/block.hpp>
+
+#include <boost/asio.hpp>
+
+#include <vector>
+
+// accumulate a byte stream into shared chunks and cut complete TLV blocks out of them, each block is a view over the
+// chunk so nothing is copied, the chunk is released once the last block referencing it is destroyed
+class TlvFramer {
+public:
+    static const size_t CHUNK_SIZE = 1 << 16;
+
+private:
+    ndn::BufferPtr _chunk;
+    // bytes in [_begin, _end) are received but not framed yet
+    size_t _begin = 0;
+    size_t _end = 0;
+
+public:
+    TlvFramer();
+
+    ~TlvFramer() = default;
+
+    // free space where the next read must write, at least ndn::MAX_NDN_PACKET_SIZE bytes
+    boost::asio::mutable_buffers_1 prepare();
+
+    void commit(size_t bytes_transferred);
+
+    // find as much blocks as possible in the received bytes
+    void extractBlocks(std::vector<ndn::Block> &blocks);
+};
@@ -58,18 +58,11 @@ private:
             return !_children.empty();
         }
 
-        std::shared_ptr<NamedNode> getChild(const ndn::Name::Component &name_component) {
+        // does not erase expired children (remove() already unlinks the nodes it drops) so that lookups can run
+        // concurrently under a shared lock
+        std::shared_ptr<NamedNode> getChild(const ndn::Name::Component &name_component) const {
             auto it = _children.find(name_component);
-            if (it != _children.end()) {
-                if (auto ptr = it->second.lock()) {
-                    return ptr;
-                } else {
-                    _children.erase(it);
-                    return nullptr;
-                }
-            } else {
-                return nullptr;
-            }
+            return it != _children.end() ? it->second.lock() : nullptr;
         }
 
         std::shared_ptr<NamedNode> getLeftChild() {
@@ -100,13 +93,13 @@ private:
             }
         }
 
-        std::vector<std::shared_ptr<NamedNode>> getChildren() {
-            std::vector<std::shared_ptr<NamedNode>> children(_children.size());
-            for (const auto& child : _children) {
-                if (auto c = child->second.lock()) {
-                    children.emplace_back(c);
-                } else {
-                    children.erase(child);
+        // same as getChild()
+        std::vector<std::shared_ptr<NamedNode>> getChildren() const {
+            std::vector<std::shared_ptr<NamedNode>> children;
+            children.reserve(_children.size());
+            for (const auto &child : _children) {
+                if (auto ptr = child.second.lock()) {
+                    children.emplace_back(ptr);
                 }
             }
             return children;
@@ -150,28 +143,6 @@ private:
             // _parent.expired() == 0 only for root
             return !_children.empty() || _value || _parent.expired();
         }
-
-        std::string toJSON() {
-            std::stringstream ss;
-            ss << R"({"name":")" << _name << R"(", "info":)" << (_value ? _value->toJSON() : "{}") << R"(, "children":[)";
-            bool first_child = true;
-            auto it = _children.cbegin();
-            while (it != _children.cend()) {
-                if (auto child = it->second.lock()) {
-                    if (first_child) {
-                        first_child = false;
-                    } else {
-                        ss << ", ";
-                    }
-                    ss << child->toJSON();
-                    ++it;
-                } else {
-                    it = _children.erase(it);
-                }
-            }
-            ss << "]}";
-            return ss.str();
-        }
     };
 
     size_t _populated_nodes = 0;
@@ -311,7 +282,16 @@ public:
         }
     }
 
-    std::string toJSON() const {
-        return _root->toJSON();
+    // visits the values under prefix in canonical order, from the first name after the cursor (from the first
+    // name if empty), until f(name, value) refuses one, returns true if some are left
+    template <class F>
+    bool forEachFrom(const ndn::Name &prefix, const ndn::Name &after, F f) const {
+        auto it = after.empty() || after < prefix ? _nodes.lower_bound(prefix) : _nodes.upper_bound(after);
+        for (; it != _nodes.end() && prefix.isPrefixOf(it->first); ++it) {
+            if (it->second->hasValue() && !f(it->first, *it->second->getValue())) {
+                return true;
+            }
+        }
+        return false;
     }
 };
\ No newline at end of file
@@ -0,0 +1,243 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "upstream_set.h"
+
+#include <ndn-cxx/interest.hpp>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+#include "log/logger.h"
+
+const boost::posix_time::seconds UpstreamSet::HEALTH_INTERVAL = boost::posix_time::seconds(1);
+const boost::posix_time::seconds UpstreamSet::HEALTH_TIMEOUT = boost::posix_time::seconds(3);
+
+static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+UpstreamSet::UpstreamSet(boost::asio::io_service &ios, const std::vector<DrrScheduler::Weight> &weights,
+                         const std::string &probe_name)
+        : _ios(ios)
+        , _timer(ios)
+        , _weights(weights)
+        , _ingress_limit(std::make_shared<DrrScheduler::IngressLimit>())
+        , _probe_name(probe_name) {
+
+}
+
+void UpstreamSet::add(const std::string &name, const FaceFactory &factory, bool local) {
+    static const ndn::Name LOCALHOST("/localhost");
+    size_t index = _upstreams.size();
+    // a remote NFD never answers a /localhost probe, it is then only checked through its face
+    bool probed = !_probe_name.empty() && (local || !LOCALHOST.isPrefixOf(_probe_name));
+    _upstreams.emplace_back(new Upstream(factory, name, probed));
+    for (size_t i = 0; i < VIRTUAL_NODES; ++i) {
+        _ring.emplace_back(std::hash<std::string>()(name + "#" + std::to_string(i)), index);
+    }
+    std::sort(_ring.begin(), _ring.end());
+}
+
+const std::shared_ptr<ReadGate>& UpstreamSet::getIngressGate() const {
+    return _ingress_limit->gate;
+}
+
+size_t UpstreamSet::size() const {
+    return _upstreams.size();
+}
+
+bool UpstreamSet::find(const std::string &name, size_t &index) const {
+    for (size_t i = 0; i < _upstreams.size(); ++i) {
+        if (_upstreams[i]->name == name) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::string& UpstreamSet::getName(size_t index) const {
+    return _upstreams.at(index)->name;
+}
+
+void UpstreamSet::open(const Face::InterestCallback &interest_callback, const Face::DataCallback &data_callback,
+                       const Face::ErrorCallback &error_callback, const PendingCallback &pending_callback) {
+    _interest_callback = interest_callback;
+    _data_callback = data_callback;
+    _error_callback = error_callback;
+    _pending_callback = pending_callback;
+    for (size_t i = 0; i < _upstreams.size(); ++i) {
+        openUpstream(i);
+    }
+    _timer.expires_from_now(HEALTH_INTERVAL);
+    _timer.async_wait(boost::bind(&UpstreamSet::checkHandler, this, _1));
+}
+
+bool UpstreamSet::forward(const std::shared_ptr<Face> &face, const std::string &uri, const InterestView &interest,
+                          const std::vector<size_t> *upstreams) {
+    if (_ring.empty()) {
+        return false;
+    }
+    auto it = std::lower_bound(_ring.begin(), _ring.end(), std::make_pair(std::hash<std::string>()(uri), (size_t)0));
+    for (size_t i = 0; i < _ring.size(); ++i, ++it) {
+        if (it == _ring.end()) {
+            it = _ring.begin();
+        }
+        if (upstreams && std::find(upstreams->begin(), upstreams->end(), it->second) == upstreams->end()) {
+            continue;
+        }
+        Upstream &upstream = *_upstreams[it->second];
+        if (upstream.healthy) {
+            std::atomic_load(&upstream.scheduler)->enqueue(face, interest.wireEncode());
+            upstream.replay.push(interest.wireEncode(), interest.getInterestLifetime());
+            return true;
+        }
+    }
+    return false;
+}
+
+void UpstreamSet::onData(const std::shared_ptr<Face> &face) {
+    for (auto &upstream : _upstreams) {
+        if (std::atomic_load(&upstream->scheduler)->getEgressFace() == face) {
+            upstream->probe_sent = 0;
+            if (!upstream->failed) {
+                setHealthy(*upstream, true);
+            }
+            return;
+        }
+    }
+}
+
+uint64_t UpstreamSet::getDroppedPackets() const {
+    uint64_t dropped = 0;
+    for (const auto &upstream : _upstreams) {
+        dropped += std::atomic_load(&upstream->scheduler)->getDroppedPackets();
+    }
+    return dropped;
+}
+
+std::string UpstreamSet::toJSON() const {
+    std::stringstream ss;
+    ss << "[";
+    for (size_t i = 0; i < _upstreams.size(); ++i) {
+        const Upstream &upstream = *_upstreams[i];
+        auto scheduler = std::atomic_load(&upstream.scheduler);
+        ss << (i == 0 ? "" : ", ") << R"({"name":")" << upstream.name << R"(", "healthy":)"
+           << (upstream.healthy ? "true" : "false") << R"(, "dropped":)"
+           << scheduler->getEgressFace()->getDroppedPackets() + scheduler->getDroppedPackets() << "}";
+    }
+    ss << "]";
+    return ss.str();
+}
+
+void UpstreamSet::openUpstream(size_t index) {
+    Upstream &upstream = *_upstreams[index];
+    auto face = upstream.factory();
+    // the Interests still queued for the failed face are lost, the consumers retransmit them once they are no longer
+    // suppressed by the PIT and they reach the next healthy upstream
+    std::atomic_store(&upstream.scheduler, std::make_shared<DrrScheduler>(_ios, face, _weights, _ingress_limit));
+    upstream.probe_sent = 0;
+    upstream.failed = false;
+    face->setConnectCallback(boost::bind(&UpstreamSet::onFaceConnected, this, index, _1));
+    face->open(_interest_callback, _data_callback, boost::bind(&UpstreamSet::onFaceError, this, index, _1));
+}
+
+void UpstreamSet::onFaceError(size_t index, const std::shared_ptr<Face> &face) {
+    Upstream &upstream = *_upstreams[index];
+    if (std::atomic_load(&upstream.scheduler)->getEgressFace() != face || upstream.failed.exchange(true)) {
+        return;
+    }
+    setHealthy(upstream, false);
+    _error_callback(face);
+}
+
+void UpstreamSet::onFaceConnected(size_t index, const std::shared_ptr<Face> &face) {
+    Upstream &upstream = *_upstreams[index];
+    auto scheduler = std::atomic_load(&upstream.scheduler);
+    if (scheduler->getEgressFace() != face) {
+        return;
+    }
+    // only the Interests still pending, the others were satisfied by another upstream or given up by the consumers,
+    // they take their turn with the Interests of the consumers
+    size_t replayed = 0;
+    for (const auto &wire : upstream.replay.take()) {
+        InterestView interest(wire);
+        if (_pending_callback(interest)) {
+            scheduler->enqueue(face, wire);
+            upstream.replay.push(wire, interest.getInterestLifetime());
+            ++replayed;
+        }
+    }
+    if (replayed > 0) {
+        std::stringstream ss;
+        ss << replayed << " pending Interests replayed to upstream " << upstream.name;
+        logger::log(logger::INFO, ss.str());
+    }
+}
+
+void UpstreamSet::check() {
+    for (size_t i = 0; i < _upstreams.size(); ++i) {
+        Upstream &upstream = *_upstreams[i];
+        if (upstream.failed) {
+            std::stringstream ss;
+            ss << "try to reach upstream " << upstream.name << " again";
+            logger::log(logger::INFO, ss.str());
+            std::atomic_load(&upstream.scheduler)->getEgressFace()->close();
+            openUpstream(i);
+            if (!upstream.probed) {
+                setHealthy(upstream, true);
+            }
+        } else if (upstream.probed) {
+            // only a probe left unanswered for its whole lifetime takes the upstream out of the ring
+            int64_t sent = upstream.probe_sent;
+            if (sent != 0 && now() - sent > HEALTH_TIMEOUT.total_nanoseconds()) {
+                setHealthy(upstream, false);
+                upstream.probe_sent = 0;
+            }
+        }
+        if (upstream.probed && upstream.probe_sent == 0) {
+            // any Data received counts, the Data of the probe is not in the PIT and goes nowhere
+            upstream.probe_sent = now();
+            ndn::Interest probe(_probe_name);
+            probe.setCanBePrefix(true);
+            probe.setMustBeFresh(true);
+            probe.setInterestLifetime(ndn::time::milliseconds(HEALTH_TIMEOUT.total_milliseconds()));
+            std::atomic_load(&upstream.scheduler)->getEgressFace()->send(probe);
+        }
+    }
+}
+
+void UpstreamSet::checkHandler(const boost::system::error_code &err) {
+    if (!err) {
+        check();
+        _timer.expires_from_now(HEALTH_INTERVAL);
+        _timer.async_wait(boost::bind(&UpstreamSet::checkHandler, this, _1));
+    }
+}
+
+void UpstreamSet::setHealthy(Upstream &upstream, bool healthy) {
+    if (upstream.healthy.exchange(healthy) != healthy) {
+        std::stringstream ss;
+        ss << "upstream " << upstream.name << (healthy ? " is healthy again" : " is unhealthy, its names fail over");
+        logger::log(healthy ? logger::INFO : logger::WARNING, ss.str());
+    }
+}
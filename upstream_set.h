@@ -0,0 +1,137 @@
+/*    
+Copyright (C) 2017-2018  Xavier MARCHAL
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/name.hpp>
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "network/face.h"
+#include "drr_scheduler.h"
+#include "replay_buffer.h"
+#include "tlv/interest_view.h"
+
+// the NFDs behind the firewall, Interest names are spread over them by consistent hashing so that the Interests for a
+// name always reach the same NFD (its cache and its PIT) while it is healthy, the names of an unhealthy NFD are taken
+// over by the next NFDs on the ring until it comes back
+class UpstreamSet {
+public:
+    using FaceFactory = std::function<std::shared_ptr<Face>()>;
+    // true if the Interest still waits for its Data
+    using PendingCallback = std::function<bool(const InterestView&)>;
+
+    // points of each upstream on the ring, enough to spread the names of a failed upstream over all the others
+    static const size_t VIRTUAL_NODES = 64;
+    static const boost::posix_time::seconds HEALTH_INTERVAL;
+    // an upstream that leaves a probe unanswered for that long is unhealthy
+    static const boost::posix_time::seconds HEALTH_TIMEOUT;
+
+private:
+    struct Upstream {
+        FaceFactory factory;
+        std::string name;
+        // replaced together when the face fails, read by the workers with std::atomic_load
+        std::shared_ptr<DrrScheduler> scheduler;
+        std::atomic<bool> healthy;
+        // the face gave up, it is created again at the next health check
+        std::atomic<bool> failed;
+        // false if only the state of the face tells its health
+        const bool probed;
+        // steady clock of the probe waiting for an answer (any Data), in nanoseconds, 0 if none
+        std::atomic<int64_t> probe_sent;
+        // sent again when the face reconnects
+        ReplayBuffer replay;
+
+        Upstream(const FaceFactory &factory, const std::string &name, bool probed)
+                : factory(factory), name(name), healthy(true), failed(false), probed(probed), probe_sent(0) {
+
+        }
+    };
+
+    boost::asio::io_service &_ios;
+    boost::asio::deadline_timer _timer;
+
+    std::vector<std::unique_ptr<Upstream>> _upstreams;
+    // sorted by hash, index in _upstreams
+    std::vector<std::pair<size_t, size_t>> _ring;
+
+    std::vector<DrrScheduler::Weight> _weights;
+    std::shared_ptr<DrrScheduler::IngressLimit> _ingress_limit;
+    // empty if the upstreams are not probed, they are then healthy until their face fails
+    ndn::Name _probe_name;
+
+    Face::InterestCallback _interest_callback;
+    Face::DataCallback _data_callback;
+    Face::ErrorCallback _error_callback;
+    PendingCallback _pending_callback;
+
+public:
+    UpstreamSet(boost::asio::io_service &ios, const std::vector<DrrScheduler::Weight> &weights,
+                const std::string &probe_name);
+
+    ~UpstreamSet() = default;
+
+    // must be called before open(), name identifies the upstream on the ring (e.g., its URI), local if the NFD is
+    // reached through a local face (NFD drops the /localhost Interests coming from the other faces)
+    void add(const std::string &name, const FaceFactory &factory, bool local);
+
+    // to give to the ingress faces
+    const std::shared_ptr<ReadGate>& getIngressGate() const;
+
+    size_t size() const;
+
+    // false if no upstream has this name
+    bool find(const std::string &name, size_t &index) const;
+
+    const std::string& getName(size_t index) const;
+
+    void open(const Face::InterestCallback &interest_callback, const Face::DataCallback &data_callback,
+              const Face::ErrorCallback &error_callback, const PendingCallback &pending_callback);
+
+    // send the Interest received by face to the healthy upstream owning its name (uri), only among the given upstreams
+    // if any (e.g., those of a FIB entry), false if none is healthy
+    bool forward(const std::shared_ptr<Face> &face, const std::string &uri, const InterestView &interest,
+                 const std::vector<size_t> *upstreams = nullptr);
+
+    // must be called for each Data received by an upstream face
+    void onData(const std::shared_ptr<Face> &face);
+
+    uint64_t getDroppedPackets() const;
+
+    std::string toJSON() const;
+
+private:
+    void openUpstream(size_t index);
+
+    void onFaceError(size_t index, const std::shared_ptr<Face> &face);
+
+    void onFaceConnected(size_t index, const std::shared_ptr<Face> &face);
+
+    void check();
+
+    void checkHandler(const boost::system::error_code &err);
+
+    void setHealthy(Upstream &upstream, bool healthy);
+};